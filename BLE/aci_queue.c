@@ -79,6 +79,42 @@ bool aci_queue_enqueue(aci_queue_t *aci_q, hal_aci_data_t *p_data)
   return true;
 }
 
+hal_aci_data_t *aci_queue_tail(aci_queue_t *aci_q)
+{
+  if (aci_queue_is_full(aci_q))
+  {
+    return NULL;
+  }
+
+  return &aci_q->aci_data[aci_q->tail & (ACI_QUEUE_SIZE - 1)];
+}
+
+void aci_queue_commit(aci_queue_t *aci_q)
+{
+  aci_q->aci_data[aci_q->tail & (ACI_QUEUE_SIZE - 1)].status_byte = 0;
+  ++aci_q->tail;
+}
+
+hal_aci_data_t *aci_queue_head(aci_queue_t *aci_q)
+{
+  if (aci_queue_is_empty(aci_q))
+  {
+    return NULL;
+  }
+
+  return &aci_q->aci_data[aci_q->head & (ACI_QUEUE_SIZE - 1)];
+}
+
+void aci_queue_release(aci_queue_t *aci_q)
+{
+  ++aci_q->head;
+}
+
+uint8_t aci_queue_count(aci_queue_t *aci_q)
+{
+  return (uint8_t)(aci_q->tail - aci_q->head);
+}
+
 bool aci_queue_is_empty(aci_queue_t *aci_q)
 {
   return (aci_q->head == aci_q->tail);
@@ -86,5 +122,6 @@ bool aci_queue_is_empty(aci_queue_t *aci_q)
 
 bool aci_queue_is_full(aci_queue_t *aci_q)
 {
-  return (aci_q->tail == aci_q->head + ACI_QUEUE_SIZE);
+  /* head and tail wrap at 256; keep the sum from being promoted to int */
+  return (aci_q->tail == (uint8_t)(aci_q->head + ACI_QUEUE_SIZE));
 }
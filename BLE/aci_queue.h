@@ -32,14 +32,23 @@
 #ifndef ACI_QUEUE_H__
 #define ACI_QUEUE_H__
 
+#include <avr/io.h>
+
 #include "aci.h"
 #include "hal_aci_tl.h"
 
 /***********************************************************************    */
 /* The ACI_QUEUE_SIZE determines the memory usage of the system.            */
 /* Successfully tested to a ACI_QUEUE_SIZE of 4 (interrupt) and 4 (polling) */
+/* Parts with 2 KB of RAM or more have room for 4 in the arena, ../arena.h  */
 /***********************************************************************    */
+#ifndef ACI_QUEUE_SIZE
+#if RAMEND >= 0x800
+#define ACI_QUEUE_SIZE  4
+#else
 #define ACI_QUEUE_SIZE  2
+#endif
+#endif
 
 /** Data type for queue of data packets to send/receive from radio.
  *
@@ -61,5 +70,20 @@ bool aci_queue_enqueue(aci_queue_t *aci_q, hal_aci_data_t *p_data);
 bool aci_queue_is_empty(aci_queue_t *aci_q);
 bool aci_queue_is_full(aci_queue_t *aci_q);
 
+/* Slot at the tail, to be filled in place and queued with
+ * aci_queue_commit(). NULL if the queue is full.
+ */
+hal_aci_data_t *aci_queue_tail(aci_queue_t *aci_q);
+void aci_queue_commit(aci_queue_t *aci_q);
+
+/* Slot at the head, to be read in place and dropped with
+ * aci_queue_release(). NULL if the queue is empty.
+ */
+hal_aci_data_t *aci_queue_head(aci_queue_t *aci_q);
+void aci_queue_release(aci_queue_t *aci_q);
+
+/* Number of packets in the queue */
+uint8_t aci_queue_count(aci_queue_t *aci_q);
+
 #endif /* ACI_QUEUE_H__ */
 /** @} */
@@ -0,0 +1,93 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Encoders for the ACI commands used by the bootloader.
+
+  Each encoder writes a complete command into buffer, which is normally a
+  transmit queue slot from hal_aci_tl_cmd_buffer(). The constant part of a
+  command, its length and opcode, is written from immediates so that it
+  only takes its own two bytes of flash, and the parameter offsets are
+  taken from ::aci_cmd_t at compile time.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "aci.h"
+#include "aci_cmds.h"
+#include "acilib.h"
+#include "acilib_if.h"
+
+/* Offset of a field of ::aci_cmd_t in the message buffer */
+#define CMD_OFFSET(field)   offsetof(aci_cmd_t, field)
+
+static inline void m_encode_header(uint8_t *buffer, uint8_t len,
+    aci_cmd_opcode_t opcode)
+{
+  buffer[CMD_OFFSET(len)] = len;
+  buffer[CMD_OFFSET(cmd_opcode)] = (uint8_t)opcode;
+}
+
+static inline void m_encode_uint16(uint8_t *buffer, uint16_t value)
+{
+  buffer[0] = (uint8_t)(value);
+  buffer[1] = (uint8_t)(value >> 8);
+}
+
+void acil_encode_cmd_radio_reset(uint8_t *buffer)
+{
+  m_encode_header(buffer, MSG_BASEBAND_RESET_LEN, ACI_CMD_RADIO_RESET);
+}
+
+void acil_encode_cmd_get_device_version(uint8_t *buffer)
+{
+  m_encode_header(buffer, MSG_GET_DEVICE_VERSION_LEN,
+      ACI_CMD_GET_DEVICE_VERSION);
+}
+
+void acil_encode_cmd_connect(uint8_t *buffer,
+    aci_cmd_params_connect_t *p_aci_cmd_params_connect)
+{
+  m_encode_header(buffer, MSG_CONNECT_LEN, ACI_CMD_CONNECT);
+  m_encode_uint16(buffer + CMD_OFFSET(params.connect.timeout),
+      p_aci_cmd_params_connect->timeout);
+  m_encode_uint16(buffer + CMD_OFFSET(params.connect.adv_interval),
+      p_aci_cmd_params_connect->adv_interval);
+}
+
+void acil_encode_cmd_disconnect(uint8_t *buffer,
+    aci_cmd_params_disconnect_t *p_aci_cmd_params_disconnect)
+{
+  m_encode_header(buffer, MSG_DISCONNECT_LEN, ACI_CMD_DISCONNECT);
+  buffer[CMD_OFFSET(params.disconnect.reason)] =
+    (uint8_t)p_aci_cmd_params_disconnect->reason;
+}
+
+void acil_encode_cmd_send_data(uint8_t *buffer, uint8_t pipe,
+    const uint8_t *p_data, uint8_t data_size)
+{
+  m_encode_header(buffer, MSG_SEND_DATA_BASE_LEN + data_size,
+      ACI_CMD_SEND_DATA);
+  buffer[CMD_OFFSET(params.send_data.tx_data.pipe_number)] = pipe;
+  memcpy(buffer + CMD_OFFSET(params.send_data.tx_data.aci_data), p_data,
+      data_size);
+}
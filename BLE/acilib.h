@@ -35,6 +35,7 @@
 #define MSG_BOND_LEN                             5
 #define MSG_DISCONNECT_LEN                       2
 #define MSG_BASEBAND_RESET_LEN                   1
+#define MSG_GET_DEVICE_VERSION_LEN               1
 #define MSG_WAKEUP_LEN                           1
 #define MSG_SET_RADIO_TX_POWER_LEN               2
 #define MSG_GET_DEVICE_ADDR_LEN                  1
@@ -34,6 +34,22 @@
 
 #include "aci_cmds.h"
 
+/** @brief Encode the ACI message for radio reset
+ *
+ *  @param[in,out]  buffer  Pointer to ACI message buffer
+ *
+ *  @return         None
+ */
+void acil_encode_cmd_radio_reset(uint8_t *buffer);
+
+/** @brief Encode the ACI message for get device version
+ *
+ *  @param[in,out]  buffer  Pointer to ACI message buffer
+ *
+ *  @return         None
+ */
+void acil_encode_cmd_get_device_version(uint8_t *buffer);
+
 /** @brief Encode the ACI message to connect
  *
  *  @param[in,out]  buffer                    Pointer to ACI message buffer
@@ -54,12 +70,13 @@ void acil_encode_cmd_disconnect(uint8_t *buffer, aci_cmd_params_disconnect_t *p_
 
 /** @brief Encode the ACI message for send data
  *
- *  @param[in,out]  buffer                        Pointer to ACI message buffer
- *  @param[in]      p_aci_cmd_params_send_data_t  Pointer to the data parameters in ::aci_cmd_params_send_data_t
- *  @param[in]      data_size                     Size of data message
+ *  @param[in,out]  buffer     Pointer to ACI message buffer
+ *  @param[in]      pipe       Pipe number
+ *  @param[in]      p_data     Pointer to the data to send
+ *  @param[in]      data_size  Size of data message
  *
  *  @return         None
  */
-void acil_encode_cmd_send_data(uint8_t *buffer, aci_cmd_params_send_data_t *p_aci_cmd_params_send_data_t, uint8_t data_size);
+void acil_encode_cmd_send_data(uint8_t *buffer, uint8_t pipe, const uint8_t *p_data, uint8_t data_size);
 
 #endif
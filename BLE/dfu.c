@@ -24,11 +24,21 @@
  */
 
 #include <string.h>
+#include <avr/eeprom.h>
 #include <avr/io.h>
 #include <util/delay.h>
 
+#include "../arena.h"
+#include "../auth.h"
 #include "../boot.h"
+#include "../bootlog.h"
+#include "../history.h"
 #include "../jump.h"
+#include "../live.h"
+#include "../perf.h"
+#include "../probe.h"
+#include "../selfbench.h"
+#include "../trace.h"
 
 #include "lib_aci.h"
 #include "dfu.h"
@@ -37,14 +47,33 @@
 * Local definitions
 *****************************************************************************/
 
+/* What the flash is doing with the oldest page held in RAM */
+#define FLASH_IDLE      0
+#define FLASH_ERASING   1
+#define FLASH_WRITING   2
+
 static void dfu_data_pkt_handle (aci_evt_t *aci_evt);
-static void dfu_init_pkt_handle (void);
+static void dfu_init_pkt_handle (aci_evt_t *aci_evt);
 static void dfu_image_size_set (aci_evt_t *aci_evt);
 static void dfu_image_validate (void);
+static void dfu_image_receive (void);
 static void dfu_reset (void);
+#if defined(PERF_COUNTERS) || defined(SELFBENCH)
+static void dfu_block_report (aci_evt_t *aci_evt, uint8_t procedure,
+    const uint8_t *block, uint8_t size);
+#endif
+#ifdef HISTORY
+static void dfu_history_report (aci_evt_t *aci_evt);
+#endif
 
 static bool m_send (uint8_t *buff, uint8_t buff_len);
-static void m_write_page (uint16_t page, uint8_t *buff);
+#ifdef PAGE_STREAM
+static void m_stream_byte (uint8_t data);
+static void m_stream_page (uint16_t page_num);
+#else
+static void m_write_page (uint16_t page, const uint8_t *buff);
+static void m_flash_wait (uint8_t pages);
+#endif
 
 /*****************************************************************************
 * Static Globals
@@ -57,9 +86,20 @@ static uint16_t     m_pkt_notif_target;
 static uint16_t     m_pkt_notif_target_cnt;
 static uint32_t     m_num_of_firmware_bytes_rcvd;
 static uint16_t     m_page_address;
-static uint8_t      m_page_buff[SPM_PAGESIZE];
+#ifdef PAGE_STREAM
+static uint8_t      m_word_low;
+#else
+static uint16_t     m_flash_address;    /* Oldest page not yet written */
+static uint8_t      m_flash_state;
+static uint8_t      m_pages_full;       /* Full pages waiting for the flash */
+#endif
 static uint8_t      m_page_buff_index;
 static uint8_t      m_pipe_array[3];
+#ifdef DFU_AUTH
+static auth_mac_t   m_mac;
+static uint8_t      m_tag[AUTH_TAG_SIZE];
+static bool         m_tag_received;     /* The init packet carried a tag */
+#endif
 
 /*****************************************************************************
 * Static Functions
@@ -70,6 +110,11 @@ static bool m_send (uint8_t *buff, uint8_t buff_len)
 {
   bool status;
 
+  if (m_aci_state->data_credit_available == 0)
+  {
+    perf_count (zero_credit);
+  }
+
   /* Put the notification message in the queue */
   status = lib_aci_send_data(m_pipe_array[1], buff, buff_len);
 
@@ -77,20 +122,82 @@ static bool m_send (uint8_t *buff, uint8_t buff_len)
   if (status)
   {
     m_aci_state->data_credit_available--;
+    live_record (LIVE_CREDITS, m_aci_state->data_credit_available);
   }
 
   return status;
 }
 
-/* Write the contents of buf to the given flash page */
-static void m_write_page (uint16_t page_num, uint8_t *buff)
+#ifdef PAGE_STREAM
+/* Load one byte of the image into the SPM temporary buffer, a word at a
+ * time. The buffer may be filled before its page is erased, so the page is
+ * erased and written as soon as the last word has landed.
+ */
+static void m_stream_byte (uint8_t data)
+{
+  if (m_page_buff_index & 1)
+  {
+    /* The write of the previous page is left running until the first word
+     * of this one
+     */
+    if (m_page_buff_index == 1)
+    {
+      probe_on (PROBE_WAIT);
+      perf_spm_busy_wait ();
+      probe_flash_idle ();
+    }
+
+    __boot_page_fill_short (m_page_address + m_page_buff_index - 1,
+        m_word_low | (uint16_t) data << 8);
+  }
+  else
+  {
+    m_word_low = data;
+  }
+
+  /* Wraps to 0 on parts with 256 byte pages */
+  if (++m_page_buff_index == (uint8_t) SPM_PAGESIZE)
+  {
+    m_page_buff_index = 0;
+    m_stream_page (m_page_address);
+    m_page_address += SPM_PAGESIZE;
+  }
+}
+
+/* Erase the page and write the temporary buffer to it, without waiting for
+ * the write to finish
+ */
+static void m_stream_page (uint16_t page_num)
+{
+  __boot_page_erase_short (page_num);
+  probe_on (PROBE_ERASE);
+  perf_count (pages_erased);
+  probe_on (PROBE_WAIT);
+  perf_spm_busy_wait ();
+  probe_flash_idle ();
+
+  __boot_page_write_short (page_num);
+  probe_on (PROBE_WRITE);
+  perf_count (pages_written);
+  trace_record (TRACE_PAGE, page_num / SPM_PAGESIZE);
+  live_record (TRACE_PAGE, page_num / SPM_PAGESIZE);
+  history_page ();
+}
+#else
+/* Buffer in the arena holding the given page */
+static uint8_t *m_page_buff (uint16_t page_num)
+{
+  return arena.ble.page_buff[(page_num / SPM_PAGESIZE) & (DFU_PAGE_BUFFERS - 1)];
+}
+
+/* Load the contents of buff into the SPM temporary buffer and start writing
+ * it to the given flash page, without waiting for the write to finish
+ */
+static void m_write_page (uint16_t page_num, const uint8_t *buff)
 {
   uint16_t size = SPM_PAGESIZE / 2;
   uint16_t addr = page_num;
 
-  /* If the page is still erasing, we need to wait for it to complete */
-  boot_spm_busy_wait ();
-
   /* Fill the page buffer */
   do
   {
@@ -102,11 +209,61 @@ static void m_write_page (uint16_t page_num, uint8_t *buff)
     addr += 2;
   } while (--size);
 
-  /* Store buffer in flash page, then wait while the memory is written */
   __boot_page_write_short (page_num);
-  boot_spm_busy_wait();
+  probe_on (PROBE_WRITE);
+  perf_count (pages_written);
+  trace_record (TRACE_PAGE, page_num / SPM_PAGESIZE);
+  live_record (TRACE_PAGE, page_num / SPM_PAGESIZE);
+  history_page ();
+}
+
+/* Take the oldest page held in RAM one step further whenever the flash is
+ * free: erase it as soon as it has data, and write it once it is full and
+ * erased. Its buffer is free again once the write has started, as the
+ * contents have moved to the SPM temporary buffer. Never waits.
+ */
+void dfu_flash_poll (void)
+{
+  if (boot_spm_busy ())
+  {
+    return;
+  }
+  probe_flash_idle ();
+
+  if (m_flash_state == FLASH_ERASING)
+  {
+    if (m_pages_full != 0)
+    {
+      m_write_page (m_flash_address, m_page_buff (m_flash_address));
+      m_flash_address += SPM_PAGESIZE;
+      m_pages_full--;
+      m_flash_state = FLASH_WRITING;
+    }
+    return;
+  }
+
+  m_flash_state = FLASH_IDLE;
+  if (m_pages_full != 0 || m_page_buff_index != 0)
+  {
+    __boot_page_erase_short (m_flash_address);
+    probe_on (PROBE_ERASE);
+    perf_count (pages_erased);
+    m_flash_state = FLASH_ERASING;
+  }
 }
 
+/* Wait until no more than the given number of full pages are left in RAM */
+static void m_flash_wait (uint8_t pages)
+{
+  while (m_pages_full > pages)
+  {
+    probe_on (PROBE_WAIT);
+    perf_spm_busy_wait ();
+    dfu_flash_poll ();
+  }
+}
+#endif
+
 /* Receive a firmware packet, and write it to flash. Also sends receipt
  * notifications if needed
  */
@@ -142,35 +299,77 @@ static void dfu_data_pkt_handle (aci_evt_t *aci_evt)
     }
   }
 
-  /* Write received data to page buffer.
-   * If the buffer is empty, we've received the first data in a new page,
-   * which should be erased while the buffer fills. When the buffer is full,
-   * we write it to flash.
+  /* Write received data to the page buffers in the arena. The flash
+   * erases and writes the oldest of them in the background while the next
+   * fills, and a new page only waits for the flash when every buffer is
+   * taken. With PAGE_STREAM the data goes straight into the SPM temporary
+   * buffer instead.
    */
   uint8_t i;
+#ifdef PAGE_STREAM
+  for (i = 0; i < bytes_received; i++)
+  {
+    m_stream_byte (data_received->rx_data.aci_data[i]);
+  }
+#else
+  uint8_t *page = m_page_buff (m_page_address);
+
   for (i = 0; i < bytes_received; i++)
   {
     if (m_page_buff_index == 0)
     {
-      __boot_page_erase_short (m_page_address);
+      m_flash_wait (DFU_PAGE_BUFFERS - 1);
+      page = m_page_buff (m_page_address);
     }
 
-    m_page_buff[m_page_buff_index++] = data_received->rx_data.aci_data[i];
+    page[m_page_buff_index] = data_received->rx_data.aci_data[i];
 
-    if (m_page_buff_index == SPM_PAGESIZE)
+    /* Wraps to 0 on parts with 256 byte pages */
+    if (++m_page_buff_index == (uint8_t) SPM_PAGESIZE)
     {
       m_page_buff_index = 0;
-      m_write_page (m_page_address, m_page_buff);
       m_page_address += SPM_PAGESIZE;
+      m_pages_full++;
     }
   }
+  dfu_flash_poll ();
+#endif
+
+#ifdef DFU_AUTH
+  /* The MAC follows the image as it arrives, so validation has nothing
+   * left to read back
+   */
+  auth_mac_update (&m_mac, data_received->rx_data.aci_data, bytes_received);
+#endif
 
   /* Check if we've received the entire firmware image */
   m_num_of_firmware_bytes_rcvd += bytes_received;
   if (m_image_size == m_num_of_firmware_bytes_rcvd)
   {
     /* Write final page to flash */
-    m_write_page (m_page_address++, m_page_buff);
+#ifdef PAGE_STREAM
+    if (m_page_buff_index & 1)
+    {
+      m_stream_byte (0xFF);
+    }
+    if (m_page_buff_index != 0)
+    {
+      m_stream_page (m_page_address);
+    }
+    perf_spm_busy_wait ();
+    probe_flash_idle ();
+#else
+    if (m_page_buff_index != 0)
+    {
+      m_page_buff_index = 0;
+      m_page_address += SPM_PAGESIZE;
+      m_pages_full++;
+    }
+    m_flash_wait (0);
+    probe_on (PROBE_WAIT);
+    perf_spm_busy_wait ();
+    dfu_flash_poll ();
+#endif
 
     /* Send firmware received notification */
     m_send ((uint8_t *) receive_app_success, 3);
@@ -183,15 +382,22 @@ static void dfu_image_activate (aci_evt_t *aci_evt)
   hal_aci_evt_t aci_data;
 
   jump_app_key_set ();
+  history_end (HISTORY_OK);
   lib_aci_disconnect(m_aci_state, ACI_REASON_TERMINATE);
 
   while(1) {
     if (lib_aci_event_get(m_aci_state, &aci_data) &&
-       (aci_evt->evt_opcode == ACI_EVT_DISCONNECTED)) {
+       (aci_data.evt.evt_opcode == ACI_EVT_DISCONNECTED)) {
+      trace_record (TRACE_WDT_EXIT, TRACE_EXIT_BLE);
+      live_record (TRACE_WDT_EXIT, TRACE_EXIT_BLE);
       /* Set watchdog to shortest interval and spin until reset */
       WDTCSR = _BV(WDCE) | _BV(WDE);
       WDTCSR = _BV(WDE);
-      while(1);
+      bootlog_wdt (_BV(WDE));
+      /* 16 ms is enough to send what is left of the live stream */
+      while(1) {
+        live_poll ();
+      }
     }
   }
 }
@@ -221,6 +427,19 @@ static void dfu_image_size_set (aci_evt_t *aci_evt)
     (uint32_t)aci_evt->params.data_received.rx_data.aci_data[9]  << 8  |
     (uint32_t)aci_evt->params.data_received.rx_data.aci_data[8];
 
+  history_start (HISTORY_BLE, m_image_size);
+
+#ifdef DFU_AUTH
+  {
+    uint8_t key[AUTH_KEY_SIZE];
+
+    eeprom_read_block ((void *) key, (const void *) AUTH_KEY_EEPROM_ADDR,
+        AUTH_KEY_SIZE);
+    auth_mac_init (&m_mac, key);
+    m_tag_received = false;
+  }
+#endif
+
   /* Write response */
   m_send ((uint8_t *) dfu_start_success, 3);
 
@@ -233,6 +452,22 @@ static void dfu_image_validate (void)
   static const uint8_t validate_success[] = {OP_CODE_RESPONSE,
     BLE_DFU_VALIDATE_PROCEDURE,
     BLE_DFU_RESP_VAL_SUCCESS};
+#ifdef DFU_AUTH
+  static const uint8_t validate_failed[] = {OP_CODE_RESPONSE,
+    BLE_DFU_VALIDATE_PROCEDURE,
+    BLE_DFU_RESP_VAL_CRC_ERROR};
+  uint8_t tag[AUTH_TAG_SIZE];
+
+  /* Only an authentic image, complete, may be activated */
+  auth_mac_final (&m_mac, tag);
+  if (!auth_tag_equal (tag, m_tag) ||
+      m_num_of_firmware_bytes_rcvd != m_image_size)
+  {
+    m_send ((uint8_t *) validate_failed, 3);
+    m_dfu_state = ST_FW_INVALID;
+    return;
+  }
+#endif
 
   /* Completed successfully */
   if (m_num_of_firmware_bytes_rcvd == m_image_size)
@@ -243,13 +478,53 @@ static void dfu_image_validate (void)
   m_dfu_state = ST_FW_VALID;
 }
 
+/* Start receiving the image, if the procedure so far allows it */
+static void dfu_image_receive (void)
+{
+  static const uint8_t receive_refused[] = {OP_CODE_RESPONSE,
+    BLE_DFU_RECEIVE_APP_PROCEDURE,
+    BLE_DFU_RESP_VAL_INVALID_STATE};
+
+#ifdef DFU_AUTH
+  /* Nothing is written to flash before the start packet and an init packet
+   * with the tag of the image
+   */
+  if (m_dfu_state != ST_RX_INIT_PKT || !m_tag_received)
+#else
+  if (m_dfu_state != ST_RDY && m_dfu_state != ST_RX_INIT_PKT)
+#endif
+  {
+    m_send ((uint8_t *) receive_refused, 3);
+    return;
+  }
+
+  /* Once we reach this point, the currently loaded application
+   * will be trashed, and we should disable jumping to application
+   * until we have verified the incoming firmware.
+   */
+  jump_app_key_clear ();
+  m_dfu_state = ST_RX_DATA_PKT;
+}
+
 /* Receive and process an init packet */
-static void dfu_init_pkt_handle (void)
+static void dfu_init_pkt_handle (aci_evt_t *aci_evt)
 {
   static const uint8_t init_procedure_success[] = {OP_CODE_RESPONSE,
      BLE_DFU_INIT_PROCEDURE,
      BLE_DFU_RESP_VAL_SUCCESS};
 
+#ifdef DFU_AUTH
+  const uint8_t *data = aci_evt->params.data_received.rx_data.aci_data;
+  const uint8_t bytes_received = aci_evt->len - 2;
+
+  /* The tag of the image ends the init packet */
+  if (bytes_received >= AUTH_TAG_SIZE)
+  {
+    memcpy (m_tag, data + bytes_received - AUTH_TAG_SIZE, AUTH_TAG_SIZE);
+    m_tag_received = true;
+  }
+#endif
+
   /* Send init received notification */
   m_send ((uint8_t *) init_procedure_success, 3);
 }
@@ -263,11 +538,83 @@ static void dfu_notification_set (aci_evt_t *aci_evt)
   m_pkt_notif_target_cnt = m_pkt_notif_target;
 }
 
-/* Disconnect from the nRF8001 and do a reset */
+#if defined(PERF_COUNTERS) || defined(SELFBENCH)
+/* Send up to PERF_DFU_CHUNK bytes of a block, the counters or the
+ * self-benchmark results, starting at the offset in the request
+ */
+static void dfu_block_report (aci_evt_t *aci_evt, uint8_t procedure,
+    const uint8_t *block, uint8_t size)
+{
+  uint8_t rsp[3 + PERF_DFU_CHUNK] = {OP_CODE_RESPONSE,
+    procedure,
+    BLE_DFU_RESP_VAL_SUCCESS};
+  uint8_t offset = 0;
+  uint8_t len = 0;
+
+  if (aci_evt->len - 2 > 1)
+  {
+    offset = aci_evt->params.data_received.rx_data.aci_data[1];
+  }
+
+  while (offset < size && len < PERF_DFU_CHUNK)
+  {
+    rsp[3 + len++] = block[offset++];
+  }
+
+  m_send (rsp, 3 + len);
+}
+#endif
+
+#ifdef HISTORY
+/* Send the entry of the session history selected by the request, 0 being
+ * the newest
+ */
+static void dfu_history_report (aci_evt_t *aci_evt)
+{
+  uint8_t rsp[3 + sizeof(history_entry_t)] = {OP_CODE_RESPONSE,
+    BLE_DFU_HISTORY_PROCEDURE,
+    BLE_DFU_RESP_VAL_SUCCESS};
+  uint8_t n = 0;
+
+  if (aci_evt->len - 2 > 1)
+  {
+    n = aci_evt->params.data_received.rx_data.aci_data[1];
+  }
+
+  if (!history_read (n, (history_entry_t *) &rsp[3]))
+  {
+    rsp[2] = BLE_DFU_RESP_VAL_DATA_SIZE;
+    m_send (rsp, 3);
+    return;
+  }
+
+  m_send (rsp, sizeof(rsp));
+}
+#endif
+
+/* Disconnect from the nRF8001 and do a reset. The image received so far
+ * is dropped: the flash is left to finish its erase or write, which must
+ * be done before history_end() writes to the EEPROM, and the pages still
+ * in RAM are forgotten, so that a new transfer starts from scratch. The
+ * application was already invalidated when the transfer started.
+ */
 static void dfu_reset (void)
 {
   while (!lib_aci_radio_reset());
 
+  perf_spm_busy_wait ();
+  probe_flash_idle ();
+  boot_rww_enable ();
+#ifndef PAGE_STREAM
+  m_flash_state = FLASH_IDLE;
+  m_pages_full = 0;
+  m_flash_address = 0;
+#endif
+  m_page_buff_index = 0;
+  m_page_address = 0;
+  m_num_of_firmware_bytes_rcvd = 0;
+
+  history_end (HISTORY_ABORTED);
   m_dfu_state = ST_IDLE;
 }
 
@@ -286,6 +633,7 @@ void dfu_init (uint8_t *p_pipes)
 void dfu_update (aci_state_t *aci_state, aci_evt_t *aci_evt)
 {
   const aci_rx_data_t *rx_data = &(aci_evt->params.data_received.rx_data);
+  const uint8_t state = m_dfu_state;
   uint8_t event = EV_ANY;
   uint8_t pipe;
 
@@ -311,10 +659,12 @@ void dfu_update (aci_state_t *aci_state, aci_evt_t *aci_evt)
           dfu_image_size_set(aci_evt);
           break;
         case ST_RX_INIT_PKT:
-          dfu_init_pkt_handle();
+          dfu_init_pkt_handle(aci_evt);
           break;
         case ST_RX_DATA_PKT:
+          probe_on (PROBE_DFU);
           dfu_data_pkt_handle(aci_evt);
+          probe_off (PROBE_DFU);
           break;
       }
       break;
@@ -323,13 +673,7 @@ void dfu_update (aci_state_t *aci_state, aci_evt_t *aci_evt)
         m_dfu_state = ST_RX_INIT_PKT;
       break;
     case OP_CODE_RECEIVE_FW:
-      if (m_dfu_state == ST_RDY || m_dfu_state == ST_RX_INIT_PKT)
-        /* Once we reach this point, the currently loaded application
-         * will be trashed, and we should disable jumping to application
-         * until we have verified the incoming firmware.
-         */
-        jump_app_key_clear ();
-        m_dfu_state = ST_RX_DATA_PKT;
+      dfu_image_receive ();
       break;
     case OP_CODE_VALIDATE:
       if (m_dfu_state == ST_RX_DATA_PKT)
@@ -345,5 +689,28 @@ void dfu_update (aci_state_t *aci_state, aci_evt_t *aci_evt)
     case OP_CODE_PKT_RCPT_NOTIF_REQ:
       dfu_notification_set (aci_evt);
       break;
+#ifdef PERF_COUNTERS
+    case OP_CODE_PERF_COUNTERS_REQ:
+      dfu_block_report (aci_evt, BLE_DFU_PERF_COUNTERS_PROCEDURE,
+          (const uint8_t *) &perf_counters, sizeof(perf_counters));
+      break;
+#endif
+#ifdef SELFBENCH
+    case OP_CODE_SELFBENCH_REQ:
+      dfu_block_report (aci_evt, BLE_DFU_SELFBENCH_PROCEDURE,
+          (const uint8_t *) &selfbench, sizeof(selfbench));
+      break;
+#endif
+#ifdef HISTORY
+    case OP_CODE_HISTORY_REQ:
+      dfu_history_report (aci_evt);
+      break;
+#endif
+  }
+
+  if (m_dfu_state != state)
+  {
+    trace_record (TRACE_DFU_STATE, m_dfu_state);
+    live_record (TRACE_DFU_STATE, m_dfu_state);
   }
 }
@@ -41,6 +41,9 @@
 #define OP_CODE_SYS_RESET             6   /* 'Reset System' */
 #define OP_CODE_IMAGE_SIZE_REQ        7   /* 'Report received image size' .*/
 #define OP_CODE_PKT_RCPT_NOTIF_REQ    8   /* 'Request packet rcpt notification.*/
+#define OP_CODE_PERF_COUNTERS_REQ     9   /* 'Report performance counters', see perf.h */
+#define OP_CODE_HISTORY_REQ           10  /* 'Report session history', see history.h */
+#define OP_CODE_SELFBENCH_REQ         11  /* 'Report self-benchmark', see selfbench.h */
 #define OP_CODE_RESPONSE              16  /* 'Response.*/
 #define OP_CODE_PKT_RCPT_NOTIF        17   /* 'Packets Receipt Notification'.*/
 
@@ -53,6 +56,12 @@
 #define BLE_DFU_RECEIVE_APP_PROCEDURE   3
 #define BLE_DFU_VALIDATE_PROCEDURE      4
 #define BLE_DFU_PKT_RCPT_REQ_PROCEDURE  8
+#define BLE_DFU_PERF_COUNTERS_PROCEDURE 9
+#define BLE_DFU_HISTORY_PROCEDURE       10
+#define BLE_DFU_SELFBENCH_PROCEDURE     11
+
+/* Block bytes in one OP_CODE_PERF_COUNTERS_REQ or _SELFBENCH_REQ response */
+#define PERF_DFU_CHUNK                  17
 
 /**@brief   DFU Response value type.
  */
@@ -66,4 +75,13 @@
 void dfu_init (uint8_t *ppipes);
 void dfu_update (aci_state_t *aci_state, aci_evt_t *aci_evt);
 
+/* Let the flash take the image pages held in RAM one step further, without
+ * waiting. Called from the main loop whenever it runs.
+ */
+#ifdef PAGE_STREAM
+#define dfu_flash_poll()  do {} while (0)
+#else
+void dfu_flash_poll (void);
+#endif
+
 #endif /* DFU_H_ */
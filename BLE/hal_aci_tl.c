@@ -23,8 +23,16 @@
 #include <avr/io.h>
 #include <util/delay.h>
 
+#include "../arena.h"
+#include "../capture.h"
+#include "../live.h"
+#include "../perf.h"
+#include "../probe.h"
+#include "../selfbench.h"
+
 #include "hal_aci_tl.h"
 #include "aci_queue.h"
+#include "lib_aci.h"
 #include "pins_arduino.h"
 
 static inline void m_aci_event_check (void);
@@ -35,8 +43,9 @@ static inline uint8_t m_spi_readwrite (const uint8_t aci_byte);
 static inline void m_aci_spi_transfer (hal_aci_data_t * data_to_send,
     hal_aci_data_t * received_data);
 
-static aci_queue_t  aci_tx_q;
-static aci_queue_t  aci_rx_q;
+/* Both queues live in the RAM arena, see arena.h */
+#define aci_tx_q  (arena.ble.aci_tx_q)
+#define aci_rx_q  (arena.ble.aci_rx_q)
 static aci_pins_t   *pins;
 
 static inline void m_aci_event_check(void)
@@ -82,8 +91,10 @@ static inline void m_aci_event_check(void)
     m_aci_reqn_enable();
   }
 
-  /* Check if we received data */
-  if (received_data.buffer[0] > 0)
+  /* Check if we received data. Events that only update the ACI state are
+   * folded in here and do not take a slot in the queue
+   */
+  if (received_data.buffer[0] > 0 && !lib_aci_event_fold(&received_data))
   {
     aci_queue_enqueue(&aci_rx_q, &received_data);
   }
@@ -111,6 +122,10 @@ static inline void m_aci_spi_transfer (hal_aci_data_t * data_to_send, hal_aci_da
   uint8_t byte_sent_cnt;
   uint8_t max_bytes;
 
+  perf_count (spi_transfers);
+  probe_on (PROBE_SPI);
+  selfbench_spi_start ();
+
   m_aci_reqn_enable();
 
   /* Send length, receive header */
@@ -143,6 +158,9 @@ static inline void m_aci_spi_transfer (hal_aci_data_t * data_to_send, hal_aci_da
 
   /* RDYN should follow the REQN line in approx 100ns */
   m_aci_reqn_disable();
+  selfbench_spi_end (max_bytes + 2);
+  probe_off (PROBE_SPI);
+  capture_spi (data_to_send->buffer, received_data->buffer);
 }
 
 static inline void m_spi_init (void)
@@ -222,10 +240,43 @@ bool hal_aci_tl_send(hal_aci_data_t *p_aci_cmd)
       m_aci_reqn_enable();
     }
   }
+  else
+  {
+    perf_count (tx_full);
+  }
 
   return ret_val;
 }
 
+uint8_t *hal_aci_tl_cmd_buffer(void)
+{
+  hal_aci_data_t *const slot = aci_queue_tail(&aci_tx_q);
+
+  if (slot == NULL)
+  {
+    perf_count (tx_full);
+    return NULL;
+  }
+
+  return &slot->buffer[0];
+}
+
+bool hal_aci_tl_cmd_commit(void)
+{
+  if (aci_queue_tail(&aci_tx_q)->buffer[0] > HAL_ACI_MAX_LENGTH)
+  {
+    return false;
+  }
+
+  aci_queue_commit(&aci_tx_q);
+  if(!aci_queue_is_full(&aci_rx_q))
+  {
+    m_aci_reqn_enable();
+  }
+
+  return true;
+}
+
 bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data)
 {
   bool was_full;
@@ -234,6 +285,11 @@ bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data)
   {
     m_aci_event_check();
   }
+  else
+  {
+    perf_count (rx_full);
+    live_stall ();
+  }
 
   was_full = aci_queue_is_full(&aci_rx_q);
 
@@ -245,12 +301,54 @@ bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data)
       m_aci_reqn_enable();
     }
 
+    perf_count (aci_events);
+
     return true;
   }
 
   return false;
 }
 
+uint8_t hal_aci_tl_event_drain(void)
+{
+  uint8_t transfers = HAL_ACI_DRAIN_MAX;
+
+  if (aci_queue_is_full(&aci_rx_q))
+  {
+    perf_count (rx_full);
+    live_stall ();
+  }
+  else
+  {
+    /* The first check also lowers REQN for pending commands */
+    do
+    {
+      m_aci_event_check();
+    } while (--transfers && !aci_queue_is_full(&aci_rx_q) &&
+             hal_aci_tl_rdyn());
+  }
+
+  return aci_queue_count(&aci_rx_q);
+}
+
+hal_aci_data_t *hal_aci_tl_event_peek(void)
+{
+  return aci_queue_head(&aci_rx_q);
+}
+
+void hal_aci_tl_event_release(void)
+{
+  aci_queue_release(&aci_rx_q);
+
+  /* Attempt to pull REQN LOW since we've made room for new messages */
+  if (!aci_queue_is_empty(&aci_tx_q))
+  {
+    m_aci_reqn_enable();
+  }
+
+  perf_count (aci_events);
+}
+
 /* Returns true if the rdyn line is low */
 bool hal_aci_tl_rdyn (void)
 {
@@ -52,6 +52,11 @@ SPI and the received ACI event is placed in the tail of the event queue.
 #define HAL_ACI_MAX_LENGTH 31
 #endif
 
+/* Most ACI transfers run by one hal_aci_tl_event_drain() */
+#ifndef HAL_ACI_DRAIN_MAX
+#define HAL_ACI_DRAIN_MAX 8
+#endif
+
 /************************************************************************/
 /* Unused nRF8001 pin                                                    */
 /************************************************************************/
@@ -107,6 +112,21 @@ void hal_aci_tl_init(aci_pins_t *a_pins);
  */
 bool hal_aci_tl_send(hal_aci_data_t *aci_buffer);
 
+/** @brief Get the next free slot of the transmit queue.
+ *  @details
+ *  Lets a command be encoded straight into the queue instead of being built
+ *  in a buffer and copied by hal_aci_tl_send(). The slot is only sent once
+ *  hal_aci_tl_cmd_commit() is called.
+ *  @return Pointer to the length byte of the slot, or NULL if the queue is
+ *  full.
+ */
+uint8_t *hal_aci_tl_cmd_buffer(void);
+
+/** @brief Queue the command encoded in the slot from hal_aci_tl_cmd_buffer().
+ *  @return True if the command was queued, false if its length is invalid.
+ */
+bool hal_aci_tl_cmd_commit(void);
+
 /** @brief Get an ACI event from the event queue
  *  @details
  *  Call this function from the main context to get an event from the ACI event
@@ -114,6 +134,24 @@ bool hal_aci_tl_send(hal_aci_data_t *aci_buffer);
  */
 bool hal_aci_tl_event_get(hal_aci_data_t *p_aci_data);
 
+/** @brief Receive ACI events for as long as the radio has them ready
+ *  @details
+ *  Runs ACI transfers while RDYN stays low and the event queue has room, up
+ *  to HAL_ACI_DRAIN_MAX transfers, so that a burst of events is taken in one
+ *  call. The events are then read in place with hal_aci_tl_event_peek().
+ *  @return Number of events waiting in the event queue.
+ */
+uint8_t hal_aci_tl_event_drain(void);
+
+/** @brief Get the oldest ACI event without copying it
+ *  @return Pointer to the event in the event queue, valid until
+ *  hal_aci_tl_event_release(), or NULL if there is none.
+ */
+hal_aci_data_t *hal_aci_tl_event_peek(void);
+
+/** @brief Drop the event returned by hal_aci_tl_event_peek() */
+void hal_aci_tl_event_release(void);
+
 /** @brief Get the state of the nRF8001 RDYN line
  *  @details
  *  True if rdyn is low, or false.
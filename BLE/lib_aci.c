@@ -39,8 +39,14 @@
 #include "aci_queue.h"
 #include "lib_aci.h"
 
+#include "../perf.h"
+#include "../trace.h"
+
 #define LIB_ACI_DEFAULT_CREDIT_NUMBER   1
 
+/* State that received events are folded into, from lib_aci_init() */
+static aci_state_t *m_aci_stat;
+
 /*
 Global additionally used used in aci_setup
 */
@@ -52,11 +58,28 @@ bool lib_aci_is_pipe_available(aci_state_t *aci_stat, uint8_t pipe)
 
 bool lib_aci_radio_reset(void)
 {
-  static const hal_aci_data_t reset_msg = {
-    .buffer = {MSG_BASEBAND_RESET_LEN, ACI_CMD_RADIO_RESET}
-  };
+  uint8_t* const buffer = hal_aci_tl_cmd_buffer();
+
+  if (buffer == NULL)
+  {
+    return false;
+  }
+
+  acil_encode_cmd_radio_reset(buffer);
+  return hal_aci_tl_cmd_commit();
+}
+
+bool lib_aci_device_version(void)
+{
+  uint8_t* const buffer = hal_aci_tl_cmd_buffer();
+
+  if (buffer == NULL)
+  {
+    return false;
+  }
 
-  return hal_aci_tl_send((hal_aci_data_t *) &reset_msg);
+  acil_encode_cmd_get_device_version(buffer);
+  return hal_aci_tl_cmd_commit();
 }
 
 void lib_aci_init(aci_state_t *aci_stat)
@@ -68,59 +91,51 @@ void lib_aci_init(aci_state_t *aci_stat)
     aci_stat->pipes_closed_bitmap[i]        = 0;
   }
 
+  aci_stat->events_folded = 0;
+  m_aci_stat = aci_stat;
   hal_aci_tl_init(&aci_stat->aci_pins);
 
-  /* If RDYN is not low, there is no message pending on the nrF8001, at which
-   * point we should performa a radio reset to get in a known state.
+  /* If RDYN is not low, there is no message pending on the nrF8001. Rather
+   * than reset it, ask for its version: the response tells the application
+   * whether the nRF8001 is already running its setup, and it only needs a
+   * radio reset when it is not. See lib_aci_probe_ok().
    */
   if (!hal_aci_tl_rdyn()) {
-    lib_aci_radio_reset();
+    lib_aci_device_version();
   }
 }
 
 bool lib_aci_connect(uint16_t run_timeout, uint16_t adv_interval)
 {
-  static hal_aci_data_t connect_msg = {
-    .buffer = {MSG_CONNECT_LEN, ACI_CMD_CONNECT}
-  };
-
-  uint8_t* const buffer = &(connect_msg.buffer[0]);
-
-  *(buffer + OFFSET_ACI_CMD_T_CONNECT +
-      OFFSET_ACI_CMD_PARAMS_CONNECT_T_TIMEOUT_MSB) =
-    (uint8_t)(run_timeout >> 8);
+  aci_cmd_params_connect_t aci_cmd_params_connect;
+  uint8_t* const buffer = hal_aci_tl_cmd_buffer();
 
-  *(buffer + OFFSET_ACI_CMD_T_CONNECT +
-      OFFSET_ACI_CMD_PARAMS_CONNECT_T_TIMEOUT_LSB) =
-    (uint8_t)(run_timeout);
-
-  *(buffer + OFFSET_ACI_CMD_T_CONNECT +
-      OFFSET_ACI_CMD_PARAMS_CONNECT_T_ADV_INTERVAL_MSB) =
-    (uint8_t)(adv_interval >> 8);
-
-  *(buffer + OFFSET_ACI_CMD_T_CONNECT +
-      OFFSET_ACI_CMD_PARAMS_CONNECT_T_ADV_INTERVAL_LSB) =
-    (uint8_t)(adv_interval);
+  if (buffer == NULL)
+  {
+    return false;
+  }
 
-  return hal_aci_tl_send(&connect_msg);
+  aci_cmd_params_connect.timeout      = run_timeout;
+  aci_cmd_params_connect.adv_interval = adv_interval;
+  acil_encode_cmd_connect(buffer, &aci_cmd_params_connect);
+  return hal_aci_tl_cmd_commit();
 }
 
 bool lib_aci_disconnect(aci_state_t *aci_stat, aci_disconnect_reason_t reason)
 {
-  static hal_aci_data_t disconnect_msg = {
-    .buffer = {MSG_DISCONNECT_LEN, ACI_CMD_DISCONNECT}
-  };
+  aci_cmd_params_disconnect_t aci_cmd_params_disconnect;
+  uint8_t* const buffer = hal_aci_tl_cmd_buffer();
 
-  bool ret_val;
-  uint8_t* const buffer = &(disconnect_msg.buffer[0]);
+  if (buffer == NULL)
+  {
+    return false;
+  }
 
-  *(buffer + OFFSET_ACI_CMD_T_DISCONNECT +
-      OFFSET_ACI_CMD_PARAMS_DISCONNECT_T_REASON) =
-    (uint8_t)(reason);
+  aci_cmd_params_disconnect.reason = reason;
+  acil_encode_cmd_disconnect(buffer, &aci_cmd_params_disconnect);
 
-  ret_val = hal_aci_tl_send(&disconnect_msg);
   /* If we have actually sent the disconnect */
-  if (ret_val)
+  if (hal_aci_tl_cmd_commit())
   {
     /* Update pipes immediately so that while the disconnect is happening,
      * the application can't attempt sending another message
@@ -133,87 +148,106 @@ bool lib_aci_disconnect(aci_state_t *aci_stat, aci_disconnect_reason_t reason)
       aci_stat->pipes_open_bitmap[i] = 0;
       aci_stat->pipes_closed_bitmap[i] = 0;
     }
+    return true;
   }
-  return ret_val;
+  return false;
 }
 
 bool lib_aci_send_data(uint8_t pipe, uint8_t *p_value, uint8_t size)
 {
-  static hal_aci_data_t send_data_msg = {
-    .buffer = {MSG_SEND_DATA_BASE_LEN, ACI_CMD_SEND_DATA}
-  };
+  uint8_t* buffer;
 
-  uint8_t* const buffer = &(send_data_msg.buffer[0]);
+  if (size > ACI_PIPE_TX_DATA_MAX_LEN)
+  {
+    return false;
+  }
 
-  *(buffer + OFFSET_ACI_CMD_T_LEN) = MSG_SEND_DATA_BASE_LEN + size;
+  buffer = hal_aci_tl_cmd_buffer();
+  if (buffer == NULL)
+  {
+    return false;
+  }
 
-  *(buffer + OFFSET_ACI_CMD_T_SEND_DATA +
-      OFFSET_ACI_CMD_PARAMS_SEND_DATA_T_TX_DATA +
-      OFFSET_ACI_TX_DATA_T_PIPE_NUMBER) =
-    pipe;
+  acil_encode_cmd_send_data(buffer, pipe, p_value, size);
+  return hal_aci_tl_cmd_commit();
+}
 
-  memcpy((buffer + OFFSET_ACI_CMD_T_SEND_DATA +
-        OFFSET_ACI_CMD_PARAMS_SEND_DATA_T_TX_DATA +
-        OFFSET_ACI_TX_DATA_T_ACI_DATA), p_value, size);
+bool lib_aci_event_get(aci_state_t *aci_stat, hal_aci_evt_t *p_aci_evt_data)
+{
+  /* The state of the ACI is updated by lib_aci_event_fold() as the events
+   * are received, so that it follows the order of the events on the wire
+   */
+  return hal_aci_tl_event_get((hal_aci_data_t *)p_aci_evt_data);
+}
 
-  return hal_aci_tl_send(&send_data_msg);
+uint8_t lib_aci_event_drain(void)
+{
+  return hal_aci_tl_event_drain();
 }
 
-bool lib_aci_event_get(aci_state_t *aci_stat, hal_aci_evt_t *p_aci_evt_data)
+hal_aci_evt_t *lib_aci_event_peek(void)
 {
-  bool status = false;
+  return (hal_aci_evt_t *)hal_aci_tl_event_peek();
+}
 
-  status = hal_aci_tl_event_get((hal_aci_data_t *)p_aci_evt_data);
+void lib_aci_event_release(void)
+{
+  hal_aci_tl_event_release();
+}
 
-  /**
-  Update the state of the ACI with the
-  ACI Events -> Pipe Status, Disconnected, Connected, Bond Status, Pipe Error
-  */
-  if (status)
-  {
-    aci_evt_t * aci_evt;
+bool lib_aci_event_fold(hal_aci_data_t *p_aci_data)
+{
+  aci_evt_t * const aci_evt = &((hal_aci_evt_t *)p_aci_data)->evt;
 
-    aci_evt = &p_aci_evt_data->evt;
+  if (m_aci_stat == NULL)
+  {
+    return false;
+  }
 
-    switch(aci_evt->evt_opcode)
-    {
-        case ACI_EVT_PIPE_STATUS:
-            {
-                memcpy(aci_stat->pipes_open_bitmap,
-                    aci_evt->params.pipe_status.pipes_open_bitmap,
-                    PIPES_ARRAY_SIZE);
-                memcpy(aci_stat->pipes_closed_bitmap,
-                    aci_evt->params.pipe_status.pipes_closed_bitmap,
-                    PIPES_ARRAY_SIZE);
-            }
-            break;
-
-        case ACI_EVT_DISCONNECTED:
-            {
-                uint8_t i=0;
-                for (i=0; i < PIPES_ARRAY_SIZE; i++)
-                {
-                  aci_stat->pipes_open_bitmap[i] = 0;
-                  aci_stat->pipes_closed_bitmap[i] = 0;
-                }
-                aci_stat->confirmation_pending = false;
-                aci_stat->data_credit_available = aci_stat->data_credit_total;
-
-            }
-            break;
-
-        case ACI_EVT_TIMING:
-                aci_stat->connection_interval = aci_evt->params.timing.conn_rf_interval;
-                aci_stat->slave_latency       = aci_evt->params.timing.conn_slave_rf_latency;
-                aci_stat->supervision_timeout = aci_evt->params.timing.conn_rf_timeout;
-            break;
-
-        default:
-            /* Need default case to avoid compiler warnings about missing enum
-             * values on some platforms.
-             */
-            break;
-    }
+  switch(aci_evt->evt_opcode)
+  {
+    case ACI_EVT_DATA_CREDIT:
+      m_aci_stat->data_credit_available += aci_evt->params.data_credit.credit;
+      m_aci_stat->events_folded |= LIB_ACI_FOLDED_DATA_CREDIT;
+      break;
+
+    case ACI_EVT_PIPE_STATUS:
+      memcpy(m_aci_stat->pipes_open_bitmap,
+          aci_evt->params.pipe_status.pipes_open_bitmap,
+          PIPES_ARRAY_SIZE);
+      memcpy(m_aci_stat->pipes_closed_bitmap,
+          aci_evt->params.pipe_status.pipes_closed_bitmap,
+          PIPES_ARRAY_SIZE);
+      m_aci_stat->events_folded |= LIB_ACI_FOLDED_PIPE_STATUS;
+      break;
+
+    case ACI_EVT_DISCONNECTED:
+      {
+        uint8_t i;
+        for (i=0; i < PIPES_ARRAY_SIZE; i++)
+        {
+          m_aci_stat->pipes_open_bitmap[i] = 0;
+          m_aci_stat->pipes_closed_bitmap[i] = 0;
+        }
+        m_aci_stat->confirmation_pending = false;
+        m_aci_stat->data_credit_available = m_aci_stat->data_credit_total;
+      }
+      /* Still queued for the application */
+      return false;
+
+    case ACI_EVT_TIMING:
+      m_aci_stat->connection_interval = aci_evt->params.timing.conn_rf_interval;
+      m_aci_stat->slave_latency       = aci_evt->params.timing.conn_slave_rf_latency;
+      m_aci_stat->supervision_timeout = aci_evt->params.timing.conn_rf_timeout;
+      m_aci_stat->events_folded |= LIB_ACI_FOLDED_TIMING;
+      break;
+
+    default:
+      return false;
   }
-  return status;
+
+  trace_record (TRACE_ACI_EVT, aci_evt->evt_opcode);
+  perf_count (aci_folded);
+
+  return true;
 }
@@ -116,8 +116,18 @@ typedef struct aci_state_t
   bool                          confirmation_pending;
 
   /* End : Variables that are valid only when in a connection */
+
+  /* LIB_ACI_FOLDED_* bits of the events folded in by lib_aci_event_fold()
+   * since the application last cleared them
+   */
+  uint8_t                       events_folded;
 } aci_state_t;
 
+/* Events that lib_aci_event_fold() applies to aci_state_t on receipt */
+#define LIB_ACI_FOLDED_DATA_CREDIT      0x01
+#define LIB_ACI_FOLDED_PIPE_STATUS      0x02
+#define LIB_ACI_FOLDED_TIMING           0x04
+
 
 
 #define DISCONNECT_REASON_CX_TIMEOUT                 0x08
@@ -157,6 +167,26 @@ bool lib_aci_is_pipe_available(aci_state_t *aci_stat, uint8_t pipe);
  */
 bool lib_aci_radio_reset(void);
 
+/** @brief Asks the radio for its version.
+ *  @details The function sends a @c GetDeviceVersion command to the radio.
+ *    lib_aci_init() uses it to probe an nRF8001 that has no event pending.
+ *  @return True if the transaction is successfully initiated.
+ */
+bool lib_aci_device_version(void);
+
+/** @brief Checks the response to the probe sent by lib_aci_init().
+ *  @details An nRF8001 that answers @c GetDeviceVersion successfully with a
+ *    complete setup is in Standby or already advertising or connected, and
+ *    keeps its bond and link. Anything else needs a radio reset.
+ *  @param cmd_rsp Parameters of the ACI_EVT_CMD_RSP for @c GetDeviceVersion.
+ *  @return True if the nRF8001 can be used as it is.
+ */
+static inline bool lib_aci_probe_ok(const aci_evt_params_cmd_rsp_t *cmd_rsp)
+{
+  return cmd_rsp->cmd_status == ACI_STATUS_SUCCESS &&
+    cmd_rsp->params.get_device_version.setup_status != 0;
+}
+
 /* @} */
 
 /** @name ACI commands available in Active mode */
@@ -211,6 +241,34 @@ bool lib_aci_send_data(uint8_t pipe, uint8_t *value, uint8_t size);
 */
 bool lib_aci_event_get(aci_state_t *aci_stat, hal_aci_evt_t * aci_evt);
 
+/** @brief Receives the ACI events the radio has ready in one go
+ *  @details Runs ACI transfers for as long as the nRF8001 has events ready
+ *    and the event queue has room. The events are then handled in place with
+ *    lib_aci_event_peek() and lib_aci_event_release(), without the copy and
+ *    the transfer done by lib_aci_event_get() for each of them.
+ *  @return Number of events waiting in the event queue.
+*/
+uint8_t lib_aci_event_drain(void);
+
+/** @brief Gets the oldest ACI event in place
+ *  @return Pointer to the event, valid until lib_aci_event_release(), or
+ *    NULL if the event queue is empty.
+*/
+hal_aci_evt_t *lib_aci_event_peek(void);
+
+/** @brief Drops the event returned by lib_aci_event_peek() */
+void lib_aci_event_release(void);
+
+/** @brief Folds a received ACI event into the ACI state
+ *  @details Called by the transport for every event it receives, before the
+ *    event is queued, to update the state given to lib_aci_init(). Data
+ *    Credit, Pipe Status and Timing events do nothing else; they are flagged
+ *    in aci_state_t.events_folded and never take a slot in the event queue.
+ *  @param p_aci_data pointer to the received ACI Event.
+ *  @return True if the event was folded and must not be queued.
+*/
+bool lib_aci_event_fold(hal_aci_data_t *p_aci_data);
+
 /* @} */
 
 /* @} */
@@ -0,0 +1,3 @@
+#include "arena.h"
+
+arena_t arena __attribute__((section (".noinit")));
@@ -0,0 +1,64 @@
+/* RAM shared by the two transports.
+ *
+ * A session is either BLE or UART: once main() has seen STK_GET_SYNC it
+ * stays in uart_update(), and a BLE DFU never hands over to the UART. The
+ * buffers of the two are therefore laid over each other in one arena
+ * instead of each taking RAM of its own:
+ *
+ *  - BLE: the ACI transmit and receive queues of hal_aci_tl.c, and the
+ *    DFU_PAGE_BUFFERS page buffers of dfu.c,
+ *  - UART: the page buffer of STK_PROG_PAGE and STK_READ_PAGE, and the
+ *    vectors saved by VIRTUAL_BOOT_PARTITION.
+ *
+ * The BLE queues are in use from lib_aci_init() on, also while main() still
+ * waits for either link, so the UART layout may only be touched from
+ * uart_update(). The arena is not zero initialised; every user sets up its
+ * own part.
+ *
+ * On parts with 2 KB of RAM or more the BLE layout is the larger of the
+ * two, and ACI_QUEUE_SIZE and DFU_PAGE_BUFFERS default to 4 and 2 to use it.
+ */
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#include "BLE/aci_queue.h"
+
+/* Pages of the image held in RAM while the flash is busy, a power of two.
+ * With two, the next page is received while the last one is erased and
+ * written, see dfu.c.
+ */
+#ifndef DFU_PAGE_BUFFERS
+#if RAMEND >= 0x800
+#define DFU_PAGE_BUFFERS  2
+#else
+#define DFU_PAGE_BUFFERS  1
+#endif
+#endif
+
+typedef union
+{
+  struct
+  {
+    aci_queue_t aci_tx_q;
+    aci_queue_t aci_rx_q;
+#ifndef PAGE_STREAM
+    uint8_t     page_buff[DFU_PAGE_BUFFERS][SPM_PAGESIZE];
+#endif
+  } ble;
+
+  struct
+  {
+    uint8_t     buff[SPM_PAGESIZE * 2];
+#ifdef VIRTUAL_BOOT_PARTITION
+    uint16_t    rst_vect;
+    uint16_t    wdt_vect;
+#endif
+  } uart;
+} arena_t;
+
+extern arena_t arena;
+
+#endif /* ARENA_H_ */
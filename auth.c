@@ -0,0 +1,92 @@
+#include "auth.h"
+
+#define ROTL(x, b)  (uint32_t) (((x) << (b)) | ((x) >> (32 - (b))))
+
+static uint32_t m_load32 (const uint8_t *p)
+{
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 |
+         (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static void m_rounds (uint32_t *v, uint8_t n)
+{
+  do
+  {
+    v[0] += v[1]; v[1] = ROTL(v[1], 5);  v[1] ^= v[0]; v[0] = ROTL(v[0], 16);
+    v[2] += v[3]; v[3] = ROTL(v[3], 8);  v[3] ^= v[2];
+    v[0] += v[3]; v[3] = ROTL(v[3], 7);  v[3] ^= v[0];
+    v[2] += v[1]; v[1] = ROTL(v[1], 13); v[1] ^= v[2]; v[2] = ROTL(v[2], 16);
+  } while (--n);
+}
+
+/* Two compression rounds over one message word */
+static void m_compress (uint32_t *v, uint32_t m)
+{
+  v[3] ^= m;
+  m_rounds (v, 2);
+  v[0] ^= m;
+}
+
+static void m_store32 (uint8_t *p, uint32_t x)
+{
+  p[0] = (uint8_t) (x);
+  p[1] = (uint8_t) (x >> 8);
+  p[2] = (uint8_t) (x >> 16);
+  p[3] = (uint8_t) (x >> 24);
+}
+
+void auth_mac_init (auth_mac_t *mac, const uint8_t *key)
+{
+  const uint32_t k0 = m_load32 (key);
+  const uint32_t k1 = m_load32 (key + 4);
+
+  mac->v[0] = k0;
+  mac->v[1] = k1 ^ 0xEE;      /* 64-bit output */
+  mac->v[2] = k0 ^ 0x6C796765;
+  mac->v[3] = k1 ^ 0x74656462;
+  mac->m = 0;
+  mac->len = 0;
+}
+
+void auth_mac_update (auth_mac_t *mac, const uint8_t *data, uint8_t len)
+{
+  while (len--)
+  {
+    const uint8_t shift = (mac->len & 3) * 8;
+
+    mac->m |= (uint32_t) *data++ << shift;
+    if ((++mac->len & 3) == 0)
+    {
+      m_compress (mac->v, mac->m);
+      mac->m = 0;
+    }
+  }
+}
+
+void auth_mac_final (auth_mac_t *mac, uint8_t *tag)
+{
+  uint32_t *const v = mac->v;
+
+  m_compress (v, mac->m | (uint32_t) mac->len << 24);
+
+  v[2] ^= 0xEE;
+  m_rounds (v, 4);
+  m_store32 (tag, v[1] ^ v[3]);
+
+  v[1] ^= 0xDD;
+  m_rounds (v, 4);
+  m_store32 (tag + 4, v[1] ^ v[3]);
+}
+
+bool auth_tag_equal (const uint8_t *a, const uint8_t *b)
+{
+  uint8_t diff = 0;
+  uint8_t i;
+
+  for (i = 0; i < AUTH_TAG_SIZE; i++)
+  {
+    diff |= a[i] ^ b[i];
+  }
+
+  return diff == 0;
+}
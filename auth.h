@@ -0,0 +1,46 @@
+/* Authenticated BLE DFU images, built in with DFU_AUTH=1.
+ *
+ * The image is authenticated with HalfSipHash-2-4, the 32-bit variant of
+ * SipHash, which suits the AVR far better than the 64-bit original, with
+ * a 64-bit key and a 64-bit tag. The key is kept in EEPROM at
+ * AUTH_KEY_EEPROM_ADDR, below the session history ring, where the
+ * application must leave it alone.
+ *
+ * The central sends the tag of the whole image as the last AUTH_TAG_SIZE
+ * bytes of the init packet. dfu.c adds each data packet to the MAC as it
+ * arrives, so OP_CODE_VALIDATE only finishes the MAC and compares the tags,
+ * in the same time whatever the image, without reading the flash back. An
+ * image whose tag does not match is never activated.
+ *
+ * auth_mac_*() keep no state of their own, so host tools can tag images
+ * with the same code.
+ */
+#ifndef AUTH_H_
+#define AUTH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+
+#include "history.h"
+
+#define AUTH_KEY_SIZE         8
+#define AUTH_TAG_SIZE         8
+
+#define AUTH_KEY_EEPROM_ADDR  (HISTORY_EEPROM_ADDR - AUTH_KEY_SIZE)
+
+typedef struct
+{
+  uint32_t v[4];
+  uint32_t m;               /* Bytes of the next word received so far */
+  uint8_t  len;             /* Message length, modulo 256 */
+} auth_mac_t;
+
+void auth_mac_init (auth_mac_t *mac, const uint8_t *key);
+void auth_mac_update (auth_mac_t *mac, const uint8_t *data, uint8_t len);
+void auth_mac_final (auth_mac_t *mac, uint8_t *tag);
+
+/* Compare two tags in constant time, returns true if they match */
+bool auth_tag_equal (const uint8_t *a, const uint8_t *b);
+
+#endif /* AUTH_H_ */
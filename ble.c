@@ -0,0 +1,220 @@
+#include "ble.h"
+
+#include <avr/eeprom.h>
+#include <avr/wdt.h>
+#include <util/delay.h>
+
+#include "bootlog.h"
+#include "history.h"
+#include "jump.h"
+#include "live.h"
+#include "perf.h"
+#include "trace.h"
+
+#include "BLE/bonding.h"
+#include "BLE/aci_evts.h"
+#include "BLE/dfu.h"
+
+/* BLE block of the bootloader configuration, at the end of the EEPROM */
+#define EE_BASE           (E2END - BOOTLOADER_EEPROM_SIZE)
+#define EE_VALID_BLE      ((const uint8_t *) (EE_BASE + 1))
+#define EE_PINS           ((const uint8_t *) (EE_BASE + 2))
+#define EE_CREDITS        ((const uint8_t *) (EE_BASE + 14))
+#define EE_PIPES          ((const uint8_t *) (EE_BASE + 15))
+#define EE_CONN_TIMEOUT   ((const uint8_t *) (EE_BASE + 18))
+#define EE_CONN_INTERVAL  ((const uint8_t *) (EE_BASE + 20))
+
+struct aci_state_t aci_state;
+uint8_t dfu_mode;
+
+static uint8_t m_pipes[3];
+static uint16_t m_conn_timeout;
+static uint16_t m_conn_interval;
+
+static void ble_event (aci_evt_t *aci_evt);
+
+/* wdr, without the interrupt handling of wdt_enable() */
+static inline void watchdogReset (void)
+{
+  wdt_reset ();
+  bootlog_wdr ();
+}
+
+uint8_t ble_init (void)
+{
+  if (eeprom_read_byte (EE_VALID_BLE) != 1)
+  {
+    return 0;
+  }
+
+  /* Read pin data */
+  eeprom_read_block ((void *) &aci_state.aci_pins, EE_PINS,
+      sizeof(aci_pins_t));
+
+  /* Read credit data */
+  aci_state.data_credit_total = eeprom_read_byte (EE_CREDITS);
+  aci_state.data_credit_available = aci_state.data_credit_total;
+
+  /* Read pipe data */
+  eeprom_read_block ((void *) &m_pipes, EE_PIPES, 3);
+
+  /* Read connection timeout */
+  eeprom_read_block ((void *) &m_conn_timeout, EE_CONN_TIMEOUT, 2);
+
+  /* Read connection advertise interval */
+  eeprom_read_block ((void *) &m_conn_interval, EE_CONN_INTERVAL, 2);
+  bootlog_stamp (BOOT_EEPROM);
+
+  lib_aci_init (&aci_state);
+  bootlog_stamp (BOOT_ACI_INIT);
+
+  dfu_init (m_pipes);
+
+  return 1;
+}
+
+/* Get and process events from the BLE link. If we detect an event indicating
+ * that we are about to receive a new firmware image on BLE we set "dfu_mode"
+ * to a true value.
+ */
+void ble_update (void)
+{
+  hal_aci_evt_t *aci_data;
+
+  history_tick ();
+  dfu_flash_poll ();
+  live_poll ();
+
+  /* Take every event the nRF8001 has ready, then handle them in place */
+  lib_aci_event_drain();
+
+  /* Events the transport folded straight into aci_state */
+  if (aci_state.events_folded) {
+    if (aci_state.events_folded & LIB_ACI_FOLDED_DATA_CREDIT) {
+      watchdogReset();
+      live_record (LIVE_CREDITS, aci_state.data_credit_available);
+    }
+    if (aci_state.events_folded & LIB_ACI_FOLDED_TIMING) {
+      history_interval (aci_state.connection_interval, 0);
+    }
+    aci_state.events_folded = 0;
+  }
+
+  while ((aci_data = lib_aci_event_peek()) != NULL) {
+    ble_event (&aci_data->evt);
+    lib_aci_event_release();
+  }
+}
+
+/* Handle one ACI event, in place in the event queue */
+static void ble_event (aci_evt_t *aci_evt)
+{
+  uint8_t pipe;
+  uint8_t eeprom_status = 0xFF;
+
+  const uint8_t *bond_status_addr     = (uint8_t *) (0);
+
+  trace_record (TRACE_ACI_EVT, aci_evt->evt_opcode);
+
+  switch(aci_evt->evt_opcode) {
+    case ACI_EVT_DEVICE_STARTED:
+      bootlog_stamp (BOOT_DEVICE_STARTED);
+      aci_state.data_credit_total =
+        aci_evt->params.device_started.credit_available;
+      if (aci_evt->params.device_started.device_mode == ACI_DEVICE_STANDBY) {
+        if (aci_evt->params.device_started.hw_error) {
+            /* Magic number used to make sure the HW error event
+             * is handled correctly. */
+            _delay_ms (20);
+        }
+        else
+        {
+          /* Check to see if we should read bond data from EEPROM */
+          eeprom_read_block ((void *) &eeprom_status, bond_status_addr, 1);
+
+          if (eeprom_status != 0xFF)
+          {
+            bond_data_restore (&aci_state, eeprom_status);
+            bootlog_stamp (BOOT_BOND_RESTORE);
+          }
+
+          if (lib_aci_connect (m_conn_timeout, m_conn_interval))
+          {
+            bootlog_stamp (BOOT_ADVERTISING);
+          }
+        }
+      }
+      break; /* ACI_EVT_DEVICE_STARTED */
+
+    case ACI_EVT_CMD_RSP:
+      if ((aci_evt->params.cmd_rsp.cmd_opcode == ACI_CMD_RADIO_RESET) &&
+          (aci_evt->params.cmd_rsp.cmd_status == ACI_STATUS_SUCCESS))
+      {
+        lib_aci_connect (m_conn_timeout, m_conn_interval);
+      }
+      else if (aci_evt->params.cmd_rsp.cmd_opcode ==
+               ACI_CMD_GET_DEVICE_VERSION)
+      {
+        /* The probe from lib_aci_init(). A running nRF8001 keeps its bond
+         * and any link; if it is already advertising or connected, the
+         * connect fails and changes nothing.
+         */
+        if (lib_aci_probe_ok (&aci_evt->params.cmd_rsp))
+        {
+          if (lib_aci_connect (m_conn_timeout, m_conn_interval))
+          {
+            bootlog_stamp (BOOT_ADVERTISING);
+          }
+        }
+        else
+        {
+          lib_aci_radio_reset ();
+        }
+      }
+      break; /* ACI_EVT_CMD_RSP */
+
+    case ACI_EVT_CONNECTED:
+      watchdogReset();
+      bootlog_stamp (BOOT_CONNECTED);
+      /* We should have checked that this is true before we jumped into
+       * the bootloader. Hopefully we did.
+       */
+      aci_state.data_credit_available = aci_state.data_credit_total;
+      history_interval (aci_evt->params.connected.conn_rf_interval, 1);
+      break; /* ACI_EVT_CONNECTED */
+
+    case ACI_EVT_DISCONNECTED:
+      lib_aci_connect (m_conn_timeout, m_conn_interval);
+      break; /* ACI_EVT_DISCONNECTED */
+
+    case ACI_EVT_PIPE_ERROR:
+      watchdogReset();
+      perf_count (pipe_errors);
+      /* If we received a pipe error, some message got borked.
+       * All we can do is update our credit to reflect it
+       */
+      if (aci_evt->params.pipe_error.error_code !=
+          ACI_STATUS_ERROR_PEER_ATT_ERROR) {
+        aci_state.data_credit_available++;
+      }
+      break; /* ACI_EVT_PIPE_ERROR */
+
+    case ACI_EVT_DATA_RECEIVED:
+      watchdogReset();
+      /* If data received is on either of the DFU pipes, we enter DFU mode.
+       * We then update the DFU state machine to run the transfer.
+       */
+      pipe = aci_evt->params.data_received.rx_data.pipe_number;
+      if (pipe == m_pipes[0] || pipe == m_pipes[2]) {
+        if (!dfu_mode) {
+          dfu_mode = 1;
+        }
+
+        dfu_update(&aci_state, aci_evt);
+      }
+      break; /* ACI_EVT_DATA_RECEIVED */
+
+    default:
+      break;
+  }
+}
@@ -0,0 +1,34 @@
+/* The BLE link of the bootloader: the nRF8001 configuration from EEPROM and
+ * the ACI event loop that hands DFU traffic to dfu.c.
+ *
+ * main() in optiboot.c calls ble_init() once and ble_update() whenever it
+ * polls the links, for as long as dfu_mode stays set once a transfer has
+ * started. host/host_dfu.c runs the same code against the nRF8001 model,
+ * so only the HAL and the MCU differ between the bootloader and its host
+ * tests.
+ */
+#ifndef BLE_H_
+#define BLE_H_
+
+#include <stdint.h>
+
+#include "BLE/lib_aci.h"
+
+extern struct aci_state_t aci_state;
+
+/* Set once data arrives on a DFU pipe: the BLE link is then used for the
+ * rest of the session
+ */
+extern uint8_t dfu_mode;
+
+/* Read the BLE block of the bootloader EEPROM configuration and, if it is
+ * valid, start the ACI and the DFU service. Returns 1 if it was valid.
+ */
+uint8_t ble_init (void);
+
+/* Handle every ACI event the nRF8001 has ready, and move the flash writes
+ * of dfu.c along
+ */
+void ble_update (void);
+
+#endif /* BLE_H_ */
@@ -0,0 +1,58 @@
+#include "bootlog.h"
+
+#ifdef BOOTLOG
+
+#include <string.h>
+
+/* Timer1 ticks in a 16 ms watchdog period */
+#define BOOTLOG_WDT_TICKS (F_CPU / 64000)
+
+bootlog_t boot_log __attribute__((section (".noinit")));
+
+static uint16_t m_now (void)
+{
+  return boot_log.base + TCNT1;
+}
+
+void bootlog_init (void)
+{
+  memset (&boot_log, 0xFF, sizeof(boot_log));
+  boot_log.magic = BOOTLOG_MAGIC;
+  boot_log.mcusr = MCUSR;
+  boot_log.wdt = 0;
+  boot_log.base = 0;
+}
+
+void bootlog_app (void)
+{
+  uint8_t n = (boot_log.wdt & (_BV(WDP2) | _BV(WDP1) | _BV(WDP0))) |
+              ((boot_log.wdt & _BV(WDP3)) ? 8 : 0);
+
+  if (boot_log.magic != BOOTLOG_MAGIC)
+  {
+    return;
+  }
+
+  /* 16 ms doubled n times, from the last wdr of the bootloader */
+  boot_log.stamp[BOOT_APP] = boot_log.wdr +
+    ((uint16_t) BOOTLOG_WDT_TICKS << n);
+}
+
+void bootlog_stamp (uint8_t stage)
+{
+  if (boot_log.stamp[stage] == BOOTLOG_NONE)
+  {
+    boot_log.stamp[stage] = m_now ();
+  }
+}
+
+void bootlog_led (uint8_t count)
+{
+  /* Each flash waits for Timer1 to count F_CPU/(1024*16) ticks to overflow */
+  boot_log.base = boot_log.stamp[BOOT_UART_INIT] +
+    count * (uint16_t) (F_CPU / (1024L * 16));
+  bootlog_stamp (BOOT_LED_FLASH);
+  boot_log.wdr = boot_log.stamp[BOOT_LED_FLASH];
+}
+
+#endif /* BOOTLOG */
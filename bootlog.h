@@ -0,0 +1,76 @@
+/* Boot stage timestamps, built in with BOOTLOG=1.
+ *
+ * main() starts Timer1 at F_CPU/1024 on every reset that runs the
+ * bootloader, a few cycles after jump_check() has started the log. Each
+ * stage below is stamped the first time it is reached, in Timer1 ticks
+ * since that reset (64 us at 16 MHz, wrapping after 4.2 s). Stages that
+ * were not reached read BOOTLOG_NONE. The log is kept in .noinit for the
+ * application: find boot_log in the bootloader's .map file;
+ * magic is BOOTLOG_MAGIC when it is valid.
+ *
+ * The bootloader hands over to the application through a watchdog reset,
+ * which stops Timer1. BOOT_APP is therefore worked out from the last
+ * watchdog reset and the nominal watchdog period, which the watchdog
+ * oscillator only holds to about 10%.
+ */
+#ifndef BOOTLOG_H_
+#define BOOTLOG_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#define BOOTLOG_MAGIC       0xB007
+#define BOOTLOG_NONE        0xFFFF
+
+/* Stages, in the order a BLE boot normally reaches them */
+#define BOOT_UART_INIT      0   /* UART and watchdog set up */
+#define BOOT_LED_FLASH      1   /* Start-up LED flashes done */
+#define BOOT_EEPROM         2   /* nRF8001 configuration read from EEPROM */
+#define BOOT_ACI_INIT       3   /* lib_aci_init() returned */
+#define BOOT_DEVICE_STARTED 4   /* First ACI_EVT_DEVICE_STARTED */
+#define BOOT_BOND_RESTORE   5   /* Bond data restored to the nRF8001 */
+#define BOOT_ADVERTISING    6   /* First lib_aci_connect() */
+#define BOOT_CONNECTED      7   /* First ACI_EVT_CONNECTED */
+#define BOOT_APP            8   /* Application started */
+#define BOOT_STAGES         9
+
+typedef struct
+{
+  uint16_t magic;
+  uint8_t  mcusr;               /* Reset cause seen by jump_check() */
+  uint8_t  wdt;                 /* Last WDTCSR setting */
+  uint16_t base;                /* Added to TCNT1, see bootlog_led() */
+  uint16_t wdr;                 /* Time of the last watchdog reset */
+  uint16_t stamp[BOOT_STAGES];
+} bootlog_t;
+
+#ifdef BOOTLOG
+
+extern bootlog_t boot_log;
+
+/* Start a new log, from jump_check() */
+void bootlog_init (void);
+
+/* Stamp BOOT_APP, from jump_check() before it starts the application */
+void bootlog_app (void);
+
+void bootlog_stamp (uint8_t stage);
+
+/* flash_led() reloads TCNT1; account for count flashes of 1/16 s */
+void bootlog_led (uint8_t count);
+
+#define bootlog_wdr()   (boot_log.wdr = boot_log.base + TCNT1)
+#define bootlog_wdt(x)  do { boot_log.wdt = (x); bootlog_wdr (); } while (0)
+
+#else
+
+#define bootlog_init()        do {} while (0)
+#define bootlog_app()         do {} while (0)
+#define bootlog_stamp(stage)  do {} while (0)
+#define bootlog_led(count)    do {} while (0)
+#define bootlog_wdr()         do {} while (0)
+#define bootlog_wdt(x)        do {} while (0)
+
+#endif /* BOOTLOG */
+
+#endif /* BOOTLOG_H_ */
@@ -0,0 +1,38 @@
+# Section sizes of a bootloader image against its boot section, from the
+# output of "avr-size -A -d".  The boot section runs from the start of
+# .text to the end of .version, which the Makefile places in the last word
+# of flash; .data is loaded from flash right after .text.
+#
+#   avr-size -A -d optiboot_atmega328.elf | awk -f bootsize.awk
+#
+# Exits non-zero if the image overruns the boot section.
+
+$1 == ".text"    { text = $2; start = $3 }
+$1 == ".data"    { data = $2 }
+$1 == ".version" { version = $2; end = $3 + $2 }
+$1 == ".bss"     { bss = $2 }
+$1 == ".noinit"  { noinit = $2 }
+
+END {
+  if (!end)
+  {
+    print "bootsize: no .version section, cannot tell the boot section size" > "/dev/stderr"
+    exit 1
+  }
+
+  boot = end - start
+  free = boot - text - data - version
+
+  printf "boot section 0x%x-0x%x, %d words\n", start, end - 1, boot / 2
+  printf "  .text     %5d words\n", (text + 1) / 2
+  printf "  .data     %5d words\n", (data + 1) / 2
+  printf "  .version  %5d words\n", version / 2
+  printf "  free      %5d words\n", free / 2
+  printf "RAM: .data %d, .bss %d, .noinit %d bytes\n", data, bss, noinit
+
+  if (free < 0)
+  {
+    print "bootsize: image does not fit in the boot section" > "/dev/stderr"
+    exit 1
+  }
+}
@@ -0,0 +1,61 @@
+#include "capture.h"
+
+#ifdef ACI_CAPTURE
+
+#include <avr/io.h>
+
+#include "BLE/hal_aci_tl.h"
+
+static void m_block (const uint8_t *msg)
+{
+  /* As many bytes as the transfer clocked */
+  uint8_t len = msg[0] > HAL_ACI_MAX_LENGTH ? HAL_ACI_MAX_LENGTH : msg[0];
+
+  capture_out (len);
+  while (len--)
+  {
+    capture_out (*++msg);
+  }
+}
+
+static void m_stamp (void)
+{
+  const uint16_t time = TCNT1;
+
+  capture_out (CAPTURE_SYNC);
+  capture_out ((uint8_t) time);
+  capture_out ((uint8_t) (time >> 8));
+}
+
+void capture_init (void)
+{
+  const uint16_t khz = F_CPU / 1000;
+  uint8_t i;
+
+  for (i = 0; i < sizeof(CAPTURE_MAGIC) - 1; i++)
+  {
+    capture_out (CAPTURE_MAGIC[i]);
+  }
+  capture_out (CAPTURE_VERSION);
+  capture_out ((uint8_t) khz);
+  capture_out ((uint8_t) (khz >> 8));
+
+  /* An empty record: the time the bootloader started */
+  m_stamp ();
+  capture_out (0);
+  capture_out (0);
+}
+
+void capture_spi (const uint8_t *cmd, const uint8_t *evt)
+{
+  if (cmd[0] == 0 && evt[0] == 0)
+  {
+    return;
+  }
+
+  m_stamp ();
+  m_block (cmd);
+  m_block (evt);
+}
+
+#endif /* ACI_CAPTURE */
@@ -0,0 +1,51 @@
+/* ACI SPI capture, built in with ACI_CAPTURE=1.
+ *
+ * Every SPI transfer with the nRF8001 that moves a command or an event is
+ * sent out on the UART, which a BLE session leaves idle, as a record:
+ *
+ *   CAPTURE_SYNC, time (2 bytes, little-endian),
+ *   command length, command bytes, event length, event bytes
+ *
+ * The lengths are those of the ACI messages, the first byte of their
+ * buffers, and either may be 0. The stream starts with CAPTURE_MAGIC, the
+ * version and F_CPU in kHz (2 bytes), and a record with neither, as
+ * capture_init() runs at start-up: the time the others count from.
+ * Time is Timer1 at F_CPU/1024 as in trace.h, 64 us per tick at 16 MHz,
+ * wrapping every 4.2 s; a session has a transfer at least every connection
+ * interval, so a reader unwraps it by adding the differences.
+ *
+ * Output uses putch() and takes about 87 us per byte at 115200 baud, which
+ * delays the transfers that follow: the stamps are when the bootloader
+ * clocked each transfer, slowed down by the capture itself. host/hostboot
+ * -R replays a capture against the BLE modules, see host/aci_replay.h.
+ * Not for boards that are also programmed over the UART: the records would
+ * precede avrdude's sync.
+ */
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC     "ACAP"
+#define CAPTURE_VERSION   1
+#define CAPTURE_SYNC      0xA5
+
+#ifdef ACI_CAPTURE
+
+/* Send the header */
+void capture_init (void);
+
+/* After a transfer, with the length-prefixed buffers of both directions */
+void capture_spi (const uint8_t *cmd, const uint8_t *evt);
+
+/* One byte of output, provided by the caller: putch() in optiboot.c */
+void capture_out (uint8_t byte);
+
+#else
+
+#define capture_init()          do {} while (0)
+#define capture_spi(cmd, evt)   do {} while (0)
+
+#endif /* ACI_CAPTURE */
+
+#endif /* CAPTURE_H_ */
@@ -0,0 +1,188 @@
+#include "history.h"
+
+#ifdef HISTORY
+
+#include <avr/eeprom.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HISTORY_ACTIVE  0x4853
+
+/* Intervals averaged before the sum is halved */
+#define HISTORY_SAMPLES 16
+
+/* EEPROM addresses of an entry and of its sequence number */
+#define m_entry(slot)   ((uint8_t *) (HISTORY_EEPROM_ADDR + \
+                           (slot) * sizeof(history_entry_t)))
+#define m_seq(slot)     (m_entry (slot) + offsetof(history_entry_t, seq))
+
+/* The session in progress, kept across a reset until it is written out */
+static struct
+{
+  uint16_t        magic;          /* HISTORY_ACTIVE once started */
+  uint8_t         start;          /* Clock at history_start() */
+  uint8_t         last;           /* Timer1 high byte at the last tick */
+  uint8_t         wraps;          /* Timer1 wraps since history_init() */
+  uint8_t         samples;
+  uint16_t        interval_sum;
+  history_entry_t entry;
+} m_session __attribute__((section (".noinit")));
+
+static uint8_t m_seq_next (uint8_t seq)
+{
+  return seq == HISTORY_SEQ_MAX ? 0 : seq + 1;
+}
+
+/* Slot of the newest entry, HISTORY_ENTRIES if the ring is empty */
+static uint8_t m_newest (void)
+{
+  uint8_t seq = eeprom_read_byte (m_seq (0));
+  uint8_t i;
+
+  if (seq > HISTORY_SEQ_MAX)
+  {
+    return HISTORY_ENTRIES;
+  }
+
+  for (i = 1; i < HISTORY_ENTRIES; i++)
+  {
+    uint8_t next = eeprom_read_byte (m_seq (i));
+
+    if (next != m_seq_next (seq))
+    {
+      break;
+    }
+    seq = next;
+  }
+
+  return i - 1;
+}
+
+static uint16_t m_clock (void)
+{
+  return (uint16_t) m_session.wraps << 8 | m_session.last;
+}
+
+/* Fill in the totals and write the entry after the newest one */
+static void m_write (uint8_t status)
+{
+  history_entry_t *e = &m_session.entry;
+  uint8_t slot = m_newest ();
+  uint8_t seq = 0;
+  uint8_t pages;
+
+  if (slot < HISTORY_ENTRIES)
+  {
+    seq = m_seq_next (eeprom_read_byte (m_seq (slot)));
+    slot = slot + 1 == HISTORY_ENTRIES ? 0 : slot + 1;
+  }
+  else
+  {
+    slot = 0;
+  }
+
+  if (e->image_size == 0)
+  {
+    e->image_size = e->pages_written * SPM_PAGESIZE;
+  }
+  pages = (e->image_size + SPM_PAGESIZE - 1) / SPM_PAGESIZE;
+
+  e->status = status;
+  e->duration = m_clock () - m_session.start;
+  e->conn_interval = m_session.samples ?
+    m_session.interval_sum / m_session.samples : 0;
+  e->pages_skipped = pages > e->pages_written ? pages - e->pages_written : 0;
+  e->seq = seq;
+
+  /* The sequence number goes last, so a torn write is not the newest */
+  eeprom_update_block (e, m_entry (slot), sizeof(*e) - 1);
+  eeprom_update_byte (m_seq (slot), seq);
+
+  m_session.magic = 0;
+}
+
+void history_init (void)
+{
+  if (m_session.magic == HISTORY_ACTIVE)
+  {
+    m_write (HISTORY_INTERRUPTED);
+  }
+
+  memset (&m_session, 0, sizeof(m_session));
+  m_session.last = TCNT1 >> 8;
+}
+
+void history_tick (void)
+{
+  uint8_t now = TCNT1 >> 8;
+
+  if (now < m_session.last)
+  {
+    m_session.wraps++;
+  }
+  m_session.last = now;
+}
+
+void history_start (uint8_t transport, uint16_t image_size)
+{
+  history_tick ();
+
+  m_session.magic = HISTORY_ACTIVE;
+  m_session.start = m_session.last;
+  m_session.wraps = 0;
+  m_session.entry.transport = transport;
+  m_session.entry.image_size = image_size;
+  m_session.entry.pages_written = 0;
+  m_session.entry.reconnects = 0;
+}
+
+void history_interval (uint16_t interval, uint8_t connected)
+{
+  if (connected && m_session.magic == HISTORY_ACTIVE &&
+      m_session.entry.reconnects < 0xFF)
+  {
+    m_session.entry.reconnects++;
+  }
+
+  if (m_session.samples == HISTORY_SAMPLES)
+  {
+    m_session.interval_sum /= 2;
+    m_session.samples /= 2;
+  }
+  m_session.interval_sum += interval;
+  m_session.samples++;
+}
+
+void history_page (void)
+{
+  if (m_session.entry.pages_written < 0xFF)
+  {
+    m_session.entry.pages_written++;
+  }
+}
+
+void history_end (uint8_t status)
+{
+  if (m_session.magic == HISTORY_ACTIVE)
+  {
+    history_tick ();
+    m_write (status);
+  }
+}
+
+uint8_t history_read (uint8_t n, history_entry_t *entry)
+{
+  uint8_t slot = m_newest ();
+
+  if (slot == HISTORY_ENTRIES || n >= HISTORY_ENTRIES)
+  {
+    return 0;
+  }
+
+  slot = (slot + HISTORY_ENTRIES - n) % HISTORY_ENTRIES;
+  eeprom_read_block (entry, m_entry (slot), sizeof(*entry));
+
+  return entry->seq <= HISTORY_SEQ_MAX;
+}
+
+#endif /* HISTORY */
@@ -0,0 +1,91 @@
+/* DFU session history in EEPROM, built in with HISTORY=1.
+ *
+ * The last HISTORY_ENTRIES update sessions are kept in a ring of
+ * history_entry_t just below the bootloader configuration block, at
+ * HISTORY_EEPROM_ADDR. The application must leave those bytes alone; it
+ * can read them with history_read() or directly, the newest entry being
+ * the one whose successor's seq does not follow on from its own.
+ *
+ * A session starts with the first DFU packet over BLE or the first page
+ * over UART, and is written once, when it ends. A session cut short by a
+ * reset is kept in .noinit and written by the next bootloader start with
+ * status HISTORY_INTERRUPTED. Entries go round the ring and only changed
+ * bytes are written, so no single cell takes every update.
+ */
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#include "jump.h"
+
+/* Entries in the ring, fewer than 255 */
+#ifndef HISTORY_ENTRIES
+#define HISTORY_ENTRIES       4
+#endif
+
+/* Transports */
+#define HISTORY_BLE           0
+#define HISTORY_UART          1
+
+/* Final status */
+#define HISTORY_OK            0   /* Activated, or left programming mode */
+#define HISTORY_ABORTED       1   /* Reset System from the central */
+#define HISTORY_INTERRUPTED   2   /* Reset before the session ended */
+
+/* Written seq values run from 0 to HISTORY_SEQ_MAX, erased cells read 0xFF */
+#define HISTORY_SEQ_MAX       0xFE
+
+/* Duration unit, 256 Timer1 ticks at F_CPU/1024 */
+#define HISTORY_TICK_US       (262144000000ULL / F_CPU)
+
+typedef struct
+{
+  uint8_t  transport;       /* HISTORY_BLE or HISTORY_UART */
+  uint8_t  status;          /* HISTORY_OK, _ABORTED or _INTERRUPTED */
+  uint16_t image_size;      /* Bytes announced (BLE) or programmed (UART) */
+  uint16_t duration;        /* From the first packet, HISTORY_TICK_US units */
+  uint16_t conn_interval;   /* Average, 1.25 ms units, 0 if not connected */
+  uint8_t  pages_written;
+  uint8_t  pages_skipped;   /* Pages of the image never written */
+  uint8_t  reconnects;      /* Connections after the session started */
+  uint8_t  seq;             /* Written last */
+} history_entry_t;
+
+#define HISTORY_EEPROM_ADDR   (E2END - BOOTLOADER_EEPROM_SIZE - \
+                               HISTORY_ENTRIES * sizeof(history_entry_t))
+
+#ifdef HISTORY
+
+/* Write out a session interrupted by a reset */
+void history_init (void);
+
+/* Keep the session clock; call more often than every 4 s */
+void history_tick (void);
+
+void history_start (uint8_t transport, uint16_t image_size);
+
+/* Connection interval from ACI_EVT_CONNECTED or ACI_EVT_TIMING */
+void history_interval (uint16_t interval, uint8_t connected);
+
+void history_page (void);
+
+/* Write the session out, if one was started */
+void history_end (uint8_t status);
+
+/* Read the n-th newest entry, returns 0 if there is none */
+uint8_t history_read (uint8_t n, history_entry_t *entry);
+
+#else
+
+#define history_init()                    do {} while (0)
+#define history_tick()                    do {} while (0)
+#define history_start(transport, size)    do {} while (0)
+#define history_interval(interval, conn)  do {} while (0)
+#define history_page()                    do {} while (0)
+#define history_end(status)               do {} while (0)
+
+#endif /* HISTORY */
+
+#endif /* HISTORY_H_ */
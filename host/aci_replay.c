@@ -0,0 +1,212 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/** @file
+  @brief Implementation of the ACI capture replay.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../capture.h"
+
+#include "aci_replay.h"
+
+/* A length-prefixed message, false if it overruns the data */
+static bool m_msg (const uint8_t *data, long size, long *pos, uint8_t *msg)
+{
+  uint8_t len;
+
+  if (*pos >= size)
+  {
+    return false;
+  }
+  len = data[*pos];
+  if (len >= ACI_REPLAY_MSG_SIZE || *pos + 1 + len > size)
+  {
+    return false;
+  }
+  memcpy (msg, &data[*pos], 1 + len);
+  *pos += 1 + len;
+  return true;
+}
+
+static void m_seek (aci_replay_t *r)
+{
+  while (r->next_evt < r->count && r->rec[r->next_evt].evt[0] == 0)
+  {
+    r->next_evt++;
+  }
+  while (r->next_cmd < r->count && r->rec[r->next_cmd].cmd[0] == 0)
+  {
+    r->next_cmd++;
+  }
+}
+
+int aci_replay_load (aci_replay_t *r, const char *path)
+{
+  const size_t hdr = sizeof(CAPTURE_MAGIC) - 1 + 3;
+  uint8_t *data;
+  uint32_t khz;
+  uint64_t ticks = 0;
+  uint16_t last = 0;
+  long size;
+  long pos;
+  FILE *f;
+
+  memset (r, 0, sizeof(*r));
+
+  f = fopen (path, "rb");
+  if (f == NULL)
+  {
+    return -1;
+  }
+  fseek (f, 0, SEEK_END);
+  size = ftell (f);
+  rewind (f);
+  data = malloc (size > 0 ? size : 1);
+  if (data == NULL || fread (data, 1, size, f) != (size_t) size
+      || size < (long) hdr
+      || memcmp (data, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC) - 1) != 0
+      || data[4] != CAPTURE_VERSION)
+  {
+    free (data);
+    fclose (f);
+    return -1;
+  }
+  fclose (f);
+
+  khz = data[5] | data[6] << 8;
+  r->tick_us = khz ? 1024000 / khz : 64;
+
+  /* Records take at least five bytes */
+  r->rec = malloc ((size / 5 + 1) * sizeof(*r->rec));
+  if (r->rec == NULL)
+  {
+    free (data);
+    return -1;
+  }
+
+  pos = hdr;
+  while (pos < size)
+  {
+    aci_replay_rec_t *rec = &r->rec[r->count];
+    long start = pos;
+    uint16_t time;
+
+    if (data[pos] != CAPTURE_SYNC || pos + 3 > size)
+    {
+      r->stats.skipped_bytes++;
+      pos++;
+      continue;
+    }
+    time = data[pos + 1] | data[pos + 2] << 8;
+    pos += 3;
+    if (!m_msg (data, size, &pos, rec->cmd) || !m_msg (data, size, &pos, rec->evt))
+    {
+      /* Not a record after all, look for the next one */
+      r->stats.skipped_bytes++;
+      pos = start + 1;
+      continue;
+    }
+
+    /* Timer1 wraps, transfers are far less than a wrap apart */
+    ticks += r->count ? (uint16_t) (time - last) : 0;
+    last = time;
+    rec->time_us = ticks * r->tick_us;
+    r->count++;
+  }
+  free (data);
+
+  r->duration_us = r->count ? r->rec[r->count - 1].time_us : 0;
+  m_seek (r);
+  return 0;
+}
+
+void aci_replay_free (aci_replay_t *r)
+{
+  free (r->rec);
+  memset (r, 0, sizeof(*r));
+}
+
+bool aci_replay_evt_pending (aci_replay_t *r, uint64_t now_us)
+{
+  if (!r->started)
+  {
+    r->started = true;
+    r->start_us = now_us;
+  }
+
+  return r->next_evt < r->count &&
+    r->start_us + r->rec[r->next_evt].time_us <= now_us;
+}
+
+bool aci_replay_evt_get (aci_replay_t *r, uint64_t now_us, uint8_t *buffer)
+{
+  uint64_t late;
+
+  if (!aci_replay_evt_pending (r, now_us))
+  {
+    return false;
+  }
+
+  memcpy (buffer, r->rec[r->next_evt].evt, 1 + r->rec[r->next_evt].evt[0]);
+  late = now_us - (r->start_us + r->rec[r->next_evt].time_us);
+  r->stats.late_us += late;
+  if (late > r->stats.max_late_us)
+  {
+    r->stats.max_late_us = late;
+  }
+  r->stats.events++;
+  r->next_evt++;
+  m_seek (r);
+  return true;
+}
+
+void aci_replay_cmd_put (aci_replay_t *r, const uint8_t *buffer)
+{
+  r->stats.commands++;
+  if (r->next_cmd >= r->count)
+  {
+    r->stats.cmd_extra++;
+    return;
+  }
+
+  if (memcmp (buffer, r->rec[r->next_cmd].cmd, 1 + buffer[0]) != 0)
+  {
+    r->stats.cmd_mismatches++;
+  }
+  r->next_cmd++;
+  m_seek (r);
+}
+
+uint64_t aci_replay_next_deadline (const aci_replay_t *r)
+{
+  if (r->next_evt >= r->count)
+  {
+    return UINT64_MAX;
+  }
+
+  return r->start_us + r->rec[r->next_evt].time_us;
+}
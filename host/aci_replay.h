@@ -0,0 +1,109 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+ * @brief Replay of a captured ACI session.
+ */
+
+/** @defgroup aci_replay aci_replay
+@{
+@ingroup host
+
+@brief Stands in for the nRF8001 with the transfers of a capture
+@details A capture, as written by an ACI_CAPTURE bootloader on its UART
+(see capture.h) or by hostboot -C, is read whole. hal_aci_tl_host.c then
+takes its events from the capture instead of the nRF8001 model: each one
+is handed to the bootloader once its recorded time has come, and in the
+recorded order. Time counts from the first time the bootloader polls, which
+the empty record written by capture_init() at start-up stands for. Commands
+the bootloader sends are compared, in order, with the recorded ones.
+
+Events are never held back for a command they answer, so a bootloader that
+runs slower or faster than the captured one still sees the same events at
+the same times, as it would from a phone that does not wait for it; the
+statistics tell how far the run strayed from the capture.
+*/
+
+#ifndef ACI_REPLAY_H__
+#define ACI_REPLAY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ACI_REPLAY_MSG_SIZE  32
+
+typedef struct
+{
+  uint64_t time_us;                   /* From the first record */
+  uint8_t  cmd[ACI_REPLAY_MSG_SIZE];  /* Length-prefixed, as the buffers of */
+  uint8_t  evt[ACI_REPLAY_MSG_SIZE];  /* hal_aci_data_t */
+} aci_replay_rec_t;
+
+typedef struct
+{
+  uint32_t events;           /* Handed to the bootloader */
+  uint32_t commands;         /* Received from the bootloader */
+  uint32_t cmd_mismatches;   /* Differing from the recorded command */
+  uint32_t cmd_extra;        /* Beyond the recorded commands */
+  uint64_t late_us;          /* Sum of event delays past their time */
+  uint64_t max_late_us;
+  uint32_t skipped_bytes;    /* Capture bytes outside any record */
+} aci_replay_stats_t;
+
+typedef struct
+{
+  aci_replay_rec_t  *rec;
+  uint32_t           count;
+  uint32_t           tick_us;
+  uint64_t           duration_us;  /* Of the capture */
+
+  bool               started;
+  uint64_t           start_us;
+  uint32_t           next_evt;
+  uint32_t           next_cmd;
+
+  aci_replay_stats_t stats;
+} aci_replay_t;
+
+/** @brief Read a capture.
+ *  @return 0, or -1 if path cannot be read or is not a capture.
+ */
+int aci_replay_load(aci_replay_t *r, const char *path);
+
+void aci_replay_free(aci_replay_t *r);
+
+/** @brief True if an event is due at now_us. The first call starts the
+ *  replay clock.
+ */
+bool aci_replay_evt_pending(aci_replay_t *r, uint64_t now_us);
+
+/** @brief Copy the next due event to buffer, false if none is due. */
+bool aci_replay_evt_get(aci_replay_t *r, uint64_t now_us, uint8_t *buffer);
+
+/** @brief A command from the bootloader, length-prefixed. */
+void aci_replay_cmd_put(aci_replay_t *r, const uint8_t *buffer);
+
+/** @brief When the next event is due, UINT64_MAX once all were handed out. */
+uint64_t aci_replay_next_deadline(const aci_replay_t *r);
+
+#endif /* ACI_REPLAY_H__ */
+/** @} */
@@ -0,0 +1,485 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Microbenchmarks of the BLE modules in the native host build.
+
+  Usage: bench [-j] [-r repeat] [application.hex]
+
+  Each benchmark is repeated and the lowest figure kept. Figures are in
+  user-space instructions when the kernel exposes a hardware counter to
+  perf_event_open(), and in nanoseconds otherwise; the unit is reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+
+#include "../BLE/lib_aci.h"
+#include "../BLE/aci_queue.h"
+#include "../BLE/dfu.h"
+#include "../auth.h"
+
+#include "ihex.h"
+#include "host_dfu.h"
+
+#define BENCH_QUEUE_OPS     100000
+#define BENCH_DATA_PKTS     1400    /* 28000 bytes, most of an ATmega328P */
+#define BENCH_PKT_SIZE      20
+#define BENCH_PKT_DATA      0x5A
+
+typedef struct
+{
+  const char *name;
+  const char *per;
+  double      value;
+} bench_result_t;
+
+/* Image authentication key, written to the EEPROM of the host model */
+static const uint8_t m_auth_key[AUTH_KEY_SIZE] = {0x00, 0x01, 0x02, 0x03,
+  0x04, 0x05, 0x06, 0x07};
+
+static int             m_counter_fd = -1;
+static bench_result_t  m_results[16];
+static uint8_t         m_num_results;
+
+/*****************************************************************************
+* Measurement
+*****************************************************************************/
+
+static void m_counter_open (void)
+{
+  struct perf_event_attr attr;
+
+  memset (&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.inherit = 1;
+
+  m_counter_fd = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static const char *m_unit (void)
+{
+  return m_counter_fd >= 0 ? "instructions" : "ns";
+}
+
+static uint64_t m_ns (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t m_start_ns;
+
+static void m_begin (void)
+{
+  if (m_counter_fd >= 0)
+  {
+    ioctl (m_counter_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl (m_counter_fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  else
+  {
+    m_start_ns = m_ns ();
+  }
+}
+
+static uint64_t m_end (void)
+{
+  uint64_t count = 0;
+
+  if (m_counter_fd >= 0)
+  {
+    ioctl (m_counter_fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read (m_counter_fd, &count, sizeof(count)) != sizeof(count))
+    {
+      count = 0;
+    }
+    return count;
+  }
+
+  return m_ns () - m_start_ns;
+}
+
+static void m_report (const char *name, const char *per, double value)
+{
+  bench_result_t *r;
+  uint8_t i;
+
+  /* Keep the best of the repetitions */
+  for (i = 0; i < m_num_results; i++)
+  {
+    if (strcmp (m_results[i].name, name) == 0)
+    {
+      if (value < m_results[i].value)
+      {
+        m_results[i].value = value;
+      }
+      return;
+    }
+  }
+
+  r = &m_results[m_num_results++];
+  r->name = name;
+  r->per = per;
+  r->value = value;
+}
+
+/*****************************************************************************
+* Benchmarks
+*****************************************************************************/
+
+static void m_bench_queue (void)
+{
+  static aci_queue_t q;
+  hal_aci_data_t msg;
+  uint32_t i;
+
+  memset (&msg, 0xA5, sizeof(msg));
+  msg.buffer[0] = HAL_ACI_MAX_LENGTH;
+  aci_queue_init (&q);
+
+  m_begin ();
+  for (i = 0; i < BENCH_QUEUE_OPS; i++)
+  {
+    aci_queue_enqueue (&q, &msg);
+    aci_queue_dequeue (&q, &msg);
+  }
+  m_report ("aci_queue_enqueue+dequeue", "op", (double) m_end () / BENCH_QUEUE_OPS);
+
+  m_begin ();
+  for (i = 0; i < BENCH_QUEUE_OPS; i++)
+  {
+    aci_queue_tail (&q)->buffer[0] = HAL_ACI_MAX_LENGTH;
+    aci_queue_commit (&q);
+    msg.buffer[1] = aci_queue_head (&q)->buffer[1];
+    aci_queue_release (&q);
+  }
+  m_report ("aci_queue_commit+release, in place", "op",
+      (double) m_end () / BENCH_QUEUE_OPS);
+
+  m_begin ();
+  for (i = 0; i < BENCH_QUEUE_OPS; i++)
+  {
+    if (!aci_queue_is_full (&q))
+    {
+      aci_queue_is_empty (&q);
+    }
+  }
+  m_report ("aci_queue_is_full+is_empty", "op", (double) m_end () / BENCH_QUEUE_OPS);
+}
+
+/* Hand a DataReceived event to dfu_update() */
+static void m_dfu_event (aci_state_t *state, uint8_t pipe, const uint8_t *data,
+    uint8_t len)
+{
+  hal_aci_evt_t evt;
+
+  evt.evt.len = 2 + len;
+  evt.evt.evt_opcode = ACI_EVT_DATA_RECEIVED;
+  evt.evt.params.data_received.rx_data.pipe_number = pipe;
+  memcpy (evt.evt.params.data_received.rx_data.aci_data, data, len);
+
+  dfu_update (state, &evt.evt);
+}
+
+/* The init packet of an image of size bytes of BENCH_PKT_DATA, ending
+ * with its tag
+ */
+static void m_init_pkt (uint32_t size, uint8_t *init_pkt)
+{
+  uint8_t data[0xFF];
+  auth_mac_t mac;
+
+  memset (data, BENCH_PKT_DATA, sizeof(data));
+  auth_mac_init (&mac, m_auth_key);
+  while (size > 0)
+  {
+    const uint8_t len = size > sizeof(data) ? sizeof(data) : size;
+
+    auth_mac_update (&mac, data, len);
+    size -= len;
+  }
+  init_pkt[0] = 0xFF;
+  init_pkt[1] = 0xFF;
+  auth_mac_final (&mac, &init_pkt[2]);
+}
+
+/* The pages written by the flash match the packets fed, and all but those
+ * still in the page buffers have been written
+ */
+static int m_flash_check (uint32_t bytes)
+{
+  const uint32_t written = (uint32_t) host_mcu_stats.page_writes * SPM_PAGESIZE;
+  uint32_t i;
+
+  if (host_mcu_stats.spm_errors != 0 || written > bytes ||
+      bytes - written > 4 * SPM_PAGESIZE)
+  {
+    return 1;
+  }
+  for (i = 0; i < written; i++)
+  {
+    if (host_flash[i] != BENCH_PKT_DATA)
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* Feed BENCH_DATA_PKTS data packets to dfu_update() and count them */
+static int m_dfu_update_run (uint16_t prn, uint64_t *count)
+{
+  static const uint8_t pipes[3] = {8, 9, 10};
+  static aci_state_t state;
+  uint8_t size_pkt[12];
+  uint8_t prn_req[3] = {OP_CODE_PKT_RCPT_NOTIF_REQ, (uint8_t) prn,
+    (uint8_t) (prn >> 8)};
+  const uint8_t receive_init[] = {OP_CODE_RECEIVE_INIT};
+  const uint8_t receive_fw[] = {OP_CODE_RECEIVE_FW};
+  const uint32_t image_size = BENCH_DATA_PKTS * BENCH_PKT_SIZE + 1;
+  uint8_t init_pkt[2 + AUTH_TAG_SIZE];
+  uint8_t pkt[BENCH_PKT_SIZE];
+  uint16_t i;
+
+  host_mcu_init ();
+  memcpy (&host_eeprom[AUTH_KEY_EEPROM_ADDR], m_auth_key, AUTH_KEY_SIZE);
+  memset (&state, 0, sizeof(state));
+  state.data_credit_total = 2;
+  hal_aci_tl_init (&state.aci_pins);
+  dfu_init ((uint8_t *) pipes);
+
+  /* One byte is held back, so the image is never completed */
+  memset (size_pkt, 0, sizeof(size_pkt));
+  size_pkt[8] = (uint8_t) image_size;
+  size_pkt[9] = (uint8_t) (image_size >> 8);
+  m_init_pkt (image_size, init_pkt);
+
+  /* A DFU_AUTH bootloader takes no data before the tag */
+  m_dfu_event (&state, pipes[0], size_pkt, sizeof(size_pkt));
+  m_dfu_event (&state, pipes[2], prn_req, sizeof(prn_req));
+  m_dfu_event (&state, pipes[2], receive_init, sizeof(receive_init));
+  m_dfu_event (&state, pipes[0], init_pkt, sizeof(init_pkt));
+  m_dfu_event (&state, pipes[2], receive_fw, sizeof(receive_fw));
+
+  memset (pkt, BENCH_PKT_DATA, sizeof(pkt));
+
+  m_begin ();
+  for (i = 0; i < BENCH_DATA_PKTS; i++)
+  {
+    /* Credits are never returned here; keep notifications flowing */
+    state.data_credit_available = 2;
+    m_dfu_event (&state, pipes[0], pkt, sizeof(pkt));
+  }
+  *count = m_end ();
+
+  /* A refused or dropped transfer would be timed as a fast one */
+  if (m_flash_check (BENCH_DATA_PKTS * BENCH_PKT_SIZE) != 0)
+  {
+    fprintf (stderr, "bench: dfu_update wrote %u pages, not the data fed\n",
+        host_mcu_stats.page_writes);
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Run in a child, as dfu.c only starts a transfer from its initial static
+ * state
+ */
+static int m_bench_dfu_update (uint16_t prn)
+{
+  struct
+  {
+    uint64_t count;
+    int status;
+  } *shared;
+  pid_t pid;
+  int status;
+
+  shared = mmap (NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED)
+  {
+    return 1;
+  }
+  shared->status = 1;
+
+  pid = fork ();
+  if (pid == 0)
+  {
+    shared->status = m_dfu_update_run (prn, &shared->count);
+    _exit (0);
+  }
+  waitpid (pid, NULL, 0);
+
+  status = shared->status;
+  if (status == 0)
+  {
+    m_report (prn ? "dfu_update data packet, prn 10" : "dfu_update data packet",
+        "packet", (double) shared->count / BENCH_DATA_PKTS);
+  }
+
+  munmap (shared, sizeof(*shared));
+
+  return status;
+}
+
+/* A complete session, run in a child so that the BLE modules start from
+ * their initial static state every time
+ */
+static void m_bench_session (const ihex_image_t *app)
+{
+  struct
+  {
+    uint64_t count;
+    host_dfu_result_t r;
+    int status;
+  } *shared;
+  host_dfu_opts_t opts;
+  pid_t pid;
+
+  shared = mmap (NULL, sizeof(*shared), PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (shared == MAP_FAILED)
+  {
+    return;
+  }
+
+  host_dfu_opts_default (&opts);
+  opts.image = app->data;
+  opts.image_size = app->size;
+
+  pid = fork ();
+  if (pid == 0)
+  {
+    m_begin ();
+    shared->status = host_dfu_run (&opts, &shared->r);
+    shared->count = m_end ();
+    _exit (0);
+  }
+  waitpid (pid, NULL, 0);
+
+  if (shared->status == 0)
+  {
+    m_report ("session", "session", (double) shared->count);
+    m_report ("session per aci event", "event",
+        (double) shared->count / shared->r.radio.events);
+    m_report ("session per data packet", "packet",
+        (double) shared->count / shared->r.packets);
+  }
+  else
+  {
+    fprintf (stderr, "bench: DFU session failed\n");
+  }
+
+  munmap (shared, sizeof(*shared));
+}
+
+int main (int argc, char **argv)
+{
+  const char *image = "../tests/test_application.hex";
+  ihex_image_t app;
+  int repeat = 5;
+  int json = 0;
+  int opt;
+  int i;
+
+  while ((opt = getopt (argc, argv, "jr:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'j': json = 1; break;
+      case 'r': repeat = atoi (optarg); break;
+      default:
+        fputs ("Usage: bench [-j] [-r repeat] [application.hex]\n", stderr);
+        return 2;
+    }
+  }
+  if (optind < argc)
+  {
+    image = argv[optind];
+  }
+
+  if (ihex_load (image, &app) != 0)
+  {
+    fprintf (stderr, "bench: cannot load %s\n", image);
+    return 1;
+  }
+
+  m_counter_open ();
+
+  /* Sessions first, while the BLE modules are still untouched */
+  for (i = 0; i < repeat; i++)
+  {
+    m_bench_session (&app);
+  }
+
+  for (i = 0; i < repeat; i++)
+  {
+    m_bench_queue ();
+    if (m_bench_dfu_update (0) != 0 || m_bench_dfu_update (10) != 0)
+    {
+      return 1;
+    }
+  }
+
+  if (json)
+  {
+    printf ("{\n  \"unit\": \"%s\",\n  \"aci_queue_size\": %u,\n", m_unit (),
+        ACI_QUEUE_SIZE);
+    printf ("  \"results\": {\n");
+    for (i = 0; i < m_num_results; i++)
+    {
+      printf ("    \"%s\": %.1f%s\n", m_results[i].name, m_results[i].value,
+          i + 1 < m_num_results ? "," : "");
+    }
+    printf ("  }\n}\n");
+  }
+  else
+  {
+    for (i = 0; i < m_num_results; i++)
+    {
+      printf ("%-34s %12.1f %s/%s\n", m_results[i].name, m_results[i].value,
+          m_unit (), m_results[i].per);
+    }
+  }
+
+  ihex_free (&app);
+
+  return 0;
+}
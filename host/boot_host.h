@@ -0,0 +1,56 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Self-programming for the native host build.
+ * @details Force-included ahead of the BLE sources in place of boot.h. The
+ * include guard of boot.h is defined here, so "../boot.h" is skipped and
+ * the SPM macros below are used instead.
+ */
+
+#ifndef BOOT_HOST_H__
+#define BOOT_HOST_H__
+
+#define _AVR_BOOT_H_    1
+
+#include "host_mcu.h"
+
+#define boot_spm_busy()                     host_spm_busy()
+#define boot_spm_busy_wait()                host_spm_busy_wait()
+#define boot_rww_busy()                     0
+
+#define __boot_page_fill_short(addr, data)  host_spm_page_fill((addr), (data))
+#define __boot_page_erase_short(addr)       host_spm_page_erase(addr)
+#define __boot_page_write_short(addr)       host_spm_page_write(addr)
+#define __boot_rww_enable_short()           host_spm_rww_enable()
+
+#define boot_page_fill(addr, data)          host_spm_page_fill((addr), (data))
+#define boot_page_erase(addr)               host_spm_page_erase(addr)
+#define boot_page_write(addr)               host_spm_page_write(addr)
+#define boot_rww_enable()                   host_spm_rww_enable()
+
+/* The busy wait is a single step of virtual time, see perf.h */
+#ifdef PERF_COUNTERS
+#define perf_spm_busy_wait() \
+  (perf_counters.spm_wait += host_spm_busy_wait())
+#endif
+
+#endif /* BOOT_HOST_H__ */
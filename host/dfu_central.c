@@ -0,0 +1,351 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the scripted DFU central.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+/* Only the protocol constants of dfu.h are needed, not the ACI types used in
+ * its prototypes */
+#define aci_state_t void
+#define aci_evt_t   void
+#include "../BLE/dfu.h"
+#undef aci_state_t
+#undef aci_evt_t
+
+#include "dfu_central.h"
+
+/* Application image type in the Start DFU request */
+#define DFU_IMAGE_TYPE_APPLICATION  4
+
+static bool m_cp_write (dfu_central_t *c, const uint8_t *data, uint8_t len)
+{
+  return c->link.write (c->link.ctx, c->pipes[2], data, len);
+}
+
+static bool m_pkt_write (dfu_central_t *c, const uint8_t *data, uint8_t len)
+{
+  return c->link.write (c->link.ctx, c->pipes[0], data, len);
+}
+
+static void m_start (dfu_central_t *c)
+{
+  const uint8_t start[] = {OP_CODE_START_DFU, DFU_IMAGE_TYPE_APPLICATION};
+  uint8_t sizes[12];
+
+  /* Softdevice, bootloader and application sizes */
+  memset (sizes, 0, sizeof(sizes));
+  sizes[8]  = (uint8_t)(c->image_size >> 0);
+  sizes[9]  = (uint8_t)(c->image_size >> 8);
+  sizes[10] = (uint8_t)(c->image_size >> 16);
+  sizes[11] = (uint8_t)(c->image_size >> 24);
+
+  m_cp_write (c, start, sizeof(start));
+  m_pkt_write (c, sizes, sizeof(sizes));
+
+  c->state = DFU_CENTRAL_WAIT_START;
+}
+
+static void m_init (dfu_central_t *c)
+{
+  const uint8_t init_rx[] = {OP_CODE_RECEIVE_INIT, 0};
+  uint8_t init_pkt[2 + DFU_CENTRAL_TAG_SIZE] = {0xFF, 0xFF};
+
+  memcpy (&init_pkt[2], c->tag, DFU_CENTRAL_TAG_SIZE);
+
+  m_cp_write (c, init_rx, sizeof(init_rx));
+  if (c->init)
+  {
+    m_pkt_write (c, c->init, c->init_len);
+  }
+  else
+  {
+    m_pkt_write (c, init_pkt, sizeof(init_pkt));
+  }
+
+  c->state = DFU_CENTRAL_WAIT_INIT;
+}
+
+static void m_receive_fw (dfu_central_t *c)
+{
+  const uint8_t prn_req[] = {OP_CODE_PKT_RCPT_NOTIF_REQ,
+    (uint8_t)(c->prn), (uint8_t)(c->prn >> 8)};
+  const uint8_t receive_fw[] = {OP_CODE_RECEIVE_FW};
+
+  if (c->prn)
+  {
+    m_cp_write (c, prn_req, sizeof(prn_req));
+  }
+  m_cp_write (c, receive_fw, sizeof(receive_fw));
+
+  c->state = DFU_CENTRAL_SENDING;
+}
+
+/* Abort the transfer, once */
+static void m_sys_reset (dfu_central_t *c)
+{
+  const uint8_t sys_reset[] = {OP_CODE_SYS_RESET};
+
+  if (m_cp_write (c, sys_reset, sizeof(sys_reset)))
+  {
+    c->reset_at = 0;
+    c->offset = 0;
+    c->in_flight = 0;
+    c->resets++;
+    c->state = DFU_CENTRAL_RESETTING;
+  }
+}
+
+static void m_send_packets (dfu_central_t *c)
+{
+  while (c->offset < c->image_size)
+  {
+    uint32_t len = c->image_size - c->offset;
+
+    if (c->prn && c->in_flight >= c->prn)
+    {
+      return;
+    }
+
+    if (c->reset_at && c->offset >= c->reset_at)
+    {
+      m_sys_reset (c);
+      return;
+    }
+
+    if (len > DFU_CENTRAL_PKT_SIZE)
+    {
+      len = DFU_CENTRAL_PKT_SIZE;
+    }
+
+    if (!m_pkt_write (c, &c->image[c->offset], (uint8_t)len))
+    {
+      return;
+    }
+
+    c->offset += len;
+    c->in_flight++;
+    c->packets++;
+  }
+
+  c->state = DFU_CENTRAL_WAIT_FW;
+}
+
+static void m_validate (dfu_central_t *c)
+{
+  const uint8_t validate[] = {OP_CODE_VALIDATE};
+
+  m_cp_write (c, validate, sizeof(validate));
+  c->state = DFU_CENTRAL_WAIT_VALID;
+}
+
+/* Ask for the counters from perf_len on */
+static void m_perf_read (dfu_central_t *c)
+{
+  const uint8_t perf_req[] = {OP_CODE_PERF_COUNTERS_REQ, c->perf_len};
+
+  m_cp_write (c, perf_req, sizeof(perf_req));
+  c->state = DFU_CENTRAL_WAIT_PERF;
+}
+
+static void m_perf_rsp (dfu_central_t *c, const uint8_t *data, uint8_t len)
+{
+  const uint8_t n = len - 3;
+
+  if (c->perf_len + n > sizeof(c->perf))
+  {
+    c->state = DFU_CENTRAL_FAILED;
+    return;
+  }
+
+  memcpy (&c->perf[c->perf_len], &data[3], n);
+  c->perf_len += n;
+
+  /* A short response is the end of the block */
+  if (n == PERF_DFU_CHUNK)
+  {
+    m_perf_read (c);
+  }
+  else
+  {
+    m_validate (c);
+  }
+}
+
+/* Notifications on the control point */
+void dfu_central_notify (dfu_central_t *c, uint8_t pipe, const uint8_t *data,
+    uint8_t len, uint64_t now_us)
+{
+  if (pipe != c->pipes[1] || len == 0)
+  {
+    return;
+  }
+
+  if (data[0] == OP_CODE_PKT_RCPT_NOTIF)
+  {
+    c->prn_received++;
+    c->in_flight = 0;
+    return;
+  }
+
+  /* Keep the response that failed the session: packets already queued may
+   * still draw responses after it
+   */
+  if (data[0] != OP_CODE_RESPONSE || len < 3 ||
+      c->state == DFU_CENTRAL_FAILED)
+  {
+    return;
+  }
+
+  memcpy (c->last_rsp, data, 3);
+
+  if (data[2] != BLE_DFU_RESP_VAL_SUCCESS)
+  {
+    c->state = DFU_CENTRAL_FAILED;
+    return;
+  }
+
+  switch (data[1])
+  {
+    case BLE_DFU_START_PROCEDURE:
+      if (c->state == DFU_CENTRAL_WAIT_START)
+      {
+        m_init (c);
+      }
+      break;
+
+    case BLE_DFU_INIT_PROCEDURE:
+      if (c->state == DFU_CENTRAL_WAIT_INIT)
+      {
+        c->t_fw_start = now_us;
+        m_receive_fw (c);
+      }
+      break;
+
+    case BLE_DFU_RECEIVE_APP_PROCEDURE:
+      c->t_fw_done = now_us;
+      if (c->read_perf)
+      {
+        m_perf_read (c);
+      }
+      else
+      {
+        m_validate (c);
+      }
+      break;
+
+    case BLE_DFU_PERF_COUNTERS_PROCEDURE:
+      if (c->state == DFU_CENTRAL_WAIT_PERF)
+      {
+        m_perf_rsp (c, data, len);
+      }
+      break;
+
+    case BLE_DFU_VALIDATE_PROCEDURE:
+      if (c->state == DFU_CENTRAL_WAIT_VALID)
+      {
+        const uint8_t activate[] = {OP_CODE_ACTIVATE_N_RESET};
+
+        m_cp_write (c, activate, sizeof(activate));
+        c->state = DFU_CENTRAL_ACTIVATING;
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+void dfu_central_init (dfu_central_t *c, const uint8_t *image,
+    uint32_t image_size, const uint8_t *pipes, uint16_t prn)
+{
+  memset (c, 0, sizeof(*c));
+
+  c->image = image;
+  c->image_size = image_size;
+  c->prn = prn;
+  memcpy (c->pipes, pipes, 3);
+}
+
+void dfu_central_run (dfu_central_t *c, uint64_t now_us)
+{
+  const bool connected = c->link.connected (c->link.ctx);
+
+  switch (c->state)
+  {
+    case DFU_CENTRAL_CONNECTING:
+      if (connected)
+      {
+        c->t_connected = now_us;
+        if (c->skip_start)
+        {
+          m_receive_fw (c);
+        }
+        else
+        {
+          m_start (c);
+        }
+      }
+      break;
+
+    case DFU_CENTRAL_SENDING:
+      {
+        const uint32_t before = c->offset;
+
+        m_send_packets (c);
+        if (c->offset == before && c->last_run_us)
+        {
+          c->stall_us += now_us - c->last_run_us;
+        }
+      }
+      break;
+
+    case DFU_CENTRAL_RESETTING:
+      /* The bootloader resets the nRF8001, which drops the link */
+      if (!connected)
+      {
+        c->state = DFU_CENTRAL_CONNECTING;
+      }
+      break;
+
+    case DFU_CENTRAL_ACTIVATING:
+      /* The bootloader drops the link before resetting into the new image */
+      if (!connected)
+      {
+        c->t_done = now_us;
+        c->state = DFU_CENTRAL_DONE;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  c->last_run_us = now_us;
+}
+
+bool dfu_central_finished (const dfu_central_t *c)
+{
+  return c->state == DFU_CENTRAL_DONE || c->state == DFU_CENTRAL_FAILED;
+}
@@ -0,0 +1,130 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Scripted DFU central, over any dfu_link.
+ */
+
+/** @defgroup dfu_central dfu_central
+@{
+@ingroup host
+
+@brief Host side of the DFU procedure, as done by memu_OTA_DFU_base.py
+@details The central writes the image size, an init packet ending with the
+image tag, the packet receipt notification interval and then streams the
+image in 20 byte packets on the DFU packet pipe, as many as the link takes
+and the receipt notification interval allows. It validates and activates
+the image once the bootloader reports that the whole image was received.
+With read_perf set it first reads the performance counters of a
+PERF_COUNTERS build through the control point.
+
+The central only knows the device through a dfu_link_t, attached after
+dfu_central_init() by dfu_link_model() or dfu_link_socket(). Times
+are those passed to dfu_central_run() and dfu_central_notify(), virtual or
+real.
+*/
+
+#ifndef DFU_CENTRAL_H__
+#define DFU_CENTRAL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dfu_link.h"
+
+#define DFU_CENTRAL_PKT_SIZE    20
+
+#define DFU_CENTRAL_CONNECTING  0
+#define DFU_CENTRAL_WAIT_START  1
+#define DFU_CENTRAL_WAIT_INIT   2
+#define DFU_CENTRAL_SENDING     3
+#define DFU_CENTRAL_WAIT_FW     4
+#define DFU_CENTRAL_WAIT_VALID  5
+#define DFU_CENTRAL_ACTIVATING  6
+#define DFU_CENTRAL_DONE        7
+#define DFU_CENTRAL_FAILED      8
+#define DFU_CENTRAL_WAIT_PERF   9
+#define DFU_CENTRAL_RESETTING   10
+
+#define DFU_CENTRAL_PERF_MAX    64
+
+/* Image tag sent at the end of the init packet, see auth.h */
+#define DFU_CENTRAL_TAG_SIZE    8
+
+typedef struct
+{
+  dfu_link_t     link;
+  const uint8_t *image;
+  uint32_t       image_size;
+  uint8_t        pipes[3];   /* Packet RX, control point TX, control point RX */
+  uint16_t       prn;        /* Packets between receipt notifications */
+  uint8_t        tag[DFU_CENTRAL_TAG_SIZE];
+  const uint8_t *init;       /* Init packet to send as is, NULL to end one
+                                of 0xFF 0xFF with tag */
+  uint8_t        init_len;
+  bool           skip_start; /* Send Receive Firmware straight away, without
+                                the start and init procedures */
+  uint32_t       reset_at;   /* Send System Reset once this many image bytes
+                                are written, then start again when the link
+                                is back; 0 for never */
+
+  uint8_t        state;
+  uint32_t       offset;     /* Image bytes written so far */
+  uint16_t       in_flight;  /* Packets written since the last notification */
+  uint8_t        last_rsp[3];
+
+  /* Bootloader counters, see perf.h */
+  bool           read_perf;  /* Read them once the image has been received */
+  uint8_t        perf[DFU_CENTRAL_PERF_MAX];
+  uint8_t        perf_len;
+
+  /* Timestamps, in microseconds */
+  uint64_t       t_connected;
+  uint64_t       t_fw_start;
+  uint64_t       t_fw_done;
+  uint64_t       t_done;
+
+  /* Statistics */
+  uint32_t       packets;
+  uint32_t       prn_received;
+  uint8_t        resets;     /* System Resets sent */
+  uint64_t       stall_us;   /* Time spent unable to send image data */
+  uint64_t       last_run_us;
+} dfu_central_t;
+
+/** @brief Set up a DFU of image, to be run once a link is attached.
+ *  @param pipes DFU pipes as stored in the bootloader EEPROM block.
+ */
+void dfu_central_init(dfu_central_t *c, const uint8_t *image,
+    uint32_t image_size, const uint8_t *pipes, uint16_t prn);
+
+/** @brief A notification from the device, for the link to call. */
+void dfu_central_notify(dfu_central_t *c, uint8_t pipe, const uint8_t *data,
+    uint8_t len, uint64_t now_us);
+
+/** @brief Queue as many writes as the procedure allows at time now_us. */
+void dfu_central_run(dfu_central_t *c, uint64_t now_us);
+
+/** @brief True when the procedure has completed or failed. */
+bool dfu_central_finished(const dfu_central_t *c);
+
+#endif /* DFU_CENTRAL_H__ */
+/** @} */
@@ -0,0 +1,614 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/** @file
+  @brief Implementation of the prepared DFU images.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../auth.h"
+
+#include "dfu_image.h"
+
+/* LZSS: a flag byte per eight items, literal bytes for set bits and two
+ * byte matches for clear ones, 12 bits of distance and 4 of length.
+ */
+#define LZ_WINDOW     4096
+#define LZ_MIN_MATCH  3
+#define LZ_MAX_MATCH  (LZ_MIN_MATCH + 15)
+
+static const uint8_t m_zero_key[AUTH_KEY_SIZE];
+
+static void m_put16 (uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t) v;
+  p[1] = (uint8_t) (v >> 8);
+}
+
+static void m_put32 (uint8_t *p, uint32_t v)
+{
+  m_put16 (p, (uint16_t) v);
+  m_put16 (p + 2, (uint16_t) (v >> 16));
+}
+
+static uint16_t m_get16 (const uint8_t *p)
+{
+  return (uint16_t) (p[0] | p[1] << 8);
+}
+
+static uint32_t m_get32 (const uint8_t *p)
+{
+  return m_get16 (p) | (uint32_t) m_get16 (p + 2) << 16;
+}
+
+static void m_mac (const uint8_t *key, const uint8_t *data, uint32_t len,
+    uint8_t *tag)
+{
+  auth_mac_t mac;
+
+  auth_mac_init (&mac, key);
+  while (len > 0)
+  {
+    const uint8_t n = len > 0xFF ? 0xFF : len;
+
+    auth_mac_update (&mac, data, n);
+    data += n;
+    len -= n;
+  }
+  auth_mac_final (&mac, tag);
+}
+
+/* out must hold len + len / 8 + 1 bytes */
+static uint32_t m_lz_encode (const uint8_t *in, uint32_t len, uint8_t *out)
+{
+  uint32_t pos = 0;
+  uint32_t n = 0;
+  uint32_t flags_at = 0;
+  uint8_t item = 8;
+
+  while (pos < len)
+  {
+    uint32_t best_len = 0;
+    uint32_t best_dist = 0;
+    uint32_t from = pos > LZ_WINDOW ? pos - LZ_WINDOW : 0;
+    uint32_t i;
+
+    if (item == 8)
+    {
+      flags_at = n++;
+      out[flags_at] = 0;
+      item = 0;
+    }
+
+    for (i = from; i < pos; i++)
+    {
+      uint32_t l = 0;
+
+      while (l < LZ_MAX_MATCH && pos + l < len && in[i + l] == in[pos + l])
+      {
+        l++;
+      }
+      if (l > best_len)
+      {
+        best_len = l;
+        best_dist = pos - i;
+      }
+    }
+
+    if (best_len >= LZ_MIN_MATCH)
+    {
+      out[n++] = (uint8_t) (best_dist - 1);
+      out[n++] = (uint8_t) ((best_dist - 1) >> 8 << 4 | (best_len - LZ_MIN_MATCH));
+      pos += best_len;
+    }
+    else
+    {
+      out[flags_at] |= 1 << item;
+      out[n++] = in[pos++];
+    }
+    item++;
+  }
+  return n;
+}
+
+/* Returns the bytes written to out, or -1 if the stream is corrupt */
+static long m_lz_decode (const uint8_t *in, uint32_t len, uint8_t *out,
+    uint32_t size)
+{
+  uint32_t pos = 0;
+  uint32_t n = 0;
+
+  while (pos < len)
+  {
+    uint8_t flags = in[pos++];
+    uint8_t item;
+
+    for (item = 0; item < 8 && pos < len; item++)
+    {
+      if (flags & (1 << item))
+      {
+        if (n == size)
+        {
+          return -1;
+        }
+        out[n++] = in[pos++];
+      }
+      else
+      {
+        uint32_t dist;
+        uint32_t l;
+
+        if (pos + 2 > len)
+        {
+          return -1;
+        }
+        dist = (in[pos] | (in[pos + 1] >> 4) << 8) + 1;
+        l = (in[pos + 1] & 0x0F) + LZ_MIN_MATCH;
+        pos += 2;
+        if (dist > n || n + l > size)
+        {
+          return -1;
+        }
+        while (l--)
+        {
+          out[n] = out[n - dist];
+          n++;
+        }
+      }
+    }
+  }
+  return n;
+}
+
+/* Page of a base image, as the flash would hold it */
+static void m_base_page (const ihex_image_t *base, uint32_t offset,
+    uint8_t *page, uint16_t page_size)
+{
+  memset (page, 0xFF, page_size);
+  if (offset < base->size)
+  {
+    uint32_t n = base->size - offset;
+
+    memcpy (page, &base->data[offset], n < page_size ? n : page_size);
+  }
+}
+
+uint16_t dfu_image_crc16 (uint16_t crc, const uint8_t *data, uint32_t len)
+{
+  while (len--)
+  {
+    crc = (uint16_t) (crc >> 8 | crc << 8);
+    crc ^= *data++;
+    crc ^= (crc & 0xFF) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xFF) << 5;
+  }
+  return crc;
+}
+
+void dfu_image_hash (const uint8_t *data, uint32_t len, uint8_t *hash)
+{
+  m_mac (m_zero_key, data, len, hash);
+}
+
+int dfu_image_make (dfu_image_t *img, const ihex_image_t *app,
+    const uint8_t *key, uint16_t page_size, uint8_t flags,
+    const ihex_image_t *base)
+{
+  uint8_t *plain;
+  uint32_t plain_size;
+  uint16_t p;
+
+  memset (img, 0, sizeof(*img));
+  img->flags = flags;
+  img->page_size = page_size;
+  img->size = app->size;
+  img->address = app->base;
+  img->crc = dfu_image_crc16 (0xFFFF, app->data, app->size);
+  m_mac (key, app->data, app->size, img->tag);
+  dfu_image_hash (app->data, app->size, img->hash);
+  memcpy (img->segment, app->segment, sizeof(img->segment));
+  img->segments = app->segments;
+
+  m_put16 (img->init, img->crc);
+  memcpy (&img->init[2], img->tag, DFU_IMAGE_TAG_SIZE);
+  img->init_len = DFU_IMAGE_INIT_SIZE;
+
+  img->pages = (app->size + page_size - 1) / page_size;
+  img->page_hash = malloc ((size_t) img->pages * DFU_IMAGE_HASH_SIZE);
+  img->data = malloc (app->size);
+  plain = malloc (app->size + img->pages / 8 + 1);
+  if (img->page_hash == NULL || img->data == NULL || plain == NULL)
+  {
+    free (plain);
+    dfu_image_free (img);
+    return -1;
+  }
+  memcpy (img->data, app->data, app->size);
+
+  for (p = 0; p < img->pages; p++)
+  {
+    uint32_t offset = (uint32_t) p * page_size;
+    uint32_t n = app->size - offset < page_size ? app->size - offset : page_size;
+
+    dfu_image_hash (&app->data[offset], n, &img->page_hash[p * DFU_IMAGE_HASH_SIZE]);
+  }
+
+  if (flags & DFU_IMAGE_DELTA)
+  {
+    uint8_t *page = malloc (page_size);
+    uint32_t bitmap = (img->pages + 7) / 8;
+
+    if (page == NULL)
+    {
+      free (plain);
+      dfu_image_free (img);
+      return -1;
+    }
+    dfu_image_hash (base->data, base->size, img->base_hash);
+
+    /* Changed pages, as compared with what the base left in flash */
+    memset (plain, 0, bitmap);
+    plain_size = bitmap;
+    for (p = 0; p < img->pages; p++)
+    {
+      uint32_t offset = (uint32_t) p * page_size;
+      uint32_t n = app->size - offset < page_size ? app->size - offset : page_size;
+
+      m_base_page (base, offset, page, page_size);
+      if (memcmp (page, &app->data[offset], n) != 0)
+      {
+        plain[p / 8] |= 1 << (p % 8);
+        memcpy (&plain[plain_size], &app->data[offset], n);
+        plain_size += n;
+        img->delta_pages++;
+      }
+    }
+    free (page);
+  }
+  else
+  {
+    memcpy (plain, app->data, app->size);
+    plain_size = app->size;
+  }
+
+  if (flags & DFU_IMAGE_LZ)
+  {
+    img->stream = malloc (plain_size + plain_size / 8 + 1);
+    if (img->stream == NULL)
+    {
+      free (plain);
+      dfu_image_free (img);
+      return -1;
+    }
+    img->stream_size = m_lz_encode (plain, plain_size, img->stream);
+    free (plain);
+  }
+  else
+  {
+    img->stream = plain;
+    img->stream_size = plain_size;
+  }
+  return 0;
+}
+
+long dfu_image_write (const dfu_image_t *img, const char *path)
+{
+  uint8_t hdr[DFU_IMAGE_HEADER_SIZE];
+  uint16_t i;
+  long size;
+  FILE *f;
+
+  memset (hdr, 0, sizeof(hdr));
+  memcpy (hdr, DFU_IMAGE_MAGIC, 4);
+  hdr[4] = DFU_IMAGE_VERSION;
+  hdr[5] = img->flags;
+  m_put16 (&hdr[6], img->page_size);
+  m_put32 (&hdr[8], img->size);
+  m_put32 (&hdr[12], img->address);
+  m_put16 (&hdr[16], img->crc);
+  m_put16 (&hdr[18], img->segments);
+  m_put16 (&hdr[20], img->pages);
+  hdr[22] = img->init_len;
+  memcpy (&hdr[24], img->tag, DFU_IMAGE_TAG_SIZE);
+  memcpy (&hdr[32], img->hash, DFU_IMAGE_HASH_SIZE);
+  memcpy (&hdr[40], img->base_hash, DFU_IMAGE_HASH_SIZE);
+  m_put32 (&hdr[48], img->stream_size);
+
+  f = fopen (path, "wb");
+  if (f == NULL)
+  {
+    return -1;
+  }
+  fwrite (hdr, 1, sizeof(hdr), f);
+  for (i = 0; i < img->segments; i++)
+  {
+    uint8_t seg[8];
+
+    m_put32 (seg, img->segment[i].start);
+    m_put32 (&seg[4], img->segment[i].size);
+    fwrite (seg, 1, sizeof(seg), f);
+  }
+  fwrite (img->page_hash, DFU_IMAGE_HASH_SIZE, img->pages, f);
+  fwrite (img->init, 1, img->init_len, f);
+  fwrite (img->stream, 1, img->stream_size, f);
+  size = ftell (f);
+  if (ferror (f) | fclose (f))
+  {
+    return -1;
+  }
+  return size;
+}
+
+static int m_fail (dfu_image_t *img, const char **error, const char *why)
+{
+  *error = why;
+  dfu_image_free (img);
+  return -1;
+}
+
+/* The stream back into the plain image */
+static int m_expand (dfu_image_t *img, const ihex_image_t *base,
+    const char **error)
+{
+  uint32_t bitmap = (img->flags & DFU_IMAGE_DELTA) ? (img->pages + 7) / 8 : 0;
+  uint32_t plain_cap = img->size + bitmap;
+  uint8_t *plain = img->stream;
+  uint32_t plain_size = img->stream_size;
+  uint8_t hash[DFU_IMAGE_HASH_SIZE];
+  uint16_t p;
+
+  if (img->flags & DFU_IMAGE_LZ)
+  {
+    long n;
+
+    plain = malloc (plain_cap);
+    if (plain == NULL)
+    {
+      return m_fail (img, error, "out of memory");
+    }
+    n = m_lz_decode (img->stream, img->stream_size, plain, plain_cap);
+    if (n < 0)
+    {
+      free (plain);
+      return m_fail (img, error, "corrupt compressed stream");
+    }
+    plain_size = (uint32_t) n;
+  }
+
+  if (img->flags & DFU_IMAGE_DELTA)
+  {
+    uint32_t pos = bitmap;
+
+    dfu_image_hash (base ? base->data : NULL, base ? base->size : 0, hash);
+    if (base == NULL || memcmp (hash, img->base_hash, sizeof(hash)) != 0)
+    {
+      if (plain != img->stream)
+      {
+        free (plain);
+      }
+      return m_fail (img, error, base ? "delta against another base image" :
+          "delta needs its base image");
+    }
+    for (p = 0; p < img->pages && pos <= plain_size; p++)
+    {
+      uint32_t offset = (uint32_t) p * img->page_size;
+      uint32_t n = img->size - offset < img->page_size ?
+        img->size - offset : img->page_size;
+
+      if (plain_size >= bitmap && (plain[p / 8] & (1 << (p % 8))))
+      {
+        if (pos + n > plain_size)
+        {
+          break;
+        }
+        memcpy (&img->data[offset], &plain[pos], n);
+        pos += n;
+        img->delta_pages++;
+      }
+      else
+      {
+        uint8_t page[256 * 2];
+
+        m_base_page (base, offset, page, img->page_size);
+        memcpy (&img->data[offset], page, n);
+      }
+    }
+    if (p != img->pages || pos != plain_size)
+    {
+      if (plain != img->stream)
+      {
+        free (plain);
+      }
+      return m_fail (img, error, "delta does not cover the image");
+    }
+  }
+  else if (plain_size == img->size)
+  {
+    memcpy (img->data, plain, img->size);
+  }
+  else
+  {
+    if (plain != img->stream)
+    {
+      free (plain);
+    }
+    return m_fail (img, error, "stream does not match the image size");
+  }
+
+  if (plain != img->stream)
+  {
+    free (plain);
+  }
+  return 0;
+}
+
+int dfu_image_read (dfu_image_t *img, const char *path,
+    const ihex_image_t *base, const char **error)
+{
+  uint8_t hdr[DFU_IMAGE_HEADER_SIZE];
+  uint8_t hash[DFU_IMAGE_HASH_SIZE];
+  uint16_t i;
+  bool ok;
+  FILE *f;
+
+  memset (img, 0, sizeof(*img));
+  f = fopen (path, "rb");
+  if (f == NULL)
+  {
+    *error = "cannot open the container";
+    return -1;
+  }
+  if (fread (hdr, 1, sizeof(hdr), f) != sizeof(hdr)
+      || memcmp (hdr, DFU_IMAGE_MAGIC, 4) != 0 || hdr[4] != DFU_IMAGE_VERSION)
+  {
+    fclose (f);
+    *error = "not a version 1 container";
+    return -1;
+  }
+
+  img->flags = hdr[5];
+  img->page_size = m_get16 (&hdr[6]);
+  img->size = m_get32 (&hdr[8]);
+  img->address = m_get32 (&hdr[12]);
+  img->crc = m_get16 (&hdr[16]);
+  img->segments = m_get16 (&hdr[18]);
+  img->pages = m_get16 (&hdr[20]);
+  img->init_len = hdr[22];
+  memcpy (img->tag, &hdr[24], DFU_IMAGE_TAG_SIZE);
+  memcpy (img->hash, &hdr[32], DFU_IMAGE_HASH_SIZE);
+  memcpy (img->base_hash, &hdr[40], DFU_IMAGE_HASH_SIZE);
+  img->stream_size = m_get32 (&hdr[48]);
+
+  if (img->page_size == 0 || img->page_size > 512
+      || img->size > IHEX_MAX_SIZE || img->segments > IHEX_MAX_SEGMENTS
+      || img->pages != (img->size + img->page_size - 1) / img->page_size
+      || img->init_len > DFU_IMAGE_INIT_SIZE
+      || img->stream_size > 2 * IHEX_MAX_SIZE)
+  {
+    fclose (f);
+    return m_fail (img, error, "bad container header");
+  }
+
+  img->page_hash = malloc ((size_t) img->pages * DFU_IMAGE_HASH_SIZE + 1);
+  img->data = malloc (img->size + 1);
+  img->stream = malloc (img->stream_size + 1);
+  if (img->page_hash == NULL || img->data == NULL || img->stream == NULL)
+  {
+    fclose (f);
+    return m_fail (img, error, "out of memory");
+  }
+
+  ok = true;
+  for (i = 0; i < img->segments; i++)
+  {
+    uint8_t seg[8];
+
+    ok &= fread (seg, 1, sizeof(seg), f) == sizeof(seg);
+    img->segment[i].start = m_get32 (seg);
+    img->segment[i].size = m_get32 (&seg[4]);
+  }
+  ok &= fread (img->page_hash, DFU_IMAGE_HASH_SIZE, img->pages, f) == img->pages;
+  ok &= fread (img->init, 1, img->init_len, f) == img->init_len;
+  ok &= fread (img->stream, 1, img->stream_size, f) == img->stream_size;
+  fclose (f);
+  if (!ok)
+  {
+    return m_fail (img, error, "truncated container");
+  }
+
+  if (m_expand (img, base, error) != 0)
+  {
+    return -1;
+  }
+
+  /* The expanded image must be the one that was prepared */
+  for (i = 0; i < img->pages; i++)
+  {
+    uint32_t offset = (uint32_t) i * img->page_size;
+    uint32_t n = img->size - offset < img->page_size ?
+      img->size - offset : img->page_size;
+
+    dfu_image_hash (&img->data[offset], n, hash);
+    if (memcmp (hash, &img->page_hash[i * DFU_IMAGE_HASH_SIZE], sizeof(hash)))
+    {
+      return m_fail (img, error, "page hash mismatch");
+    }
+  }
+  dfu_image_hash (img->data, img->size, hash);
+  if (memcmp (hash, img->hash, sizeof(hash)) != 0
+      || dfu_image_crc16 (0xFFFF, img->data, img->size) != img->crc)
+  {
+    return m_fail (img, error, "image hash or CRC mismatch");
+  }
+  return 0;
+}
+
+int dfu_image_parse_key (const char *hex, uint8_t *key)
+{
+  unsigned i;
+
+  if (strlen (hex) != 2 * AUTH_KEY_SIZE)
+  {
+    return -1;
+  }
+  for (i = 0; i < AUTH_KEY_SIZE; i++)
+  {
+    char byte[3] = {hex[2 * i], hex[2 * i + 1], 0};
+    char *end;
+
+    key[i] = (uint8_t) strtoul (byte, &end, 16);
+    if (*end != 0)
+    {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+bool dfu_image_is_container (const char *path)
+{
+  char magic[4];
+  FILE *f = fopen (path, "rb");
+  bool is;
+
+  if (f == NULL)
+  {
+    return false;
+  }
+  is = fread (magic, 1, sizeof(magic), f) == sizeof(magic)
+    && memcmp (magic, DFU_IMAGE_MAGIC, 4) == 0;
+  fclose (f);
+  return is;
+}
+
+void dfu_image_free (dfu_image_t *img)
+{
+  free (img->page_hash);
+  free (img->data);
+  free (img->stream);
+  memset (img, 0, sizeof(*img));
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+ * @brief Prepared DFU images.
+ */
+
+/** @defgroup dfu_image dfu_image
+@{
+@ingroup host
+
+@brief An application image converted once for every later update
+@details dfuimg turns an Intel HEX file into a container that holds
+everything a central needs to update a device, so the transfer tools only
+read bytes: the image data, the init packet ready to send, and the CRC and
+tag that go with them. The container also lists the segments the HEX file
+gave, and a hash for each flash page.
+
+The image data, the stream, is stored in one of three ways:
+
+  - as it is,
+  - compressed with LZSS (DFU_IMAGE_LZ), for storage and distribution,
+  - as a delta against a base image (DFU_IMAGE_DELTA), a bitmap of the
+    pages whose hash differs followed by those pages, compressed or not.
+
+The bootloader is always sent the whole plain image; dfu_image_read()
+expands the stream, and checks the result against the page hashes, the
+CRC and the hash of the whole image.
+
+All fields are little-endian. The header is followed by the segment list,
+the page hashes, the init packet and the stream, in that order:
+
+  0  magic "ODFU"          24  tag (8), as checked by a DFU_AUTH bootloader
+  4  version (1)           32  hash of the whole image (8)
+  5  flags (1)             40  hash of the base image (8), deltas only
+  6  page size (2)         48  stream length (4)
+  8  image size (4)        52  reserved (4)
+ 12  image address (4)
+ 16  CRC-16 (2)            segments: start, size (4 + 4 each)
+ 18  segments (2)          page hashes: 8 bytes each
+ 20  pages (2)             init packet: CRC-16 (2) then tag (8)
+ 22  init packet size (1)
+ 23  reserved (1)
+
+Hashes are HalfSipHash-2-4 tags under the all-zero key, see auth.h: they
+identify content, only the tag authenticates it.
+*/
+
+#ifndef DFU_IMAGE_H__
+#define DFU_IMAGE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ihex.h"
+
+#define DFU_IMAGE_MAGIC        "ODFU"
+#define DFU_IMAGE_VERSION      1
+#define DFU_IMAGE_HEADER_SIZE  56
+
+/* Stream flags */
+#define DFU_IMAGE_LZ           0x01
+#define DFU_IMAGE_DELTA        0x02
+
+#define DFU_IMAGE_HASH_SIZE    8
+#define DFU_IMAGE_TAG_SIZE     8
+#define DFU_IMAGE_INIT_SIZE    (2 + DFU_IMAGE_TAG_SIZE)
+
+typedef struct
+{
+  uint8_t        flags;
+  uint16_t       page_size;
+  uint32_t       size;
+  uint32_t       address;
+  uint16_t       crc;        /* CRC-16-CCITT, as the nRF51 DFU tools use */
+  uint8_t        tag[DFU_IMAGE_TAG_SIZE];
+  uint8_t        hash[DFU_IMAGE_HASH_SIZE];
+  uint8_t        base_hash[DFU_IMAGE_HASH_SIZE];
+
+  ihex_segment_t segment[IHEX_MAX_SEGMENTS];
+  uint16_t       segments;
+  uint8_t       *page_hash;  /* DFU_IMAGE_HASH_SIZE per page */
+  uint16_t       pages;
+  uint8_t        init[DFU_IMAGE_INIT_SIZE];
+  uint8_t        init_len;
+  uint16_t       delta_pages; /* Pages a delta carries */
+
+  uint8_t       *data;       /* The plain image, size bytes */
+  uint8_t       *stream;     /* As stored in the container */
+  uint32_t       stream_size;
+} dfu_image_t;
+
+/** @brief CRC-16-CCITT of data, continuing from crc (0xFFFF to start). */
+uint16_t dfu_image_crc16(uint16_t crc, const uint8_t *data, uint32_t len);
+
+/** @brief Hash of len bytes. */
+void dfu_image_hash(const uint8_t *data, uint32_t len, uint8_t *hash);
+
+/** @brief Fill img from an application, tagged with key.
+ *  @param base Image to make a delta against, or NULL.
+ *  @return 0, or -1 if out of memory.
+ */
+int dfu_image_make(dfu_image_t *img, const ihex_image_t *app,
+    const uint8_t *key, uint16_t page_size, uint8_t flags,
+    const ihex_image_t *base);
+
+/** @brief Write img to path.
+ *  @return The container size, or -1 on I/O errors.
+ */
+long dfu_image_write(const dfu_image_t *img, const char *path);
+
+/** @brief Read and expand a container.
+ *  @param base The base image of a delta, NULL for other containers.
+ *  @return 0, or -1 with a reason in *error if the container is unusable.
+ */
+int dfu_image_read(dfu_image_t *img, const char *path,
+    const ihex_image_t *base, const char **error);
+
+/** @brief Parse an image key given as 16 hex digits.
+ *  @return 0, or -1 if hex is not a key.
+ */
+int dfu_image_parse_key(const char *hex, uint8_t *key);
+
+/** @brief True if path starts like a container. */
+bool dfu_image_is_container(const char *path);
+
+void dfu_image_free(dfu_image_t *img);
+
+#endif /* DFU_IMAGE_H__ */
+/** @} */
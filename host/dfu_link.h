@@ -0,0 +1,62 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Transport between the DFU central and the device it updates.
+ */
+
+/** @defgroup dfu_link dfu_link
+@{
+@ingroup host
+
+@brief What dfu_central needs from a BLE link
+@details A link writes to the pipes of the DFU service on the device and
+tells whether the device is connected. It hands the notifications of the
+control point back with dfu_central_notify(), along with the time they
+arrived. Writes are never queued by the central: a link returns false when
+the device cannot take one more packet right now, and the central tries
+again on its next dfu_central_run(), so the link stays as full as the
+device's credits and the receipt notification interval allow.
+
+Two links are provided: dfu_link_model.c for the nRF8001 model in the same
+process, and dfu_link_socket.c for a bootloader simulated in another
+process.
+*/
+
+#ifndef DFU_LINK_H__
+#define DFU_LINK_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+  /** @brief Write data on a pipe, false if the link has no room for it now. */
+  bool (*write)(void *ctx, uint8_t pipe, const uint8_t *data, uint8_t len);
+
+  /** @brief True while the device is connected. */
+  bool (*connected)(void *ctx);
+
+  void *ctx;
+} dfu_link_t;
+
+#endif /* DFU_LINK_H__ */
+/** @} */
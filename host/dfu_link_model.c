@@ -0,0 +1,55 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+  @brief Implementation of the dfu_link to the nRF8001 model.
+ */
+
+#include "dfu_link_model.h"
+
+static bool m_write (void *ctx, uint8_t pipe, const uint8_t *data,
+    uint8_t len)
+{
+  return nrf8001_central_write ((nrf8001_t *) ctx, pipe, data, len);
+}
+
+static bool m_connected (void *ctx)
+{
+  return nrf8001_connected ((nrf8001_t *) ctx);
+}
+
+static void m_notify (void *ctx, uint8_t pipe, const uint8_t *data,
+    uint8_t len)
+{
+  dfu_central_t *c = (dfu_central_t *) ctx;
+
+  dfu_central_notify (c, pipe, data, len, ((nrf8001_t *) c->link.ctx)->now_us);
+}
+
+void dfu_link_model (dfu_central_t *c, nrf8001_t *emu)
+{
+  c->link.write = m_write;
+  c->link.connected = m_connected;
+  c->link.ctx = emu;
+
+  nrf8001_notify_set (emu, m_notify, c);
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+ * @brief dfu_link to the nRF8001 model in the same process.
+ */
+
+/** @defgroup dfu_link_model dfu_link_model
+@{
+@ingroup dfu_link
+
+@brief The central writes straight into the model
+@details Writes go to nrf8001_central_write(), which refuses them once the
+packets of the current connection event are used up, and the model's
+notifications are passed to dfu_central_notify() at model time. This is the
+link of hostboot, bench and simboot.
+*/
+
+#ifndef DFU_LINK_MODEL_H__
+#define DFU_LINK_MODEL_H__
+
+#include "nrf8001.h"
+#include "dfu_central.h"
+
+/** @brief Run c over emu. Call after dfu_central_init(). */
+void dfu_link_model(dfu_central_t *c, nrf8001_t *emu);
+
+#endif /* DFU_LINK_MODEL_H__ */
+/** @} */
@@ -0,0 +1,392 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+/** @file
+  @brief Implementation of the dfu_link over a Unix domain socket.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "dfu_link_socket.h"
+
+/* Sends never raise SIGPIPE; a central that has gone is seen as EOF. */
+static int m_send (int fd, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+  uint8_t frame[2 + 255];
+  size_t size = 2 + (size_t) len;
+  size_t done = 0;
+
+  frame[0] = type;
+  frame[1] = len;
+  if (len)
+  {
+    memcpy (&frame[2], payload, len);
+  }
+
+  while (done < size)
+  {
+    ssize_t n = send (fd, &frame[done], size - done, MSG_NOSIGNAL);
+
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return -1;
+    }
+    done += (size_t) n;
+  }
+  return 0;
+}
+
+static int m_read_all (int fd, uint8_t *buf, size_t size)
+{
+  size_t done = 0;
+
+  while (done < size)
+  {
+    ssize_t n = read (fd, &buf[done], size - done);
+
+    if (n < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (n <= 0)
+    {
+      return -1;
+    }
+    done += (size_t) n;
+  }
+  return 0;
+}
+
+/* payload must hold 255 bytes */
+static int m_recv (int fd, uint8_t *type, uint8_t *payload, uint8_t *len)
+{
+  uint8_t hdr[2];
+
+  if (m_read_all (fd, hdr, 2) != 0 || m_read_all (fd, payload, hdr[1]) != 0)
+  {
+    return -1;
+  }
+  *type = hdr[0];
+  *len = hdr[1];
+  return 0;
+}
+
+static void m_put_u64 (uint8_t *p, uint64_t v)
+{
+  uint8_t i;
+
+  for (i = 0; i < 8; i++)
+  {
+    p[i] = (uint8_t) (v >> (8 * i));
+  }
+}
+
+static uint64_t m_get_u64 (const uint8_t *p)
+{
+  uint64_t v = 0;
+  uint8_t i;
+
+  for (i = 0; i < 8; i++)
+  {
+    v |= (uint64_t) p[i] << (8 * i);
+  }
+  return v;
+}
+
+static int m_address (struct sockaddr_un *addr, const char *path)
+{
+  if (strlen (path) >= sizeof (addr->sun_path))
+  {
+    return -1;
+  }
+  memset (addr, 0, sizeof (*addr));
+  addr->sun_family = AF_UNIX;
+  strcpy (addr->sun_path, path);
+  return 0;
+}
+
+/* Device end */
+
+static void m_device_notify (void *ctx, uint8_t pipe, const uint8_t *data,
+    uint8_t len)
+{
+  dfu_link_socket_device_t *d = (dfu_link_socket_device_t *) ctx;
+  uint8_t payload[9 + 255];
+
+  if (d->closed || len > 255 - 9)
+  {
+    return;
+  }
+  m_put_u64 (payload, d->emu->now_us);
+  payload[8] = pipe;
+  memcpy (&payload[9], data, len);
+  if (m_send (d->fd, DFU_LINK_SOCKET_NOTIFY, payload, (uint8_t) (9 + len)) != 0)
+  {
+    d->closed = true;
+  }
+}
+
+int dfu_link_socket_serve (dfu_link_socket_device_t *d, nrf8001_t *emu,
+    const uint8_t *pipes, const char *path)
+{
+  struct sockaddr_un addr;
+  int lfd;
+
+  memset (d, 0, sizeof (*d));
+  d->fd = -1;
+  d->emu = emu;
+
+  if (m_address (&addr, path) != 0)
+  {
+    return -1;
+  }
+  lfd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (lfd < 0)
+  {
+    return -1;
+  }
+  unlink (path);
+  if (bind (lfd, (struct sockaddr *) &addr, sizeof (addr)) != 0
+      || listen (lfd, 1) != 0)
+  {
+    close (lfd);
+    return -1;
+  }
+
+  do
+  {
+    d->fd = accept (lfd, NULL, NULL);
+  } while (d->fd < 0 && errno == EINTR);
+  close (lfd);
+  unlink (path);
+  if (d->fd < 0 || m_send (d->fd, DFU_LINK_SOCKET_HELLO, pipes, 3) != 0)
+  {
+    dfu_link_socket_device_close (d);
+    return -1;
+  }
+
+  nrf8001_notify_set (emu, m_device_notify, d);
+  return 0;
+}
+
+void dfu_link_socket_device_turn (dfu_link_socket_device_t *d, uint64_t now_us)
+{
+  uint8_t payload[255];
+  uint8_t type;
+  uint8_t len;
+
+  if (d->closed)
+  {
+    return;
+  }
+
+  m_put_u64 (payload, now_us);
+  payload[8] = nrf8001_connected (d->emu);
+  if (m_send (d->fd, DFU_LINK_SOCKET_TICK, payload, 9) != 0)
+  {
+    d->closed = true;
+    return;
+  }
+  d->turns++;
+
+  for (;;)
+  {
+    if (m_recv (d->fd, &type, payload, &len) != 0)
+    {
+      d->closed = true;
+      return;
+    }
+    if (type == DFU_LINK_SOCKET_TICK)
+    {
+      return;
+    }
+    if (type == DFU_LINK_SOCKET_WRITE && len >= 1)
+    {
+      uint8_t ack = nrf8001_central_write (d->emu, payload[0], &payload[1],
+          (uint8_t) (len - 1));
+
+      d->writes += ack;
+      if (m_send (d->fd, DFU_LINK_SOCKET_ACK, &ack, 1) != 0)
+      {
+        d->closed = true;
+        return;
+      }
+    }
+  }
+}
+
+void dfu_link_socket_device_close (dfu_link_socket_device_t *d)
+{
+  if (d->fd >= 0)
+  {
+    close (d->fd);
+    d->fd = -1;
+  }
+  d->closed = true;
+}
+
+/* Central end */
+
+static bool m_write (void *ctx, uint8_t pipe, const uint8_t *data,
+    uint8_t len)
+{
+  dfu_link_socket_t *s = (dfu_link_socket_t *) ctx;
+  uint8_t payload[255];
+  uint8_t type;
+  uint8_t rlen;
+
+  payload[0] = pipe;
+  memcpy (&payload[1], data, len);
+  if (m_send (s->fd, DFU_LINK_SOCKET_WRITE, payload, (uint8_t) (len + 1)) != 0)
+  {
+    return false;
+  }
+  /* The device does not notify during a turn */
+  if (m_recv (s->fd, &type, payload, &rlen) != 0
+      || type != DFU_LINK_SOCKET_ACK || rlen != 1)
+  {
+    return false;
+  }
+  return payload[0] != 0;
+}
+
+static bool m_connected (void *ctx)
+{
+  return ((dfu_link_socket_t *) ctx)->connected;
+}
+
+int dfu_link_socket_connect (dfu_link_socket_t *s, const char *path,
+    uint32_t timeout_ms)
+{
+  struct sockaddr_un addr;
+  uint8_t payload[255];
+  uint8_t type;
+  uint8_t len;
+  uint32_t waited = 0;
+
+  memset (s, 0, sizeof (*s));
+  s->fd = -1;
+  if (m_address (&addr, path) != 0)
+  {
+    return -1;
+  }
+
+  /* The device may still be starting up */
+  for (;;)
+  {
+    s->fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (s->fd < 0)
+    {
+      return -1;
+    }
+    if (connect (s->fd, (struct sockaddr *) &addr, sizeof (addr)) == 0)
+    {
+      break;
+    }
+    close (s->fd);
+    s->fd = -1;
+    if (waited >= timeout_ms)
+    {
+      return -1;
+    }
+    nanosleep (&(struct timespec) { 0, 10 * 1000 * 1000 }, NULL);
+    waited += 10;
+  }
+
+  if (m_recv (s->fd, &type, payload, &len) != 0
+      || type != DFU_LINK_SOCKET_HELLO || len != 3)
+  {
+    dfu_link_socket_close (s);
+    return -1;
+  }
+  memcpy (s->pipes, payload, 3);
+  return 0;
+}
+
+void dfu_link_socket (dfu_central_t *c, dfu_link_socket_t *s)
+{
+  c->link.write = m_write;
+  c->link.connected = m_connected;
+  c->link.ctx = s;
+}
+
+int dfu_link_socket_run (dfu_link_socket_t *s, dfu_central_t *c)
+{
+  uint8_t notify[DFU_LINK_SOCKET_NOTIFY_MAX][9 + DFU_LINK_SOCKET_DATA_MAX];
+  uint8_t notify_len[DFU_LINK_SOCKET_NOTIFY_MAX];
+  uint8_t notifies = 0;
+  uint8_t payload[255];
+  uint8_t type;
+  uint8_t len;
+  uint8_t i;
+
+  /* Held until the turn begins: the central may write in answer to them */
+  for (;;)
+  {
+    if (s->fd < 0 || m_recv (s->fd, &type, payload, &len) != 0)
+    {
+      return -1;
+    }
+    if (type == DFU_LINK_SOCKET_TICK && len == 9)
+    {
+      break;
+    }
+    if (type == DFU_LINK_SOCKET_NOTIFY && len >= 9
+        && len <= 9 + DFU_LINK_SOCKET_DATA_MAX
+        && notifies < DFU_LINK_SOCKET_NOTIFY_MAX)
+    {
+      memcpy (notify[notifies], payload, len);
+      notify_len[notifies++] = len;
+    }
+  }
+
+  s->now_us = m_get_u64 (payload);
+  s->connected = payload[8] != 0;
+  s->turns++;
+
+  for (i = 0; i < notifies; i++)
+  {
+    dfu_central_notify (c, notify[i][8], &notify[i][9],
+        (uint8_t) (notify_len[i] - 9), m_get_u64 (notify[i]));
+  }
+  dfu_central_run (c, s->now_us);
+  return m_send (s->fd, DFU_LINK_SOCKET_TICK, NULL, 0);
+}
+
+void dfu_link_socket_close (dfu_link_socket_t *s)
+{
+  if (s->fd >= 0)
+  {
+    close (s->fd);
+    s->fd = -1;
+  }
+}
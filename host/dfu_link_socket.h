@@ -0,0 +1,121 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+ * @brief dfu_link to a bootloader simulated in another process.
+ */
+
+/** @defgroup dfu_link_socket dfu_link_socket
+@{
+@ingroup dfu_link
+
+@brief Lockstep link over a Unix domain socket
+@details hostboot -S serves the bootloader of the host build, with its
+nRF8001 model, on a socket; a central in another process connects to it,
+such as dfuclient -s. The simulated device runs in virtual time and hands
+the central a turn whenever it polls the link, so the session is as fast
+and as repeatable as one run in a single process.
+
+Every frame is a type byte, a length byte and that many bytes of payload:
+
+  H  device to central, once: the three DFU pipes
+  N  device to central: model time (8 bytes, little-endian), pipe, data
+  T  device to central: model time (8 bytes) and connected (1 byte), the
+     central's turn begins; central to device, empty: the turn ends
+  W  central to device: pipe, data
+  A  device to central: 1 if the write was taken, 0 if the link was full
+
+During its turn the central sends any number of W frames, each answered by
+an A frame, and ends the turn with T. Notifications are sent as the model
+produces them, never during a turn; the central holds them until the next
+T and handles them in its turn, since it may write in answer to them.
+*/
+
+#ifndef DFU_LINK_SOCKET_H__
+#define DFU_LINK_SOCKET_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf8001.h"
+#include "dfu_central.h"
+
+#define DFU_LINK_SOCKET_HELLO   'H'
+#define DFU_LINK_SOCKET_NOTIFY  'N'
+#define DFU_LINK_SOCKET_TICK    'T'
+#define DFU_LINK_SOCKET_WRITE   'W'
+#define DFU_LINK_SOCKET_ACK     'A'
+
+/* Notifications held by the central between two turns, and their size */
+#define DFU_LINK_SOCKET_NOTIFY_MAX  16
+#define DFU_LINK_SOCKET_DATA_MAX    20
+
+/** Device end, in the process of the simulated bootloader */
+typedef struct
+{
+  int        fd;
+  nrf8001_t *emu;
+  bool       closed;         /* The central has gone */
+  uint32_t   turns;
+  uint32_t   writes;
+} dfu_link_socket_device_t;
+
+/** Central end */
+typedef struct
+{
+  int        fd;
+  uint8_t    pipes[3];       /* As sent by the device */
+  bool       connected;
+  uint64_t   now_us;         /* Model time of the last turn */
+  uint32_t   turns;
+} dfu_link_socket_t;
+
+/** @brief Listen on path and wait for one central to connect.
+ *  @return 0 on success, -1 on socket errors.
+ */
+int dfu_link_socket_serve(dfu_link_socket_device_t *d, nrf8001_t *emu,
+    const uint8_t *pipes, const char *path);
+
+/** @brief Give the central a turn, at model time now_us. */
+void dfu_link_socket_device_turn(dfu_link_socket_device_t *d, uint64_t now_us);
+
+void dfu_link_socket_device_close(dfu_link_socket_device_t *d);
+
+/** @brief Connect to a device served on path, retrying for up to timeout_ms.
+ *  @return 0 on success, -1 if no device answered.
+ */
+int dfu_link_socket_connect(dfu_link_socket_t *s, const char *path,
+    uint32_t timeout_ms);
+
+/** @brief Run c over s. Call after dfu_central_init(). */
+void dfu_link_socket(dfu_central_t *c, dfu_link_socket_t *s);
+
+/** @brief Take one turn: pass on the notifications, run the central and end
+ *  the turn.
+ *  @return 0, or -1 once the device has gone.
+ */
+int dfu_link_socket_run(dfu_link_socket_t *s, dfu_central_t *c);
+
+void dfu_link_socket_close(dfu_link_socket_t *s);
+
+#endif /* DFU_LINK_SOCKET_H__ */
+/** @} */
@@ -0,0 +1,369 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+  @brief Update a bootloader with an application image, over BLE DFU to a
+  simulated device or over STK500 on a serial port, and report the session
+  as JSON.
+
+  Usage: dfuclient -s <socket> [options] <application.hex>
+         dfuclient -d <tty> [options] <application.hex>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "../auth.h"
+
+#include "ihex.h"
+#include "dfu_central.h"
+#include "dfu_image.h"
+#include "dfu_link_socket.h"
+#include "stk500_client.h"
+
+static const char *m_usage =
+  "Usage: dfuclient [options] <application.hex | container>\n"
+  "  -s <socket>    BLE DFU of the bootloader served by hostboot -S <socket>\n"
+  "  -d <tty>       STK500 upload over a serial port, as avrdude -c arduino\n"
+  "  -b <baud>      serial baud rate (115200)\n"
+  "  -g <bytes>     flash page size of the target (128, or the container's)\n"
+  "  -n <prn>       packets per receipt notification, 0 for none (0)\n"
+  "  -K <key>       image key, 16 hex digits (0001020304050607, as hostboot)\n"
+  "  -D <base.hex>  base image of a delta container, see dfuimg\n"
+  "  -t <seconds>   time limit (120)\n"
+  "  -x <bytes>     drop the link once this much of the image was sent (-s)\n";
+
+static uint64_t m_wall_us (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/* BLE DFU over dfu_link_socket, in the device's virtual time */
+static int m_run_socket (const char *path, const dfu_image_t *app,
+    uint16_t prn, uint64_t limit_us, uint32_t drop_at)
+{
+  dfu_link_socket_t link;
+  dfu_central_t c;
+  uint64_t wall = m_wall_us ();
+  double fw_s;
+
+  if (dfu_link_socket_connect (&link, path, 5000) != 0)
+  {
+    fprintf (stderr, "dfuclient: no device on %s\n", path);
+    return 1;
+  }
+
+  dfu_central_init (&c, app->data, app->size, link.pipes, prn);
+  dfu_link_socket (&c, &link);
+  c.init = app->init;
+  c.init_len = app->init_len;
+
+  while (!dfu_central_finished (&c) && link.now_us < limit_us
+      && (!drop_at || c.offset < drop_at))
+  {
+    if (dfu_link_socket_run (&link, &c) != 0)
+    {
+      break;
+    }
+  }
+  dfu_link_socket_close (&link);
+  wall = m_wall_us () - wall;
+  fw_s = (c.t_fw_done - c.t_fw_start) / 1e6;
+
+  printf ("{\n");
+  printf ("  \"transport\": \"ble\",\n");
+  printf ("  \"image_size\": %u,\n", app->size);
+  printf ("  \"prn\": %u,\n", prn);
+  printf ("  \"sim_time_us\": %llu,\n", (unsigned long long) link.now_us);
+  printf ("  \"t_connected_us\": %llu,\n", (unsigned long long) c.t_connected);
+  printf ("  \"t_fw_start_us\": %llu,\n", (unsigned long long) c.t_fw_start);
+  printf ("  \"t_fw_done_us\": %llu,\n", (unsigned long long) c.t_fw_done);
+  printf ("  \"t_done_us\": %llu,\n", (unsigned long long) c.t_done);
+  printf ("  \"throughput_bps\": %.1f,\n", fw_s > 0 ? app->size / fw_s : 0.0);
+  printf ("  \"packets\": %u,\n", c.packets);
+  printf ("  \"prn_received\": %u,\n", c.prn_received);
+  printf ("  \"stall_us\": %llu,\n", (unsigned long long) c.stall_us);
+  printf ("  \"turns\": %u,\n", link.turns);
+  printf ("  \"wall_us\": %llu,\n", (unsigned long long) wall);
+  printf ("  \"central_state\": %u,\n", c.state);
+  printf ("  \"done\": %s\n", c.state == DFU_CENTRAL_DONE ? "true" : "false");
+  printf ("}\n");
+
+  return c.state == DFU_CENTRAL_DONE ? 0 : 1;
+}
+
+static speed_t m_speed (unsigned long baud)
+{
+  switch (baud)
+  {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 1000000: return B1000000;
+    default: return B0;
+  }
+}
+
+/* Raw 8N1, and the DTR/RTS pulse that resets an Arduino into optiboot */
+static int m_open_tty (const char *tty, unsigned long baud)
+{
+  struct termios tio;
+  int lines = TIOCM_DTR | TIOCM_RTS;
+  speed_t speed = m_speed (baud);
+  int fd;
+
+  if (speed == B0)
+  {
+    fprintf (stderr, "dfuclient: unsupported baud rate %lu\n", baud);
+    return -1;
+  }
+  fd = open (tty, O_RDWR | O_NOCTTY);
+  if (fd < 0 || tcgetattr (fd, &tio) != 0)
+  {
+    fprintf (stderr, "dfuclient: cannot open %s: %s\n", tty, strerror (errno));
+    if (fd >= 0)
+    {
+      close (fd);
+    }
+    return -1;
+  }
+  cfmakeraw (&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  cfsetispeed (&tio, speed);
+  cfsetospeed (&tio, speed);
+  tcsetattr (fd, TCSANOW, &tio);
+
+  /* Not all ports have modem lines */
+  ioctl (fd, TIOCMBIC, &lines);
+  nanosleep (&(struct timespec) { 0, 250 * 1000 * 1000 }, NULL);
+  ioctl (fd, TIOCMBIS, &lines);
+  nanosleep (&(struct timespec) { 0, 50 * 1000 * 1000 }, NULL);
+  tcflush (fd, TCIOFLUSH);
+  return fd;
+}
+
+/* STK500 over a serial port, in wall-clock time */
+static int m_run_serial (const char *tty, unsigned long baud,
+    uint16_t page_size, const dfu_image_t *app, uint64_t limit_us)
+{
+  stk500_client_t c;
+  uint64_t start;
+  uint64_t last_rx;
+  uint32_t syncs = 1;
+  double fw_s;
+  int fd = m_open_tty (tty, baud);
+
+  if (fd < 0)
+  {
+    return 1;
+  }
+
+  start = m_wall_us ();
+  last_rx = start;
+  stk500_client_init (&c, app->data, app->size, page_size);
+
+  while (!stk500_client_finished (&c) && m_wall_us () - start < limit_us)
+  {
+    uint8_t buf[sizeof(c.tx)];
+    size_t len = 0;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    uint64_t now = m_wall_us () - start;
+
+    while (len < sizeof(buf) && stk500_client_tx (&c, &buf[len], now))
+    {
+      len++;
+    }
+    if (len && write (fd, buf, len) != (ssize_t) len)
+    {
+      break;
+    }
+
+    if (poll (&pfd, 1, 100) > 0)
+    {
+      ssize_t n = read (fd, buf, sizeof(buf));
+      ssize_t i;
+
+      now = m_wall_us () - start;
+      for (i = 0; i < n; i++)
+      {
+        stk500_client_rx (&c, buf[i], now);
+      }
+      if (n > 0)
+      {
+        last_rx = m_wall_us ();
+      }
+    }
+    /* Optiboot may still be flashing its LED; sync again, as avrdude does */
+    else if (c.state == STK500_CLIENT_SYNC && m_wall_us () - last_rx > 300000)
+    {
+      tcflush (fd, TCIFLUSH);
+      stk500_client_init (&c, app->data, app->size, page_size);
+      last_rx = m_wall_us ();
+      syncs++;
+    }
+  }
+  close (fd);
+  fw_s = (c.t_last_page - c.t_first_page) / 1e6;
+
+  printf ("{\n");
+  printf ("  \"transport\": \"uart\",\n");
+  printf ("  \"image_size\": %u,\n", app->size);
+  printf ("  \"baud\": %lu,\n", baud);
+  printf ("  \"page_size\": %u,\n", page_size);
+  printf ("  \"syncs\": %u,\n", syncs);
+  printf ("  \"t_first_page_us\": %llu,\n",
+      (unsigned long long) c.t_first_page);
+  printf ("  \"t_last_page_us\": %llu,\n", (unsigned long long) c.t_last_page);
+  printf ("  \"t_done_us\": %llu,\n", (unsigned long long) c.t_done);
+  printf ("  \"throughput_bps\": %.1f,\n", fw_s > 0 ? app->size / fw_s : 0.0);
+  printf ("  \"pages\": %u,\n", c.pages);
+  printf ("  \"bytes_sent\": %u,\n", c.bytes_sent);
+  printf ("  \"done\": %s\n", c.state == STK500_CLIENT_DONE ? "true" : "false");
+  printf ("}\n");
+
+  return c.state == STK500_CLIENT_DONE ? 0 : 1;
+}
+
+int main (int argc, char **argv)
+{
+  const char *socket_path = NULL;
+  const char *tty = NULL;
+  unsigned long baud = 115200;
+  const char *base_path = NULL;
+  uint8_t key[AUTH_KEY_SIZE] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07};
+  uint16_t page_size = 0;
+  uint16_t prn = 0;
+  uint64_t limit_us = 120 * 1000000ULL;
+  uint32_t drop_at = 0;
+  ihex_image_t base;
+  ihex_image_t hex;
+  dfu_image_t app;
+  const char *error;
+  int status;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "s:d:b:g:n:K:D:t:x:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 's': socket_path = optarg; break;
+      case 'd': tty = optarg; break;
+      case 'b': baud = strtoul (optarg, NULL, 0); break;
+      case 'g': page_size = strtoul (optarg, NULL, 0); break;
+      case 'n': prn = strtoul (optarg, NULL, 0); break;
+      case 't': limit_us = strtoull (optarg, NULL, 0) * 1000000ULL; break;
+      case 'x': drop_at = strtoul (optarg, NULL, 0); break;
+      case 'K':
+        if (dfu_image_parse_key (optarg, key) != 0)
+        {
+          fprintf (stderr, "dfuclient: the key is %u hex digits\n",
+              2 * AUTH_KEY_SIZE);
+          return 2;
+        }
+        break;
+      case 'D': base_path = optarg; break;
+      default:
+        fputs (m_usage, stderr);
+        return opt == 'h' ? 0 : 2;
+    }
+  }
+
+  if (argc - optind != 1 || !socket_path == !tty
+      || page_size > 512)
+  {
+    fputs (m_usage, stderr);
+    return 2;
+  }
+
+  if (base_path && ihex_load (base_path, &base) != 0)
+  {
+    fprintf (stderr, "dfuclient: cannot load base image %s\n", base_path);
+    return 1;
+  }
+
+  /* A .hex is prepared here the way dfuimg would, without the stream */
+  if (dfu_image_is_container (argv[optind]))
+  {
+    if (dfu_image_read (&app, argv[optind], base_path ? &base : NULL,
+          &error) != 0)
+    {
+      fprintf (stderr, "dfuclient: %s: %s\n", argv[optind], error);
+      return 1;
+    }
+  }
+  else if (ihex_load (argv[optind], &hex) != 0
+      || dfu_image_make (&app, &hex, key, page_size ? page_size : 128, 0,
+        NULL) != 0)
+  {
+    fprintf (stderr, "dfuclient: cannot load application %s\n", argv[optind]);
+    return 1;
+  }
+  else
+  {
+    ihex_free (&hex);
+  }
+
+  if (app.address != 0)
+  {
+    fprintf (stderr, "dfuclient: the application must start at address 0\n");
+    dfu_image_free (&app);
+    return 1;
+  }
+  if (page_size == 0)
+  {
+    page_size = app.page_size;
+  }
+
+  if (socket_path)
+  {
+    status = m_run_socket (socket_path, &app, prn, limit_us, drop_at);
+  }
+  else
+  {
+    status = m_run_serial (tty, baud, page_size, &app, limit_us);
+  }
+
+  dfu_image_free (&app);
+  if (base_path)
+  {
+    ihex_free (&base);
+  }
+  return status;
+}
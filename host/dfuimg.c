@@ -0,0 +1,194 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/** @file
+  @brief Prepare an application for BLE DFU once, as a container that the
+  transfer tools read as is, or check and describe such a container.
+
+  Usage: dfuimg [options] <application.hex> <container>
+         dfuimg -i [-d <base.hex>] <container>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../auth.h"
+
+#include "ihex.h"
+#include "dfu_image.h"
+
+static const char *m_usage =
+  "Usage: dfuimg [options] <application.hex> <container>\n"
+  "       dfuimg -i [-d <base.hex>] <container>\n"
+  "  -K <key>       image key, 16 hex digits (0001020304050607, as hostboot)\n"
+  "  -g <bytes>     flash page size of the target (128)\n"
+  "  -z             compress the image data\n"
+  "  -d <base.hex>  store only the pages that differ from base; with -i, the\n"
+  "                 base to expand the container against\n"
+  "  -i             check a container and describe it\n";
+
+static void m_hex (const char *name, const uint8_t *data, unsigned len,
+    const char *end)
+{
+  unsigned i;
+
+  printf ("  \"%s\": \"", name);
+  for (i = 0; i < len; i++)
+  {
+    printf ("%02x", data[i]);
+  }
+  printf ("\"%s\n", end);
+}
+
+static void m_describe (const dfu_image_t *img, long container_size)
+{
+  unsigned i;
+
+  printf ("{\n");
+  printf ("  \"image_size\": %u,\n", img->size);
+  printf ("  \"address\": %u,\n", img->address);
+  printf ("  \"page_size\": %u,\n", img->page_size);
+  printf ("  \"pages\": %u,\n", img->pages);
+  printf ("  \"segments\": [");
+  for (i = 0; i < img->segments; i++)
+  {
+    printf ("%s[%u, %u]", i ? ", " : "", img->segment[i].start,
+        img->segment[i].size);
+  }
+  printf ("],\n");
+  printf ("  \"crc16\": %u,\n", img->crc);
+  m_hex ("tag", img->tag, DFU_IMAGE_TAG_SIZE, ",");
+  m_hex ("hash", img->hash, DFU_IMAGE_HASH_SIZE, ",");
+  m_hex ("init_packet", img->init, img->init_len, ",");
+  printf ("  \"compressed\": %s,\n", img->flags & DFU_IMAGE_LZ ? "true" : "false");
+  printf ("  \"delta\": %s,\n", img->flags & DFU_IMAGE_DELTA ? "true" : "false");
+  if (img->flags & DFU_IMAGE_DELTA)
+  {
+    m_hex ("base_hash", img->base_hash, DFU_IMAGE_HASH_SIZE, ",");
+    printf ("  \"delta_pages\": %u,\n", img->delta_pages);
+  }
+  printf ("  \"stream_size\": %u,\n", img->stream_size);
+  printf ("  \"container_size\": %ld\n", container_size);
+  printf ("}\n");
+}
+
+int main (int argc, char **argv)
+{
+  uint8_t key[AUTH_KEY_SIZE] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07};
+  const char *base_path = NULL;
+  uint16_t page_size = 128;
+  uint8_t flags = 0;
+  bool info = false;
+  ihex_image_t base;
+  ihex_image_t app;
+  dfu_image_t img;
+  const char *error;
+  long size;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "K:g:zd:ih")) != -1)
+  {
+    switch (opt)
+    {
+      case 'K':
+        if (dfu_image_parse_key (optarg, key) != 0)
+        {
+          fprintf (stderr, "dfuimg: the key is %u hex digits\n",
+              2 * AUTH_KEY_SIZE);
+          return 2;
+        }
+        break;
+      case 'g': page_size = strtoul (optarg, NULL, 0); break;
+      case 'z': flags |= DFU_IMAGE_LZ; break;
+      case 'd': base_path = optarg; break;
+      case 'i': info = true; break;
+      default:
+        fputs (m_usage, stderr);
+        return opt == 'h' ? 0 : 2;
+    }
+  }
+
+  if (argc - optind != (info ? 1 : 2) || page_size == 0 || page_size > 512)
+  {
+    fputs (m_usage, stderr);
+    return 2;
+  }
+
+  if (base_path && ihex_load (base_path, &base) != 0)
+  {
+    fprintf (stderr, "dfuimg: cannot load base image %s\n", base_path);
+    return 1;
+  }
+
+  if (info)
+  {
+    FILE *f;
+
+    if (dfu_image_read (&img, argv[optind], base_path ? &base : NULL,
+          &error) != 0)
+    {
+      fprintf (stderr, "dfuimg: %s: %s\n", argv[optind], error);
+      return 1;
+    }
+    f = fopen (argv[optind], "rb");
+    fseek (f, 0, SEEK_END);
+    size = ftell (f);
+    fclose (f);
+  }
+  else
+  {
+    if (ihex_load (argv[optind], &app) != 0)
+    {
+      fprintf (stderr, "dfuimg: cannot load application %s\n", argv[optind]);
+      return 1;
+    }
+    if (base_path)
+    {
+      flags |= DFU_IMAGE_DELTA;
+    }
+    if (dfu_image_make (&img, &app, key, page_size, flags,
+          base_path ? &base : NULL) != 0)
+    {
+      fprintf (stderr, "dfuimg: out of memory\n");
+      return 1;
+    }
+    size = dfu_image_write (&img, argv[optind + 1]);
+    if (size < 0)
+    {
+      fprintf (stderr, "dfuimg: cannot write %s\n", argv[optind + 1]);
+      return 1;
+    }
+    ihex_free (&app);
+  }
+
+  m_describe (&img, size);
+
+  dfu_image_free (&img);
+  if (base_path)
+  {
+    ihex_free (&base);
+  }
+  return 0;
+}
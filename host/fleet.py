@@ -0,0 +1,316 @@
+## @description
+## Update a fleet of devices concurrently and report how long the rollout
+## took, per device and overall.
+##
+## Every session is one dfuclient run: BLE DFU over dfu_link_socket to a
+## device served by hostboot -S, or STK500 to a board on a serial port.
+## Devices are spread over --jobs parallel sessions. A device whose session
+## fails is tried again, up to --retries times; with --state the devices
+## already updated to the same image are skipped, so an interrupted rollout
+## resumes where it stopped.
+##
+## --sim N makes N simulated devices, each a hostboot -S instance started
+## for every attempt, which also checks the flash against --app. --drop
+## cuts that share of the sessions short, at a random point, to exercise
+## the retries. --scale runs the rollout for several fleet sizes in a row.
+##
+## Only serial boards and simulated BLE devices are supported: dfuclient
+## has no transport to a BLE adapter, so ble:<socket> reaches a bootloader
+## simulated by hostboot -S, not a device over the air.
+
+## @setup
+## make -C host hostboot dfuclient. Real devices: serial:<tty>[@<baud>].
+## ble:<socket> for a bootloader already simulated by hostboot -S on a
+## socket.
+
+## @expected_output
+## JSON: a summary of each rollout with the per-device rows. "model_s" is
+## the rollout time in device time, the sessions laid out over the jobs in
+## the order they ran; "wall_s" is the time the orchestrator took.
+
+#########################################
+from __future__ import print_function
+
+import argparse
+import hashlib
+import heapq
+import json
+import os
+import random
+import shutil
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+try:
+  import queue
+except ImportError:
+  import Queue as queue
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_APP = os.path.join(HOST_DIR, '..', 'tests', 'test_application.hex')
+HOSTBOOT = os.path.join(HOST_DIR, 'hostboot')
+DFUCLIENT = os.path.join(HOST_DIR, 'dfuclient')
+
+
+class Device(object):
+  def __init__(self, spec, workdir):
+    self.id = spec
+    self.kind, _, self.target = spec.partition(':')
+    self.baud = 115200
+    if self.kind == 'sim':
+      self.target = os.path.join(workdir, '%s.sock' % self.target)
+    elif self.kind == 'serial' and '@' in self.target:
+      self.target, baud = self.target.rsplit('@', 1)
+      self.baud = int(baud)
+    elif self.kind not in ('ble', 'serial'):
+      raise ValueError('unknown device %s' % spec)
+
+
+def parse_json(text):
+  try:
+    return json.loads(text.decode('ascii'))
+  except ValueError:
+    return None
+
+
+def hex_size(f):
+  """Size of an Intel hex image from address 0"""
+  size = 0
+  for line in f:
+    line = line.strip()
+    if line.startswith(':'):
+      rec = bytearray.fromhex(line[1:])
+      if rec[3] == 0:
+        size = max(size, ((rec[1] << 8) | rec[2]) + rec[0])
+  return size
+
+
+def image_id(path):
+  with open(path, 'rb') as f:
+    return hashlib.sha256(f.read()).hexdigest()
+
+
+def attempt(dev, args, rng):
+  """One session: (ok, client report, error)"""
+  server = None
+  if dev.kind == 'sim':
+    if os.path.exists(dev.target):
+      os.unlink(dev.target)
+    server = subprocess.Popen([HOSTBOOT, '-S', dev.target, args.app],
+                              stdout=subprocess.PIPE)
+
+  cmd = [DFUCLIENT, '-n', str(args.prn)]
+  if dev.kind == 'serial':
+    cmd += ['-d', dev.target, '-b', str(dev.baud)]
+  else:
+    cmd += ['-s', dev.target]
+  if args.base:
+    cmd += ['-D', args.base]
+  cmd.append(args.image)
+
+  if server and rng.random() < args.drop:
+    # A link lost part way through, as a phone walking out of range
+    cmd[1:1] = ['-x', str(rng.randint(1, args.image_size))]
+
+  client = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+  out, _ = client.communicate()
+  report = parse_json(out)
+
+  error = None
+  if client.returncode != 0:
+    error = 'client exited with %d' % client.returncode
+  if server:
+    # Left alone, the device gives up the session in its own time
+    out, _ = server.communicate()
+    check = parse_json(out)
+    if error is None and not (check and check['verified'] and
+                              check['app_started']):
+      error = 'device flash does not match the image'
+  return error is None, report, error
+
+
+def run_device(dev, args, rng):
+  row = dict(device=dev.id, transport=dev.kind, ok=False, attempts=0,
+             wall_s=0.0, model_s=0.0, image_size=0, throughput_bps=0.0,
+             error=None)
+  start = time.time()
+  while not row['ok'] and row['attempts'] <= args.retries:
+    row['attempts'] += 1
+    ok, report, error = attempt(dev, args, rng)
+    if report:
+      # Device time until the image was activated, or of a failed try
+      t = report['t_done_us'] if ok else report.get('sim_time_us',
+                                                   report['t_done_us'])
+      row['model_s'] += t / 1e6
+      if ok:
+        row['image_size'] = report['image_size']
+        row['throughput_bps'] = report['throughput_bps']
+    row['ok'], row['error'] = ok, error
+  row['wall_s'] = time.time() - start
+  return row
+
+
+def percentile(values, p):
+  if not values:
+    return 0.0
+  values = sorted(values)
+  return values[min(len(values) - 1, int(round(p / 100.0 * (len(values) - 1))))]
+
+
+def stats(values):
+  return dict(mean=sum(values) / len(values) if values else 0.0,
+              p50=percentile(values, 50), p95=percentile(values, 95),
+              max=max(values) if values else 0.0)
+
+
+def model_rollout(rows, jobs):
+  """Device time of the rollout, the sessions placed on the first free job"""
+  slots = [0.0] * jobs
+  for r in rows:
+    heapq.heapreplace(slots, slots[0] + r['model_s'])
+  return max(slots)
+
+
+def rollout(devices, args, state):
+  image = image_id(args.image)
+  pending = queue.Queue()
+  rows = []
+  skipped = []
+  lock = threading.Lock()
+
+  for dev in devices:
+    if state.get(dev.id) == image:
+      skipped.append(dev.id)
+    else:
+      pending.put(dev)
+
+  def worker(seed):
+    rng = random.Random(seed)
+    while True:
+      try:
+        dev = pending.get_nowait()
+      except queue.Empty:
+        return
+      row = run_device(dev, args, rng)
+      with lock:
+        rows.append(row)
+        if row['ok']:
+          state[dev.id] = image
+          save_state(args.state, state)
+        print('%s ok=%s attempts=%u wall_s=%.3f model_s=%.3f' % (
+              row['device'], row['ok'], row['attempts'], row['wall_s'],
+              row['model_s']), file=sys.stderr)
+
+  start = time.time()
+  threads = [threading.Thread(target=worker, args=(args.seed + i,))
+             for i in range(args.jobs)]
+  for t in threads:
+    t.start()
+  for t in threads:
+    t.join()
+  wall = time.time() - start
+
+  done = [r for r in rows if r['ok']]
+  model = model_rollout(rows, args.jobs)
+  sent = sum(r['image_size'] for r in done)
+  return dict(
+      fleet=len(devices), jobs=args.jobs, image=args.image, prn=args.prn,
+      succeeded=len(done), failed=len(rows) - len(done),
+      skipped=len(skipped),
+      attempts=sum(r['attempts'] for r in rows),
+      retries=sum(r['attempts'] - 1 for r in rows),
+      wall_s=wall,
+      model_s=model,
+      throughput_bps_wall=sent / wall if wall else 0.0,
+      throughput_bps_model=sent / model if model else 0.0,
+      session_wall_s=stats([r['wall_s'] for r in done]),
+      session_model_s=stats([r['model_s'] for r in done]),
+      devices=sorted(rows, key=lambda r: r['device']))
+
+
+def load_state(path):
+  if not path or not os.path.exists(path):
+    return {}
+  with open(path) as f:
+    return json.load(f)
+
+
+def save_state(path, state):
+  if not path:
+    return
+  with open(path + '.tmp', 'w') as f:
+    json.dump(state, f, indent=2, sort_keys=True)
+  os.rename(path + '.tmp', path)
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Update many devices at once and report the rollout',
+      epilog='Real devices are only reached over serial: ble:<socket> is a '
+      'bootloader simulated by hostboot -S, there is no BLE adapter '
+      'transport.')
+  parser.add_argument('devices', nargs='*',
+                      help='serial:<tty>[@<baud>], or ble:<socket> of a '
+                      'hostboot -S instance')
+  parser.add_argument('--devices-file', help='one device per line')
+  parser.add_argument('--sim', type=int, default=0,
+                      help='simulated devices (hostboot -S) to add')
+  parser.add_argument('--scale', help='fleet sizes of simulated devices, '
+                      'one rollout each, e.g. 1,4,16')
+  parser.add_argument('--app', default=DEFAULT_APP,
+                      help='application .hex simulated devices check against')
+  parser.add_argument('--image', help='image to send, .hex or dfuimg '
+                      'container (--app)')
+  parser.add_argument('--base', help='base .hex of a delta container')
+  parser.add_argument('--prn', type=int, default=0)
+  parser.add_argument('-j', '--jobs', type=int, default=4)
+  parser.add_argument('--retries', type=int, default=2)
+  parser.add_argument('--state', help='record of updated devices, to resume')
+  parser.add_argument('--drop', type=float, default=0.0,
+                      help='share of simulated sessions cut short')
+  parser.add_argument('--seed', type=int, default=1)
+  parser.add_argument('-o', '--output', help='output file (stdout)')
+  args = parser.parse_args()
+
+  args.image = args.image or args.app
+  with open(args.app) as f:
+    args.image_size = hex_size(f)
+  if args.jobs < 1:
+    parser.error('--jobs must be at least 1')
+  if args.scale and (args.devices or args.devices_file or args.sim):
+    parser.error('--scale makes its own simulated fleets')
+
+  specs = list(args.devices)
+  if args.devices_file:
+    with open(args.devices_file) as f:
+      specs += [l.strip() for l in f if l.strip() and not l.startswith('#')]
+  sizes = [int(v) for v in args.scale.split(',')] if args.scale else [None]
+  if not args.scale and not specs and not args.sim:
+    parser.error('no devices')
+
+  workdir = tempfile.mkdtemp(prefix='fleet')
+  reports = []
+  try:
+    for n in sizes:
+      sims = ['sim:sim%03u' % i for i in range(n if n else args.sim)]
+      devices = [Device(s, workdir) for s in specs + sims]
+      # Every fleet size starts from devices that have not been updated
+      state = load_state(args.state) if not args.scale else {}
+      reports.append(rollout(devices, args, state))
+  finally:
+    shutil.rmtree(workdir)
+
+  out = open(args.output, 'w') if args.output else sys.stdout
+  json.dump(reports if args.scale else reports[0], out, indent=2)
+  out.write('\n')
+  if args.output:
+    out.close()
+
+  return 0 if all(r['failed'] == 0 for r in reports) else 1
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,314 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the host ACI transport layer.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../arena.h"
+#include "../capture.h"
+#include "../live.h"
+#include "../perf.h"
+#include "../BLE/hal_aci_tl.h"
+#include "../BLE/aci_queue.h"
+#include "../BLE/lib_aci.h"
+
+#include "host_mcu.h"
+#include "hal_aci_tl_host.h"
+
+hal_aci_tl_host_stats_t hal_aci_tl_host_stats;
+
+/* Both queues live in the RAM arena, see arena.h */
+#define aci_tx_q  (arena.ble.aci_tx_q)
+#define aci_rx_q  (arena.ble.aci_rx_q)
+
+static nrf8001_t              *m_radio;
+static aci_replay_t           *m_replay;
+static hal_aci_tl_host_poll_t  m_poll;
+static void                   *m_poll_ctx;
+
+/* Bring the radio, and whoever drives it, up to the current time */
+static void m_radio_run (void)
+{
+  const uint64_t now = host_mcu_now ();
+
+  if (m_replay)
+  {
+    return;
+  }
+
+  nrf8001_run (m_radio, now);
+  if (m_poll)
+  {
+    m_poll (m_poll_ctx, now);
+  }
+}
+
+/* RDYN goes low when the radio has an event, or shortly after REQN is
+ * pulled low for a command once the radio has started.
+ */
+static bool m_rdyn_low (void)
+{
+  if (m_replay)
+  {
+    return aci_replay_evt_pending (m_replay, host_mcu_now ()) ||
+      !aci_queue_is_empty (&aci_tx_q);
+  }
+
+  if (nrf8001_evt_pending (m_radio))
+  {
+    return true;
+  }
+
+  return !aci_queue_is_empty (&aci_tx_q) &&
+    m_radio->state != NRF8001_ST_RESET;
+}
+
+/* The next time the radio, or the capture, has something for us */
+static uint64_t m_next_deadline (void)
+{
+  if (m_replay)
+  {
+    return aci_replay_next_deadline (m_replay);
+  }
+
+  return nrf8001_next_deadline (m_radio);
+}
+
+static void m_aci_spi_transfer (hal_aci_data_t *data_to_send,
+    hal_aci_data_t *received_data)
+{
+  uint8_t max_bytes;
+
+  received_data->status_byte = 0;
+  if (m_replay ? !aci_replay_evt_get (m_replay, host_mcu_now (),
+        received_data->buffer) :
+      !nrf8001_evt_get (m_radio, received_data->buffer))
+  {
+    received_data->buffer[0] = 0;
+  }
+
+  /* Same transfer length as hal_aci_tl.c */
+  max_bytes = received_data->buffer[0];
+  if (data_to_send->buffer[0] && data_to_send->buffer[0] - 1 > max_bytes)
+  {
+    max_bytes = data_to_send->buffer[0] - 1;
+  }
+  if (max_bytes > HAL_ACI_MAX_LENGTH)
+  {
+    max_bytes = HAL_ACI_MAX_LENGTH;
+  }
+
+  perf_count (spi_transfers);
+  hal_aci_tl_host_stats.transfers++;
+  hal_aci_tl_host_stats.bytes += 2 + max_bytes;
+  host_mcu_advance ((2 + max_bytes) * HOST_SPI_BYTE_US);
+
+  if (data_to_send->buffer[0] && m_replay)
+  {
+    aci_replay_cmd_put (m_replay, data_to_send->buffer);
+  }
+  else if (data_to_send->buffer[0])
+  {
+    nrf8001_cmd_put (m_radio, data_to_send->buffer);
+  }
+
+  capture_spi (data_to_send->buffer, received_data->buffer);
+}
+
+static void m_aci_event_check (void)
+{
+  hal_aci_data_t data_to_send;
+  hal_aci_data_t received_data;
+
+  /* No room to store incoming messages */
+  if (aci_queue_is_full (&aci_rx_q))
+  {
+    hal_aci_tl_host_stats.rx_full++;
+    return;
+  }
+
+  m_radio_run ();
+
+  /* Nothing to exchange: wait for the radio */
+  if (!m_rdyn_low ())
+  {
+    const uint64_t before = host_mcu_now ();
+    uint64_t until = m_next_deadline ();
+
+    /* The main loop also wakes for the flash, see dfu_flash_poll() */
+    if (host_spm_busy () && host_spm_ready_us () < until)
+    {
+      until = host_spm_ready_us ();
+    }
+    /* And to send the live stream, see live_poll() */
+    if (live_pending () && host_uart_ready_us () < until)
+    {
+      until = host_uart_ready_us ();
+    }
+    host_mcu_idle_until (until);
+    hal_aci_tl_host_stats.idle_us += host_mcu_now () - before;
+
+    return;
+  }
+
+  if (!aci_queue_dequeue (&aci_tx_q, &data_to_send))
+  {
+    data_to_send.status_byte = 0;
+    data_to_send.buffer[0] = 0;
+  }
+
+  m_aci_spi_transfer (&data_to_send, &received_data);
+
+  if (received_data.buffer[0] > 0 && !lib_aci_event_fold (&received_data))
+  {
+    aci_queue_enqueue (&aci_rx_q, &received_data);
+  }
+}
+
+void hal_aci_tl_host_attach (nrf8001_t *radio, hal_aci_tl_host_poll_t poll,
+    void *ctx)
+{
+  m_radio = radio;
+  m_replay = NULL;
+  m_poll = poll;
+  m_poll_ctx = ctx;
+  memset (&hal_aci_tl_host_stats, 0, sizeof(hal_aci_tl_host_stats));
+}
+
+void hal_aci_tl_host_replay (aci_replay_t *replay)
+{
+  m_radio = NULL;
+  m_replay = replay;
+  m_poll = NULL;
+  m_poll_ctx = NULL;
+  memset (&hal_aci_tl_host_stats, 0, sizeof(hal_aci_tl_host_stats));
+}
+
+void hal_aci_tl_init (aci_pins_t *aci_pins)
+{
+  aci_queue_init (&aci_tx_q);
+  aci_queue_init (&aci_rx_q);
+}
+
+bool hal_aci_tl_send (hal_aci_data_t *p_aci_cmd)
+{
+  if (p_aci_cmd->buffer[0] > HAL_ACI_MAX_LENGTH)
+  {
+    return false;
+  }
+
+  if (!aci_queue_enqueue (&aci_tx_q, p_aci_cmd))
+  {
+    perf_count (tx_full);
+    return false;
+  }
+
+  return true;
+}
+
+uint8_t *hal_aci_tl_cmd_buffer (void)
+{
+  hal_aci_data_t *const slot = aci_queue_tail (&aci_tx_q);
+
+  if (slot == NULL)
+  {
+    perf_count (tx_full);
+    return NULL;
+  }
+
+  return &slot->buffer[0];
+}
+
+bool hal_aci_tl_cmd_commit (void)
+{
+  if (aci_queue_tail (&aci_tx_q)->buffer[0] > HAL_ACI_MAX_LENGTH)
+  {
+    return false;
+  }
+
+  aci_queue_commit (&aci_tx_q);
+  return true;
+}
+
+bool hal_aci_tl_event_get (hal_aci_data_t *p_aci_data)
+{
+  if (!aci_queue_is_full (&aci_rx_q))
+  {
+    m_aci_event_check ();
+  }
+  else
+  {
+    perf_count (rx_full);
+    live_stall ();
+  }
+
+  if (!aci_queue_dequeue (&aci_rx_q, p_aci_data))
+  {
+    return false;
+  }
+
+  perf_count (aci_events);
+
+  return true;
+}
+
+uint8_t hal_aci_tl_event_drain (void)
+{
+  uint8_t transfers = HAL_ACI_DRAIN_MAX;
+
+  if (aci_queue_is_full (&aci_rx_q))
+  {
+    perf_count (rx_full);
+    live_stall ();
+  }
+  else
+  {
+    do
+    {
+      m_aci_event_check ();
+    } while (--transfers && !aci_queue_is_full (&aci_rx_q) &&
+             hal_aci_tl_rdyn ());
+  }
+
+  return aci_queue_count (&aci_rx_q);
+}
+
+hal_aci_data_t *hal_aci_tl_event_peek (void)
+{
+  return aci_queue_head (&aci_rx_q);
+}
+
+void hal_aci_tl_event_release (void)
+{
+  aci_queue_release (&aci_rx_q);
+  perf_count (aci_events);
+}
+
+bool hal_aci_tl_rdyn (void)
+{
+  m_radio_run ();
+
+  return m_rdyn_low ();
+}
@@ -0,0 +1,73 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Host replacement for hal_aci_tl.c, talking to the nRF8001 model.
+ */
+
+/** @defgroup hal_aci_tl_host hal_aci_tl_host
+@{
+@ingroup host
+
+@brief ACI transport layer of the native host build
+@details Implements the hal_aci_tl.h interface with the same command and
+event queues as hal_aci_tl.c, but exchanges whole messages with the
+nRF8001 model instead of driving the SPI pins. A transfer still costs the
+SPI time of the bytes that would have been clocked. When the radio has
+nothing for the MCU, polling idles the virtual clock until the model's next
+scheduled activity, so a DFU session runs in milliseconds of host time.
+
+Instead of the model, the transport can also be fed from a capture made
+with ACI_CAPTURE (see aci_replay.h): the recorded events are handed to the
+MCU at the times they were recorded, and its commands are compared with the
+recorded ones.
+*/
+
+#ifndef HAL_ACI_TL_HOST_H__
+#define HAL_ACI_TL_HOST_H__
+
+#include <stdint.h>
+
+#include "aci_replay.h"
+#include "nrf8001.h"
+
+/* Called with the current time whenever the radio model is clocked */
+typedef void (*hal_aci_tl_host_poll_t)(void *ctx, uint64_t now_us);
+
+typedef struct
+{
+  uint32_t transfers;        /* SPI transactions */
+  uint32_t bytes;            /* Bytes clocked on the SPI bus */
+  uint32_t rx_full;          /* Polls skipped because the RX queue was full */
+  uint64_t idle_us;          /* Time spent waiting for the radio */
+} hal_aci_tl_host_stats_t;
+
+extern hal_aci_tl_host_stats_t hal_aci_tl_host_stats;
+
+/** @brief Connect the transport layer to a radio model. */
+void hal_aci_tl_host_attach(nrf8001_t *radio, hal_aci_tl_host_poll_t poll,
+    void *ctx);
+
+/** @brief Feed the transport layer from a capture instead of a radio model. */
+void hal_aci_tl_host_replay(aci_replay_t *replay);
+
+#endif /* HAL_ACI_TL_HOST_H__ */
+/** @} */
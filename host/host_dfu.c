@@ -0,0 +1,334 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the host DFU session.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <avr/eeprom.h>
+#include <util/delay.h>
+
+#include "../BLE/lib_aci.h"
+#include "../BLE/bonding.h"
+#include "../BLE/dfu.h"
+#include "../auth.h"
+#include "../ble.h"
+#include "../bootlog.h"
+#include "../capture.h"
+#include "../history.h"
+#include "../jump.h"
+#include "../live.h"
+#include "../perf.h"
+#include "../trace.h"
+
+#include "dfu_central.h"
+#include "dfu_link_model.h"
+#include "dfu_link_socket.h"
+#include "host_dfu.h"
+
+/* Layout of the bootloader configuration block, see ble.c */
+#define EE_BASE           (E2END - BOOTLOADER_EEPROM_SIZE)
+#define EE_VALID_APP      (EE_BASE + 0)
+#define EE_VALID_BLE      (EE_BASE + 1)
+#define EE_PINS           (EE_BASE + 2)
+#define EE_CREDITS        (EE_BASE + 14)
+#define EE_PIPES          (EE_BASE + 15)
+#define EE_CONN_TIMEOUT   (EE_BASE + 18)
+#define EE_CONN_INTERVAL  (EE_BASE + 20)
+
+/* Watchdog settings from optiboot.c */
+#define WATCHDOG_4S       (_BV(WDP3) | _BV(WDE))
+
+static const uint8_t m_pipes[3] = {8, 9, 10};
+
+/* Image authentication key, see auth.h */
+static const uint8_t m_auth_key[AUTH_KEY_SIZE] = {0x00, 0x01, 0x02, 0x03,
+  0x04, 0x05, 0x06, 0x07};
+
+static nrf8001_t     m_radio;
+static dfu_central_t m_central;
+static dfu_link_socket_device_t m_serve;
+static aci_replay_t  m_replay;
+static FILE         *m_capture;
+static FILE         *m_live;
+static bool          m_live_flush;
+
+/* Configuration block of an nRF8001 shield, as in tests/eeprom.hex */
+static void m_eeprom_config (uint8_t credits)
+{
+  const uint8_t pins[12] = {0, 9, 8, 11, 12, 13, 5, 4, 0xFF, 0xFF, 0, 1};
+
+  host_eeprom[EE_VALID_APP] = 0;
+  host_eeprom[EE_VALID_BLE] = 1;
+  memcpy (&host_eeprom[EE_PINS], pins, sizeof(pins));
+  host_eeprom[EE_CREDITS] = credits;
+  memcpy (&host_eeprom[EE_PIPES], m_pipes, sizeof(m_pipes));
+  host_eeprom[EE_CONN_TIMEOUT] = 180;
+  host_eeprom[EE_CONN_TIMEOUT + 1] = 0;
+  host_eeprom[EE_CONN_INTERVAL] = 0x50;
+  host_eeprom[EE_CONN_INTERVAL + 1] = 0;
+  memcpy (&host_eeprom[AUTH_KEY_EEPROM_ADDR], m_auth_key, AUTH_KEY_SIZE);
+}
+
+/* Tag the image the way a DFU_AUTH bootloader checks it */
+static void m_image_tag (const uint8_t *image, uint32_t size, uint8_t *tag)
+{
+  auth_mac_t mac;
+
+  auth_mac_init (&mac, m_auth_key);
+  while (size > 0)
+  {
+    const uint8_t len = size > 0xFF ? 0xFF : size;
+
+    auth_mac_update (&mac, image, len);
+    image += len;
+    size -= len;
+  }
+  auth_mac_final (&mac, tag);
+}
+
+static void m_central_poll (void *ctx, uint64_t now_us)
+{
+  dfu_central_run ((dfu_central_t *) ctx, now_us);
+}
+
+static void m_serve_poll (void *ctx, uint64_t now_us)
+{
+  dfu_link_socket_device_turn ((dfu_link_socket_device_t *) ctx, now_us);
+}
+
+/* putch() in optiboot.c */
+void capture_out (uint8_t byte)
+{
+  if (m_capture)
+  {
+    fputc (byte, m_capture);
+  }
+}
+
+/* live_uart_ready() in optiboot.c */
+uint8_t live_uart_ready (void)
+{
+  return m_live_flush || host_uart_ready ();
+}
+
+void live_uart_put (uint8_t byte)
+{
+  host_uart_put (byte);
+  if (m_live)
+  {
+    fputc (byte, m_live);
+  }
+}
+
+/* Mirrors the BLE path of main() in optiboot.c */
+static void m_boot_main (void *ctx)
+{
+  memset (&aci_state, 0, sizeof(aci_state));
+  dfu_mode = 0;
+
+  /* jump_check() */
+  bootlog_init ();
+
+  /* Timer 1 for the trace timestamps */
+  TCCR1B = _BV(CS12) | _BV(CS10);
+
+  host_wdtcsr = WATCHDOG_4S;
+  host_wdt_reset ();
+  bootlog_wdt (WATCHDOG_4S);
+  bootlog_stamp (BOOT_UART_INIT);
+
+  perf_init ();
+  trace_init ();
+  history_init ();
+  capture_init ();
+  live_init ();
+
+  if (!ble_init ())
+  {
+    for (;;)
+    {
+      host_mcu_idle_until (UINT64_MAX);
+    }
+  }
+
+  jump_boot_key_set ();
+
+  for (;;)
+  {
+    ble_update ();
+  }
+}
+
+void host_dfu_opts_default (host_dfu_opts_t *opts)
+{
+  memset (opts, 0, sizeof(*opts));
+  nrf8001_config_default (&opts->radio);
+  opts->limit_us = 120 * 1000000ULL;
+}
+
+int host_dfu_run (const host_dfu_opts_t *opts, host_dfu_result_t *result)
+{
+  int reason;
+
+  memset (result, 0, sizeof(*result));
+
+  host_mcu_init ();
+  m_eeprom_config (opts->radio.credits);
+
+  nrf8001_init (&m_radio, &opts->radio);
+  dfu_central_init (&m_central, opts->image, opts->image_size, m_pipes,
+      opts->prn);
+  dfu_link_model (&m_central, &m_radio);
+  m_central.read_perf = opts->read_perf;
+  m_image_tag (opts->image, opts->image_size, m_central.tag);
+  if (opts->bad_tag)
+  {
+    m_central.tag[0] ^= 0x01;
+  }
+  m_central.reset_at = opts->reset_at;
+  if (opts->skip_start)
+  {
+    m_central.skip_start = true;
+    host_eeprom[EE_VALID_APP] = 1;
+  }
+  if (opts->capture && (m_capture = fopen (opts->capture, "wb")) == NULL)
+  {
+    return 1;
+  }
+  if (opts->live && (m_live = fopen (opts->live, "wb")) == NULL)
+  {
+    return 1;
+  }
+  m_live_flush = false;
+  if (opts->replay)
+  {
+    if (aci_replay_load (&m_replay, opts->replay) != 0)
+    {
+      return 1;
+    }
+    hal_aci_tl_host_replay (&m_replay);
+  }
+  else if (opts->serve)
+  {
+    /* The central is in another process, see dfu_link_socket.h */
+    if (dfu_link_socket_serve (&m_serve, &m_radio, m_pipes, opts->serve) != 0)
+    {
+      return 1;
+    }
+    hal_aci_tl_host_attach (&m_radio, m_serve_poll, &m_serve);
+  }
+  else
+  {
+    hal_aci_tl_host_attach (&m_radio, m_central_poll, &m_central);
+  }
+
+  reason = host_mcu_run (m_boot_main, NULL, opts->limit_us);
+
+  /* jump_check() starts the application on a watchdog reset with the boot
+   * key set and a valid application flagged in EEPROM
+   */
+  result->app_started = reason == HOST_MCU_WDT_RESET &&
+    (host_mcusr & _BV(WDRF)) && boot_key == BOOTLOADER_KEY &&
+    host_eeprom[EE_VALID_APP] == 1;
+  if (result->app_started)
+  {
+    bootlog_app ();
+  }
+
+  if (opts->serve)
+  {
+    dfu_link_socket_device_close (&m_serve);
+  }
+  if (m_capture)
+  {
+    fclose (m_capture);
+    m_capture = NULL;
+  }
+  if (m_live)
+  {
+    /* The watchdog exit leaves 16 ms to send the rest, see dfu.c */
+    m_live_flush = result->app_started;
+    live_poll ();
+    fclose (m_live);
+    m_live = NULL;
+  }
+  if (opts->replay)
+  {
+    result->replay = m_replay.stats;
+    result->replay_duration_us = m_replay.duration_us;
+    aci_replay_free (&m_replay);
+  }
+
+  /* A remote or replayed central reports its own progress */
+  result->done = opts->serve || opts->replay ? result->app_started :
+    m_central.state == DFU_CENTRAL_DONE;
+  result->verified = opts->image_size <= sizeof(host_flash) &&
+    memcmp (host_flash, opts->image, opts->image_size) == 0;
+  result->central_state = m_central.state;
+  memcpy (result->last_rsp, m_central.last_rsp, sizeof(result->last_rsp));
+
+  result->t_connected = m_central.t_connected;
+  result->t_fw_start = m_central.t_fw_start;
+  result->t_fw_done = m_central.t_fw_done;
+  result->t_done = m_central.t_done;
+  result->t_end = host_mcu_now ();
+  result->packets = m_central.packets;
+  result->prn_received = m_central.prn_received;
+  result->resets = m_central.resets;
+  result->stall_us = m_central.stall_us;
+  memcpy (result->perf, m_central.perf, m_central.perf_len);
+  result->perf_len = m_central.perf_len;
+
+  result->radio = m_radio.stats;
+  result->mcu = host_mcu_stats;
+  result->hal = hal_aci_tl_host_stats;
+
+  if (opts->skip_start)
+  {
+    result->refused = result->last_rsp[0] == OP_CODE_RESPONSE &&
+      result->last_rsp[1] == BLE_DFU_RECEIVE_APP_PROCEDURE &&
+      result->last_rsp[2] == BLE_DFU_RESP_VAL_INVALID_STATE &&
+      result->mcu.page_erases == 0 && result->mcu.page_writes == 0 &&
+      host_eeprom[EE_VALID_APP] == 1;
+
+    return result->refused ? 0 : 1;
+  }
+  if (opts->bad_tag)
+  {
+    result->rejected = result->last_rsp[0] == OP_CODE_RESPONSE &&
+      result->last_rsp[1] == BLE_DFU_VALIDATE_PROCEDURE &&
+      result->last_rsp[2] == BLE_DFU_RESP_VAL_CRC_ERROR &&
+      !result->app_started && host_eeprom[EE_VALID_APP] != 1;
+
+    return result->rejected ? 0 : 1;
+  }
+
+  if (opts->reset_at && (result->resets != 1 || result->mcu.spm_errors != 0))
+  {
+    return 1;
+  }
+
+  return (result->done && result->app_started && result->verified) ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief A complete BLE DFU session in the native host build.
+ */
+
+/** @defgroup host_dfu host_dfu
+@{
+@ingroup host
+
+@brief Runs the bootloader's BLE path against the nRF8001 model
+@details The BLE modules (ble.c, lib_aci.c, aci_queue.c, dfu.c, bonding.c
+and jump.c) are linked unmodified, including the ACI event loop of ble.c
+that the bootloader runs. Only the start of main() is mirrored in
+host_dfu.c, since optiboot.c itself cannot be compiled for the host. The
+session ends when the watchdog resets the emulated MCU into the new
+application, or fails on any other reset or when the time limit is
+reached.
+
+With opts.replay the radio model and the central are left out and the
+session is driven by the events of a capture; it is done when the
+bootloader starts the application.
+
+The static data of the BLE modules is not cleared by an emulated reset, so
+host_dfu_run() should be called once per process.
+*/
+
+#ifndef HOST_DFU_H__
+#define HOST_DFU_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf8001.h"
+#include "dfu_central.h"
+#include "aci_replay.h"
+#include "host_mcu.h"
+#include "hal_aci_tl_host.h"
+
+typedef struct
+{
+  const uint8_t   *image;
+  uint32_t         image_size;
+  nrf8001_config_t radio;
+  uint16_t         prn;        /* Packets per receipt notification, 0 for none */
+  uint64_t         limit_us;   /* Give up after this much virtual time */
+  bool             read_perf;  /* Read the counters over the control point */
+  bool             bad_tag;    /* Send a tag that does not match the image */
+  bool             skip_start; /* Send Receive Firmware from idle, with an
+                                  application already installed */
+  uint32_t         reset_at;   /* Send System Reset after this many image
+                                  bytes, then update again; 0 for never */
+  const char      *serve;      /* Socket for a central in another process,
+                                  NULL to run dfu_central here */
+  const char      *capture;    /* Record the ACI transfers to this file */
+  const char      *replay;     /* Take the events from this capture instead
+                                  of the radio model, see aci_replay.h */
+  const char      *live;       /* Write the LIVE_TRACE stream to this file */
+} host_dfu_opts_t;
+
+typedef struct
+{
+  bool     done;               /* The central completed the procedure */
+  bool     app_started;        /* The bootloader reset into the application */
+  bool     verified;           /* Flash matches the image */
+  uint8_t  central_state;      /* DFU_CENTRAL_* */
+  uint8_t  last_rsp[3];        /* Last response on the control point */
+  bool     refused;            /* With skip_start: Receive Firmware was
+                                  refused and the flash left alone */
+  bool     rejected;           /* With bad_tag: validation failed and the
+                                  application was not started */
+
+  /* Virtual time, in microseconds */
+  uint64_t t_connected;
+  uint64_t t_fw_start;
+  uint64_t t_fw_done;
+  uint64_t t_done;
+  uint64_t t_end;
+
+  uint32_t packets;
+  uint32_t prn_received;
+  uint8_t  resets;             /* System Resets sent by the central */
+  uint64_t stall_us;
+
+  /* Counters block as read by the central, see perf.h */
+  uint8_t  perf[DFU_CENTRAL_PERF_MAX];
+  uint8_t  perf_len;
+
+  nrf8001_stats_t         radio;
+  host_mcu_stats_t        mcu;
+  hal_aci_tl_host_stats_t hal;
+  aci_replay_stats_t      replay;
+  uint64_t                replay_duration_us;
+} host_dfu_result_t;
+
+/** @brief Default options: no image, default radio, two minute limit. */
+void host_dfu_opts_default(host_dfu_opts_t *opts);
+
+/** @brief Program opts->image over BLE.
+ *  @return 0 if the application was started from a verified flash, after
+ *  a System Reset with opts->reset_at and without SPM errors, or
+ *  with opts->skip_start, if the bootloader refused the image, and with
+ *  opts->bad_tag, if it rejected the image at validation.
+ */
+int host_dfu_run(const host_dfu_opts_t *opts, host_dfu_result_t *result);
+
+#endif /* HOST_DFU_H__ */
+/** @} */
@@ -0,0 +1,461 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the emulated ATmega resources.
+ */
+
+#include <setjmp.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <avr/eeprom.h>
+
+#include "host_mcu.h"
+
+/* EEPROM programming time, tWD_EEPROM in the datasheet */
+#define EEPROM_WRITE_US   3400
+
+/* Wall clock period of the check for code spinning outside the emulation */
+#define SPIN_CHECK_MS     100
+
+uint8_t host_flash[FLASHEND + 1];
+uint8_t host_eeprom[E2END + 1];
+volatile uint8_t host_wdtcsr;
+volatile uint8_t host_mcusr;
+volatile uint8_t host_tccr1b;
+host_mcu_stats_t host_mcu_stats;
+
+static uint64_t m_now_us;
+static uint64_t m_limit_us;
+static uint64_t m_wdt_last_us;
+static uint64_t m_spm_ready_us;
+static uint64_t m_eeprom_ready_us;
+static uint64_t m_uart_idle_us;   /* When the last byte is shifted out */
+
+/* SPM temporary page buffer, and which words of it have been loaded */
+static uint8_t  m_temp[SPM_PAGESIZE];
+static uint8_t  m_temp_loaded[SPM_PAGESIZE / 2];
+static uint8_t  m_temp_words;
+
+static sigjmp_buf            m_reset;
+static volatile sig_atomic_t m_running;
+static uint64_t              m_spin_now_us;
+
+/*****************************************************************************
+* Clock and watchdog
+*****************************************************************************/
+
+/* Time at which the watchdog fires, UINT64_MAX if it is stopped */
+static uint64_t m_wdt_expiry (void)
+{
+  const uint8_t wdp = (host_wdtcsr & 0x07) |
+    ((host_wdtcsr & _BV(WDP3)) ? 0x08 : 0);
+
+  if (!(host_wdtcsr & _BV(WDE)))
+  {
+    return UINT64_MAX;
+  }
+
+  return m_wdt_last_us + (16000ULL << (wdp > 9 ? 9 : wdp));
+}
+
+static void m_temp_clear (void)
+{
+  memset (m_temp, 0xFF, sizeof(m_temp));
+  memset (m_temp_loaded, 0, sizeof(m_temp_loaded));
+  m_temp_words = 0;
+}
+
+static void m_reset_jump (int reason)
+{
+  if (reason == HOST_MCU_WDT_RESET)
+  {
+    host_mcu_stats.wdt_resets++;
+    host_mcusr |= _BV(WDRF);
+  }
+
+  /* The temporary page buffer does not survive a reset */
+  m_temp_clear ();
+
+  m_running = 0;
+  siglongjmp (m_reset, reason);
+}
+
+/* Code that spins without calling into the emulation never lets time pass.
+ * Only the watchdog can end such a loop.
+ */
+static void m_spin_check (int sig)
+{
+  if (!m_running)
+  {
+    return;
+  }
+
+  if (m_now_us != m_spin_now_us)
+  {
+    m_spin_now_us = m_now_us;
+    return;
+  }
+
+  if (m_wdt_expiry () < m_limit_us)
+  {
+    m_now_us = m_wdt_expiry ();
+    m_reset_jump (HOST_MCU_WDT_RESET);
+  }
+
+  m_now_us = m_limit_us;
+  m_reset_jump (HOST_MCU_TIMEOUT);
+}
+
+void host_mcu_init (void)
+{
+  memset (host_flash, 0xFF, sizeof(host_flash));
+  memset (host_eeprom, 0xFF, sizeof(host_eeprom));
+  memset (&host_mcu_stats, 0, sizeof(host_mcu_stats));
+
+  host_wdtcsr = 0;
+  host_mcusr = _BV(PORF);
+  host_tccr1b = 0;
+
+  m_now_us = 0;
+  m_wdt_last_us = 0;
+  m_spm_ready_us = 0;
+  m_eeprom_ready_us = 0;
+  m_uart_idle_us = 0;
+  m_temp_clear ();
+}
+
+uint64_t host_mcu_now (void)
+{
+  return m_now_us;
+}
+
+void host_mcu_advance (uint64_t us)
+{
+  const uint64_t target = (us > UINT64_MAX - m_now_us) ? UINT64_MAX :
+    m_now_us + us;
+  const uint64_t expiry = m_wdt_expiry ();
+
+  if (!m_running)
+  {
+    m_now_us = target;
+    return;
+  }
+
+  if (expiry <= target && expiry <= m_limit_us)
+  {
+    m_now_us = expiry > m_now_us ? expiry : m_now_us;
+    m_reset_jump (HOST_MCU_WDT_RESET);
+  }
+
+  if (m_limit_us <= target)
+  {
+    m_now_us = m_limit_us;
+    m_reset_jump (HOST_MCU_TIMEOUT);
+  }
+
+  m_now_us = target;
+}
+
+void host_mcu_idle_until (uint64_t when_us)
+{
+  if (when_us > m_now_us)
+  {
+    host_mcu_advance (when_us - m_now_us);
+  }
+}
+
+int host_mcu_run (void (*entry)(void *ctx), void *ctx, uint64_t limit_us)
+{
+  const struct itimerval on = {
+    {0, SPIN_CHECK_MS * 1000}, {0, SPIN_CHECK_MS * 1000}
+  };
+  const struct itimerval off = {{0, 0}, {0, 0}};
+  struct sigaction sa;
+  int reason;
+
+  memset (&sa, 0, sizeof(sa));
+  sa.sa_handler = m_spin_check;
+  sigaction (SIGALRM, &sa, NULL);
+
+  m_limit_us = limit_us;
+
+  reason = sigsetjmp (m_reset, 1);
+  if (reason == 0)
+  {
+    m_spin_now_us = m_now_us;
+    m_running = 1;
+    setitimer (ITIMER_REAL, &on, NULL);
+
+    entry (ctx);
+
+    m_running = 0;
+    reason = HOST_MCU_RETURNED;
+  }
+
+  setitimer (ITIMER_REAL, &off, NULL);
+
+  return reason;
+}
+
+/* Timer1 counts only with the F_CPU/1024 prescaler used by optiboot, at
+ * 64 us per count for a 16 MHz part
+ */
+uint16_t host_tcnt1 (void)
+{
+  if ((host_tccr1b & (_BV(CS12) | _BV(CS11) | _BV(CS10))) !=
+      (_BV(CS12) | _BV(CS10)))
+  {
+    return 0;
+  }
+
+  return (uint16_t) (m_now_us / 64);
+}
+
+void host_wdt_reset (void)
+{
+  m_wdt_last_us = m_now_us;
+}
+
+/*****************************************************************************
+* Self-programming
+*****************************************************************************/
+
+/* SPM instructions issued while an erase or write is running are ignored */
+static bool m_spm_check (void)
+{
+  if (host_spm_busy ())
+  {
+    host_mcu_stats.spm_errors++;
+    return false;
+  }
+
+  return true;
+}
+
+void host_spm_page_erase (uint32_t addr)
+{
+  const uint32_t page = addr & ~(uint32_t)(SPM_PAGESIZE - 1);
+
+  if (!m_spm_check () || page > FLASHEND)
+  {
+    return;
+  }
+
+  memset (&host_flash[page], 0xFF, SPM_PAGESIZE);
+  m_spm_ready_us = m_now_us + HOST_FLASH_OP_US;
+  host_mcu_stats.page_erases++;
+}
+
+void host_spm_page_fill (uint32_t addr, uint16_t data)
+{
+  const uint16_t word = (addr & (SPM_PAGESIZE - 1)) >> 1;
+
+  if (!m_spm_check ())
+  {
+    return;
+  }
+
+  /* Each word of the temporary buffer can only be loaded once */
+  if (m_temp_loaded[word])
+  {
+    host_mcu_stats.spm_errors++;
+    return;
+  }
+
+  m_temp[word * 2] = (uint8_t) data;
+  m_temp[word * 2 + 1] = (uint8_t) (data >> 8);
+  m_temp_loaded[word] = 1;
+  m_temp_words++;
+  host_mcu_stats.page_fills++;
+}
+
+void host_spm_page_write (uint32_t addr)
+{
+  const uint32_t page = addr & ~(uint32_t)(SPM_PAGESIZE - 1);
+  uint16_t i;
+
+  if (!m_spm_check () || page > FLASHEND)
+  {
+    return;
+  }
+
+  /* Programming can only clear bits */
+  for (i = 0; i < SPM_PAGESIZE; i++)
+  {
+    host_flash[page + i] &= m_temp[i];
+  }
+
+  m_temp_clear ();
+  m_spm_ready_us = m_now_us + HOST_FLASH_OP_US;
+  host_mcu_stats.page_writes++;
+}
+
+void host_spm_rww_enable (void)
+{
+  if (m_spm_check ())
+  {
+    m_temp_clear ();
+  }
+}
+
+bool host_spm_busy (void)
+{
+  return m_now_us < m_spm_ready_us;
+}
+
+uint64_t host_spm_ready_us (void)
+{
+  return m_spm_ready_us;
+}
+
+uint32_t host_spm_busy_wait (void)
+{
+  if (host_spm_busy ())
+  {
+    const uint64_t wait = m_spm_ready_us - m_now_us;
+
+    host_mcu_stats.busy_wait_us += wait;
+    host_mcu_advance (wait);
+
+    return (uint32_t) (wait * HOST_SPM_POLLS_PER_US);
+  }
+
+  return 0;
+}
+
+/*****************************************************************************
+* USART
+*****************************************************************************/
+
+uint64_t host_uart_ready_us (void)
+{
+  /* The data register empties when the byte before it starts shifting */
+  return m_uart_idle_us > HOST_UART_BYTE_US ?
+    m_uart_idle_us - HOST_UART_BYTE_US : 0;
+}
+
+bool host_uart_ready (void)
+{
+  return m_now_us >= host_uart_ready_us ();
+}
+
+void host_uart_put (uint8_t byte)
+{
+  m_uart_idle_us = (m_uart_idle_us > m_now_us ? m_uart_idle_us : m_now_us) +
+    HOST_UART_BYTE_US;
+  host_mcu_stats.uart_bytes++;
+}
+
+/*****************************************************************************
+* EEPROM
+*****************************************************************************/
+
+static void m_eeprom_busy_wait (void)
+{
+  host_mcu_idle_until (m_eeprom_ready_us);
+}
+
+uint8_t eeprom_read_byte (const uint8_t *addr)
+{
+  m_eeprom_busy_wait ();
+
+  return host_eeprom[(uintptr_t) addr & E2END];
+}
+
+uint16_t eeprom_read_word (const uint16_t *addr)
+{
+  uint16_t value;
+
+  eeprom_read_block (&value, addr, sizeof(value));
+
+  return value;
+}
+
+void eeprom_read_block (void *dst, const void *src, size_t n)
+{
+  uint8_t *d = (uint8_t *) dst;
+  uintptr_t a = (uintptr_t) src;
+
+  while (n--)
+  {
+    *d++ = eeprom_read_byte ((const uint8_t *) a++);
+  }
+}
+
+void eeprom_write_byte (uint8_t *addr, uint8_t value)
+{
+  m_eeprom_busy_wait ();
+
+  /* Not allowed while the flash is busy */
+  if (host_spm_busy ())
+  {
+    host_mcu_stats.spm_errors++;
+  }
+
+  /* An EEPROM write in the middle of a page load loses the loaded data */
+  if (m_temp_words)
+  {
+    host_mcu_stats.temp_lost++;
+    m_temp_clear ();
+  }
+
+  host_eeprom[(uintptr_t) addr & E2END] = value;
+  m_eeprom_ready_us = m_now_us + EEPROM_WRITE_US;
+  host_mcu_stats.eeprom_writes++;
+}
+
+void eeprom_write_word (uint16_t *addr, uint16_t value)
+{
+  eeprom_write_block (&value, addr, sizeof(value));
+}
+
+void eeprom_write_block (const void *src, void *dst, size_t n)
+{
+  const uint8_t *s = (const uint8_t *) src;
+  uintptr_t a = (uintptr_t) dst;
+
+  while (n--)
+  {
+    eeprom_write_byte ((uint8_t *) a++, *s++);
+  }
+}
+
+void eeprom_update_byte (uint8_t *addr, uint8_t value)
+{
+  if (eeprom_read_byte (addr) != value)
+  {
+    eeprom_write_byte (addr, value);
+  }
+}
+
+void eeprom_update_block (const void *src, void *dst, size_t n)
+{
+  const uint8_t *s = (const uint8_t *) src;
+  uintptr_t a = (uintptr_t) dst;
+
+  while (n--)
+  {
+    eeprom_update_byte ((uint8_t *) a++, *s++);
+  }
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Emulated ATmega resources for the native host build.
+ */
+
+/** @defgroup host_mcu host_mcu
+@{
+@ingroup host
+
+@brief Flash, EEPROM, watchdog and a virtual clock for the native build
+@details The BLE modules are compiled for the development machine against
+the headers in host/include, which route AVR specifics here. Flash is RAM
+backed and follows the SPM rules: a temporary page buffer filled one word at
+a time, page erase and page write operations that keep the flash busy for
+HOST_FLASH_OP_US, and a lost temporary buffer if EEPROM is written while it
+is loaded. Misuse is counted in spm_errors rather than silently accepted.
+
+Time only passes when the emulated code waits: in a delay, in a flash busy
+wait, in an SPI transfer or while idle waiting for the radio. The watchdog is
+evaluated against this clock; when it expires, control returns to the
+host_mcu_run() caller as if the MCU had reset. Code that spins without ever
+calling into the emulation (while (1); after arming the watchdog) is caught
+by a wall clock alarm and treated the same way.
+*/
+
+#ifndef HOST_MCU_H__
+#define HOST_MCU_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+/* Duration of a page erase or page write, tWD_FLASH in the datasheet */
+#ifndef HOST_FLASH_OP_US
+#define HOST_FLASH_OP_US      4000
+#endif
+
+/* One SPI byte at F_CPU/8, as configured by hal_aci_tl.c */
+#ifndef HOST_SPI_BYTE_US
+#define HOST_SPI_BYTE_US      4
+#endif
+
+/* Polls of SPMCSR per microsecond of busy wait, for perf_spm_busy_wait() */
+#ifndef HOST_SPM_POLLS_PER_US
+#define HOST_SPM_POLLS_PER_US 2
+#endif
+
+/* USART speed, for the transmitter used by live.c */
+#ifndef HOST_UART_BAUD
+#define HOST_UART_BAUD        115200
+#endif
+#define HOST_UART_BYTE_US     (10 * 1000000ULL / HOST_UART_BAUD)
+
+/* Reasons for host_mcu_run() to return */
+#define HOST_MCU_RETURNED     0   /* The entry function returned */
+#define HOST_MCU_WDT_RESET    1   /* The watchdog expired */
+#define HOST_MCU_TIMEOUT      2   /* The time limit was reached */
+
+typedef struct
+{
+  uint32_t page_erases;
+  uint32_t page_writes;
+  uint32_t page_fills;       /* Words loaded into the temporary buffer */
+  uint32_t spm_errors;       /* SPM used while busy, a word loaded twice, or
+                                the EEPROM written during an erase or write */
+  uint32_t temp_lost;        /* Temporary buffer lost to an EEPROM write */
+  uint64_t busy_wait_us;     /* Time spent in boot_spm_busy_wait() */
+  uint32_t eeprom_writes;
+  uint32_t wdt_resets;       /* Watchdog expiries */
+  uint32_t uart_bytes;       /* Written to the USART data register */
+} host_mcu_stats_t;
+
+extern uint8_t host_flash[FLASHEND + 1];
+extern uint8_t host_eeprom[E2END + 1];
+extern volatile uint8_t host_wdtcsr;
+extern volatile uint8_t host_mcusr;
+extern host_mcu_stats_t host_mcu_stats;
+
+/** @brief Power-on state: erased memories, clock at zero, watchdog off. */
+void host_mcu_init(void);
+
+/** @brief Current virtual time, in microseconds. */
+uint64_t host_mcu_now(void);
+
+/** @brief Let time pass, resetting the MCU if the watchdog expires. */
+void host_mcu_advance(uint64_t us);
+
+/** @brief Sleep until the given time, or until the watchdog expires. */
+void host_mcu_idle_until(uint64_t when_us);
+
+/** @brief Run entry(ctx) as the MCU, until it returns or resets.
+ *  @param limit_us Virtual time at which to give up.
+ *  @return One of HOST_MCU_*.
+ */
+int host_mcu_run(void (*entry)(void *ctx), void *ctx, uint64_t limit_us);
+
+/** @brief Execute a wdr instruction. */
+void host_wdt_reset(void);
+
+/** @name Self-programming, see boot_host.h */
+/* @{ */
+void host_spm_page_erase(uint32_t addr);
+void host_spm_page_fill(uint32_t addr, uint16_t data);
+void host_spm_page_write(uint32_t addr);
+void host_spm_rww_enable(void);
+bool host_spm_busy(void);
+/** @return Virtual time at which the flash is ready again. */
+uint64_t host_spm_ready_us(void);
+/** @return Number of SPMCSR polls the wait would have taken. */
+uint32_t host_spm_busy_wait(void);
+/* @} */
+
+/** @name USART transmitter: a data register and a shift register */
+/* @{ */
+/** @brief True when the data register is empty, UDRE. */
+bool host_uart_ready(void);
+/** @return Virtual time at which the data register is empty again. */
+uint64_t host_uart_ready_us(void);
+/** @brief Write the data register; call only when it is empty. */
+void host_uart_put(uint8_t byte);
+/* @} */
+
+#endif /* HOST_MCU_H__ */
+/** @} */
@@ -0,0 +1,273 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Run a BLE DFU through the bootloader's BLE modules compiled for the
+  host, and report the session as JSON.
+
+  Usage: hostboot [options] <application.hex>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../bootlog.h"
+#include "../history.h"
+#include "../perf.h"
+#include "../trace.h"
+
+#include "ihex.h"
+#include "dfu_central.h"
+#include "host_dfu.h"
+
+static const char *m_usage =
+  "Usage: hostboot [options] <application.hex>\n"
+  "  -c <interval>  connection interval, 1.25 ms units (6)\n"
+  "  -n <prn>       packets per receipt notification, 0 for none (0)\n"
+  "  -k <credits>   nRF8001 data credits (2)\n"
+  "  -p <pkts>      central writes per connection event (4)\n"
+  "  -t <seconds>   virtual time limit (120)\n"
+  "  -a             send an image tag that does not match the image\n"
+  "  -F             send Receive Firmware before Start DFU, over an installed\n"
+  "                 application, and check that the bootloader refuses it\n"
+  "  -A <bytes>     send System Reset after this many image bytes, then\n"
+  "                 update again, and check the flash was left consistent\n"
+  "  -w             start with the nRF8001 already in Standby, not powering up\n"
+  "  -P             read the bootloader counters over the control point\n"
+  "  -T             dump the trace ring, oldest record first\n"
+  "  -H             print the session history left in EEPROM\n"
+  "  -B             print the boot stage timestamps, in microseconds\n"
+  "  -S <socket>    wait for a central on a Unix socket instead of running one,\n"
+  "                 such as dfuclient -s <socket>\n"
+  "  -C <file>      record the ACI transfers to a capture file\n"
+  "  -R <file>      replay the events of a capture instead of the radio and\n"
+  "                 the central; the application is what to verify against\n"
+  "  -L <file>      write the live progress stream, see host/livewatch.py\n";
+
+int main (int argc, char **argv)
+{
+  host_dfu_opts_t opts;
+  host_dfu_result_t r;
+  ihex_image_t app;
+  double fw_s;
+  bool dump_trace = false;
+  bool dump_history = false;
+  bool dump_bootlog = false;
+  int status;
+  int opt;
+
+  host_dfu_opts_default (&opts);
+
+  while ((opt = getopt (argc, argv, "c:n:k:p:t:aFA:wPTHBS:C:R:L:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'c': opts.radio.conn_interval = strtoul (optarg, NULL, 0); break;
+      case 'n': opts.prn = strtoul (optarg, NULL, 0); break;
+      case 'k': opts.radio.credits = strtoul (optarg, NULL, 0); break;
+      case 'p': opts.radio.pkts_per_event = strtoul (optarg, NULL, 0); break;
+      case 't': opts.limit_us = strtoull (optarg, NULL, 0) * 1000000ULL; break;
+      case 'a': opts.bad_tag = true; break;
+      case 'F': opts.skip_start = true; break;
+      case 'A': opts.reset_at = strtoul (optarg, NULL, 0); break;
+      case 'w': opts.radio.boot_state = NRF8001_BOOT_STANDBY; break;
+      case 'P': opts.read_perf = true; break;
+      case 'T': dump_trace = true; break;
+      case 'H': dump_history = true; break;
+      case 'B': dump_bootlog = true; break;
+      case 'S': opts.serve = optarg; break;
+      case 'C': opts.capture = optarg; break;
+      case 'R': opts.replay = optarg; break;
+      case 'L': opts.live = optarg; break;
+      default:
+        fputs (m_usage, stderr);
+        return opt == 'h' ? 0 : 2;
+    }
+  }
+
+  if (argc - optind != 1)
+  {
+    fputs (m_usage, stderr);
+    return 2;
+  }
+
+  if (ihex_load (argv[optind], &app) != 0 || app.base != 0)
+  {
+    fprintf (stderr, "hostboot: cannot load application %s\n", argv[optind]);
+    return 1;
+  }
+
+  opts.image = app.data;
+  opts.image_size = app.size;
+
+  status = host_dfu_run (&opts, &r);
+  fw_s = (r.t_fw_done - r.t_fw_start) / 1e6;
+
+  printf ("{\n");
+  printf ("  \"image_size\": %u,\n", app.size);
+  printf ("  \"conn_interval\": %u,\n", opts.radio.conn_interval);
+  printf ("  \"pkts_per_event\": %u,\n", opts.radio.pkts_per_event);
+  printf ("  \"prn\": %u,\n", opts.prn);
+  printf ("  \"credits\": %u,\n", opts.radio.credits);
+  printf ("  \"sim_time_us\": %llu,\n", (unsigned long long) r.t_end);
+  printf ("  \"t_connected_us\": %llu,\n", (unsigned long long) r.t_connected);
+  printf ("  \"t_fw_start_us\": %llu,\n", (unsigned long long) r.t_fw_start);
+  printf ("  \"t_fw_done_us\": %llu,\n", (unsigned long long) r.t_fw_done);
+  printf ("  \"t_done_us\": %llu,\n", (unsigned long long) r.t_done);
+  printf ("  \"throughput_bps\": %.1f,\n", fw_s > 0 ? app.size / fw_s : 0.0);
+  printf ("  \"packets\": %u,\n", r.packets);
+  printf ("  \"prn_received\": %u,\n", r.prn_received);
+  printf ("  \"stall_us\": %llu,\n", (unsigned long long) r.stall_us);
+  printf ("  \"aci_events\": %u,\n", r.radio.events);
+  printf ("  \"aci_commands\": %u,\n", r.radio.commands);
+  printf ("  \"conn_events\": %u,\n", r.radio.conn_events);
+  printf ("  \"write_stalls\": %u,\n", r.radio.write_stalls);
+  printf ("  \"credit_errors\": %u,\n", r.radio.credit_errors);
+  printf ("  \"spi_transfers\": %u,\n", r.hal.transfers);
+  printf ("  \"spi_bytes\": %u,\n", r.hal.bytes);
+  printf ("  \"idle_us\": %llu,\n", (unsigned long long) r.hal.idle_us);
+  printf ("  \"page_erases\": %u,\n", r.mcu.page_erases);
+  printf ("  \"page_writes\": %u,\n", r.mcu.page_writes);
+  printf ("  \"spm_busy_wait_us\": %llu,\n",
+      (unsigned long long) r.mcu.busy_wait_us);
+  printf ("  \"spm_errors\": %u,\n", r.mcu.spm_errors);
+  printf ("  \"eeprom_writes\": %u,\n", r.mcu.eeprom_writes);
+  printf ("  \"wdt_resets\": %u,\n", r.mcu.wdt_resets);
+  printf ("  \"uart_bytes\": %u,\n", r.mcu.uart_bytes);
+  if (r.perf_len == sizeof(perf_counters_t))
+  {
+    perf_counters_t pc;
+
+    memcpy (&pc, r.perf, sizeof(pc));
+    printf ("  \"perf_counters\": {\n");
+    printf ("    \"aci_events\": %u,\n", pc.aci_events);
+    printf ("    \"spi_transfers\": %u,\n", pc.spi_transfers);
+    printf ("    \"rx_full\": %u,\n", pc.rx_full);
+    printf ("    \"tx_full\": %u,\n", pc.tx_full);
+    printf ("    \"zero_credit\": %u,\n", pc.zero_credit);
+    printf ("    \"pages_erased\": %u,\n", pc.pages_erased);
+    printf ("    \"pages_written\": %u,\n", pc.pages_written);
+    printf ("    \"pipe_errors\": %u,\n", pc.pipe_errors);
+    printf ("    \"spm_wait\": %u,\n", pc.spm_wait);
+    printf ("    \"aci_folded\": %u\n", pc.aci_folded);
+    printf ("  },\n");
+  }
+  if (dump_trace && trace_ring.magic == TRACE_MAGIC)
+  {
+    unsigned i, n = 0;
+
+    printf ("  \"trace_sessions\": %u,\n", trace_ring.sessions);
+    printf ("  \"trace\": [");
+    for (i = 0; i < TRACE_SIZE; i++)
+    {
+      const trace_record_t *rec =
+        &trace_ring.rec[(trace_ring.head + i) & (TRACE_SIZE - 1)];
+
+      /* Not yet written since the ring was cleared */
+      if (rec->type == 0)
+      {
+        continue;
+      }
+      printf ("%s\n    [%u, %u, %u]", n++ ? "," : "", rec->time, rec->type,
+          rec->data);
+    }
+    printf ("\n  ],\n");
+  }
+  if (dump_bootlog && boot_log.magic == BOOTLOG_MAGIC)
+  {
+    static const char *stages[BOOT_STAGES] = {"uart_init", "led_flash",
+      "eeprom", "aci_init", "device_started", "bond_restore", "advertising",
+      "connected", "app"};
+    unsigned i;
+
+    /* Timer1 ticks of 1024 cycles at F_CPU */
+    printf ("  \"boot_stages_us\": {");
+    for (i = 0; i < BOOT_STAGES; i++)
+    {
+      printf ("%s\n    \"%s\": ", i ? "," : "", stages[i]);
+      if (boot_log.stamp[i] == BOOTLOG_NONE)
+      {
+        printf ("null");
+      }
+      else
+      {
+        printf ("%llu", boot_log.stamp[i] * 1024000000ULL / F_CPU);
+      }
+    }
+    printf ("\n  },\n");
+  }
+  if (dump_history)
+  {
+    history_entry_t e;
+    uint8_t n;
+
+    /* What the application would find, newest first */
+    printf ("  \"history\": [");
+    for (n = 0; history_read (n, &e); n++)
+    {
+      printf ("%s\n    {\"seq\": %u, \"transport\": %u, \"status\": %u, "
+          "\"image_size\": %u, \"duration_us\": %llu, "
+          "\"conn_interval\": %u, \"pages_written\": %u, "
+          "\"pages_skipped\": %u, \"reconnects\": %u}", n ? "," : "",
+          e.seq, e.transport, e.status, e.image_size,
+          (unsigned long long) e.duration * HISTORY_TICK_US, e.conn_interval,
+          e.pages_written, e.pages_skipped, e.reconnects);
+    }
+    printf ("\n  ],\n");
+  }
+  if (opts.replay)
+  {
+    printf ("  \"replay\": {\n");
+    printf ("    \"capture_us\": %llu,\n",
+        (unsigned long long) r.replay_duration_us);
+    printf ("    \"events\": %u,\n", r.replay.events);
+    printf ("    \"commands\": %u,\n", r.replay.commands);
+    printf ("    \"cmd_mismatches\": %u,\n", r.replay.cmd_mismatches);
+    printf ("    \"cmd_extra\": %u,\n", r.replay.cmd_extra);
+    printf ("    \"late_us\": %llu,\n", (unsigned long long) r.replay.late_us);
+    printf ("    \"max_late_us\": %llu,\n",
+        (unsigned long long) r.replay.max_late_us);
+    printf ("    \"skipped_bytes\": %u\n", r.replay.skipped_bytes);
+    printf ("  },\n");
+  }
+  if (opts.skip_start)
+  {
+    printf ("  \"refused\": %s,\n", r.refused ? "true" : "false");
+  }
+  if (opts.reset_at)
+  {
+    printf ("  \"resets\": %u,\n", r.resets);
+  }
+  if (opts.bad_tag)
+  {
+    printf ("  \"rejected\": %s,\n", r.rejected ? "true" : "false");
+  }
+  printf ("  \"central_state\": %u,\n", r.central_state);
+  printf ("  \"app_started\": %s,\n", r.app_started ? "true" : "false");
+  printf ("  \"verified\": %s\n", r.verified ? "true" : "false");
+  printf ("}\n");
+
+  ihex_free (&app);
+
+  return status;
+}
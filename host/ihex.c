@@ -0,0 +1,217 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the Intel HEX reader.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ihex.h"
+
+#define REC_DATA          0x00
+#define REC_EOF           0x01
+#define REC_EXT_SEGMENT   0x02
+#define REC_EXT_LINEAR    0x04
+
+/* Runs of set bits in used[], a bit per address */
+static void m_segments (const uint8_t *used, uint32_t lo, uint32_t hi,
+    ihex_image_t *img)
+{
+  ihex_segment_t *seg = NULL;
+  uint32_t addr;
+
+  for (addr = lo; addr < hi; addr++)
+  {
+    if (!(used[addr / 8] & (1 << (addr % 8))))
+    {
+      continue;
+    }
+    if (seg && (seg->start + seg->size == addr
+          || img->segments == IHEX_MAX_SEGMENTS))
+    {
+      seg->size = addr + 1 - seg->start;
+    }
+    else
+    {
+      seg = &img->segment[img->segments++];
+      seg->start = addr;
+      seg->size = 1;
+    }
+  }
+}
+
+static int m_hex_byte (const char *s)
+{
+  unsigned int v;
+
+  if (sscanf (s, "%2x", &v) != 1)
+  {
+    return -1;
+  }
+
+  return v;
+}
+
+int ihex_load (const char *path, ihex_image_t *img)
+{
+  char line[600];
+  uint8_t *mem;
+  uint8_t *used;
+  uint32_t upper = 0;
+  uint32_t lo = UINT32_MAX;
+  uint32_t hi = 0;
+  int status = -1;
+  FILE *f;
+
+  memset (img, 0, sizeof(*img));
+
+  f = fopen (path, "r");
+  if (f == NULL)
+  {
+    return -1;
+  }
+
+  mem = malloc (IHEX_MAX_SIZE);
+  used = calloc (IHEX_MAX_SIZE / 8, 1);
+  if (mem == NULL || used == NULL)
+  {
+    free (mem);
+    free (used);
+    fclose (f);
+    return -1;
+  }
+  memset (mem, 0xFF, IHEX_MAX_SIZE);
+
+  while (fgets (line, sizeof(line), f))
+  {
+    uint8_t rec[256 + 5];
+    uint8_t sum = 0;
+    int len;
+    int i;
+
+    if (line[0] != ':')
+    {
+      continue;
+    }
+
+    len = m_hex_byte (&line[1]);
+    if (len < 0 || strlen (line) < (size_t)(11 + len * 2))
+    {
+      goto out;
+    }
+
+    /* Length, address, type, data and checksum */
+    for (i = 0; i < len + 5; i++)
+    {
+      const int b = m_hex_byte (&line[1 + i * 2]);
+
+      if (b < 0)
+      {
+        goto out;
+      }
+      rec[i] = (uint8_t)b;
+      sum += rec[i];
+    }
+
+    if (sum != 0)
+    {
+      goto out;
+    }
+
+    switch (rec[3])
+    {
+      case REC_DATA:
+        {
+          const uint32_t addr = upper + ((uint32_t)rec[1] << 8 | rec[2]);
+
+          if (addr + len > IHEX_MAX_SIZE)
+          {
+            goto out;
+          }
+
+          memcpy (&mem[addr], &rec[4], len);
+          for (i = 0; i < len; i++)
+          {
+            used[(addr + i) / 8] |= 1 << ((addr + i) % 8);
+          }
+          if (len && addr < lo)
+          {
+            lo = addr;
+          }
+          if (len && addr + len > hi)
+          {
+            hi = addr + len;
+          }
+        }
+        break;
+
+      case REC_EOF:
+        status = 0;
+        goto out;
+
+      case REC_EXT_SEGMENT:
+        upper = ((uint32_t)rec[4] << 8 | rec[5]) << 4;
+        break;
+
+      case REC_EXT_LINEAR:
+        upper = ((uint32_t)rec[4] << 8 | rec[5]) << 16;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+out:
+  fclose (f);
+
+  if (status != 0 || hi == 0)
+  {
+    free (mem);
+    free (used);
+    return -1;
+  }
+
+  m_segments (used, lo, hi, img);
+  free (used);
+
+  img->base = lo;
+  img->size = hi - lo;
+  img->data = malloc (img->size);
+  if (img->data == NULL)
+  {
+    free (mem);
+    return -1;
+  }
+  memcpy (img->data, &mem[lo], img->size);
+  free (mem);
+
+  return 0;
+}
+
+void ihex_free (ihex_image_t *img)
+{
+  free (img->data);
+  memset (img, 0, sizeof(*img));
+}
@@ -0,0 +1,63 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Minimal Intel HEX reader for the host tools.
+ */
+
+#ifndef IHEX_H__
+#define IHEX_H__
+
+#include <stdint.h>
+
+/* Largest image we accept, enough for an ATmega1284P */
+#define IHEX_MAX_SIZE   (128UL * 1024UL)
+
+/* Runs of bytes the file gives, more are merged into the last one */
+#define IHEX_MAX_SEGMENTS  32
+
+typedef struct
+{
+  uint32_t  start;  /* Address */
+  uint32_t  size;
+} ihex_segment_t;
+
+/** Flat image, unused bytes between records are 0xFF */
+typedef struct
+{
+  uint8_t  *data;
+  uint32_t  base;   /* Address of data[0] */
+  uint32_t  size;
+
+  /* Where the records put data, in address order */
+  ihex_segment_t segment[IHEX_MAX_SEGMENTS];
+  uint16_t       segments;
+} ihex_image_t;
+
+/** @brief Read a .hex file into a flat image.
+ *  @return 0 on success, -1 on I/O or format errors.
+ */
+int ihex_load(const char *path, ihex_image_t *img);
+
+/** @brief Release the memory held by an image. */
+void ihex_free(ihex_image_t *img);
+
+#endif /* IHEX_H__ */
@@ -0,0 +1,85 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Host stand-in for <avr/io.h>, describing an ATmega328P.
+ * @details Only what the BLE modules touch is provided. Registers with side
+ * effects live in host_mcu.c; the memory sizes may be overridden on the
+ * command line to emulate other parts.
+ */
+
+#ifndef HOST_AVR_IO_H__
+#define HOST_AVR_IO_H__
+
+#include <stdint.h>
+
+#define _BV(bit)      (1 << (bit))
+
+/* The host clock models a 16 MHz part, see host_mcu.h */
+#ifndef F_CPU
+#define F_CPU         16000000UL
+#endif
+#ifndef SPM_PAGESIZE
+#define SPM_PAGESIZE  128
+#endif
+#ifndef FLASHEND
+#define FLASHEND      0x7FFF
+#endif
+#ifndef E2END
+#define E2END         0x3FF
+#endif
+#ifndef RAMSTART
+#define RAMSTART      0x100
+#endif
+#ifndef RAMEND
+#define RAMEND        0x8FF
+#endif
+
+/* MCU status register */
+extern volatile uint8_t host_mcusr;
+#define MCUSR         host_mcusr
+#define PORF          0
+#define EXTRF         1
+#define BORF          2
+#define WDRF          3
+
+/* Watchdog control register */
+extern volatile uint8_t host_wdtcsr;
+#define WDTCSR        host_wdtcsr
+#define WDP0          0
+#define WDP1          1
+#define WDP2          2
+#define WDE           3
+#define WDCE          4
+#define WDP3          5
+#define WDIE          6
+#define WDIF          7
+
+/* Timer1, counting virtual time when prescaled by 1024 */
+extern volatile uint8_t host_tccr1b;
+uint16_t host_tcnt1(void);
+#define TCCR1B        host_tccr1b
+#define TCNT1         host_tcnt1()
+#define CS10          0
+#define CS11          1
+#define CS12          2
+
+#endif /* HOST_AVR_IO_H__ */
@@ -0,0 +1,228 @@
+## @description
+## Follow the live progress stream of LIVE_TRACE bootloaders (see live.h)
+## on many units at once.
+##
+## Each source is a serial port, read raw at --baud, or a file such as
+## hostboot -L writes. Records are decoded as they arrive: a line is
+## printed for every state change, and a status line per unit every
+## --interval seconds with the pages committed, the throughput, the data
+## credits and the receive polls skipped on a full queue. Device time is
+## Timer1 unwrapped by the differences between records, so a gap of more
+## than one wrap (4.2 s at 16 MHz) without records is lost from it.
+
+## @setup
+## A board with a bootloader built with LIVE_TRACE=1, its UART on a serial
+## port, or make -C host hostboot and ./hostboot -L live.bin <app.hex>.
+
+## @expected_output
+## Progress lines on stderr and, with -o or at the end, a JSON summary per
+## unit: pages, bytes, device time of the transfer, throughput, stalls,
+## lowest credit level, dropped records and whether the unit reset into
+## the application.
+
+#########################################
+from __future__ import print_function
+
+import argparse
+import json
+import os
+import select
+import sys
+import termios
+import time
+
+SYNC = 0x5A
+RECORD_SIZE = 5
+
+# Types of live.h and trace.h
+BOOT, ACI_EVT, DFU_STATE, PAGE, WDT_EXIT, CREDITS, STALLS, DROPPED = range(1, 9)
+
+# ST_* of dfu.h
+STATES = {1: 'idle', 2: 'rdy', 3: 'rx_init_pkt', 4: 'rx_data_pkt',
+          5: 'fw_valid', 6: 'fw_invalid'}
+
+BAUDS = dict((int(n[1:]), getattr(termios, n)) for n in dir(termios)
+             if n.startswith('B') and n[1:].isdigit())
+
+
+class Unit(object):
+  def __init__(self, name, fd, args):
+    self.name = name
+    self.fd = fd
+    self.tick_us = 1024000.0 / args.khz
+    self.page_size = args.page_size
+    self.buf = bytearray()
+    self.skipped = 0
+    self.boots = 0
+    self.eof = False
+    self.start()
+
+  def start(self):
+    """A new session"""
+    self.ticks = 0
+    self.last = None
+    self.state = 'idle'
+    self.pages = 0
+    self.t_first_page = None
+    self.t_last_page = None
+    self.credits = None
+    self.min_credits = None
+    self.stalls = 0
+    self.dropped = 0
+    self.exited = False
+
+  def now_us(self):
+    return self.ticks * self.tick_us
+
+  def feed(self, data):
+    self.buf += data
+    while len(self.buf) >= RECORD_SIZE:
+      if self.buf[0] != SYNC:
+        del self.buf[0]
+        self.skipped += 1
+        continue
+      rec = self.buf[:RECORD_SIZE]
+      del self.buf[:RECORD_SIZE]
+      self.record((rec[1] | rec[2] << 8), rec[3], rec[4])
+
+  def record(self, time, type, data):
+    if self.last is not None:
+      self.ticks += (time - self.last) & 0xFFFF
+    self.last = time
+
+    if type == BOOT:
+      self.start()
+      self.boots += 1
+    elif type == DFU_STATE:
+      self.state = STATES.get(data, str(data))
+      log('%s %.3f s state %s' % (self.name, self.now_us() / 1e6, self.state))
+    elif type == PAGE:
+      self.pages += 1
+      if self.t_first_page is None:
+        self.t_first_page = self.now_us()
+      self.t_last_page = self.now_us()
+    elif type == WDT_EXIT:
+      self.exited = True
+      log('%s %.3f s reset into the application' % (self.name,
+                                                    self.now_us() / 1e6))
+    elif type == CREDITS:
+      self.credits = data
+      self.min_credits = data if self.min_credits is None else \
+          min(self.min_credits, data)
+    elif type == STALLS:
+      self.stalls += data
+    elif type == DROPPED:
+      self.dropped += data
+
+  def throughput(self):
+    # The first page is committed once it has been received
+    if self.pages < 2:
+      return 0.0
+    span = (self.t_last_page - self.t_first_page) / 1e6
+    return (self.pages - 1) * self.page_size / span if span else 0.0
+
+  def status(self):
+    return ('%s %s pages=%u %.0f B/s credits=%s stalls=%u dropped=%u' % (
+        self.name, self.state, self.pages, self.throughput(),
+        '-' if self.credits is None else self.credits, self.stalls,
+        self.dropped))
+
+  def summary(self):
+    return dict(unit=self.name, state=self.state, pages=self.pages,
+                bytes=self.pages * self.page_size,
+                transfer_us=(self.t_last_page - self.t_first_page
+                             if self.pages else 0),
+                throughput_bps=self.throughput(), stalls=self.stalls,
+                min_credits=self.min_credits, dropped=self.dropped,
+                skipped_bytes=self.skipped, app_started=self.exited)
+
+
+def log(line):
+  print(line, file=sys.stderr)
+  sys.stderr.flush()
+
+
+def open_source(path, baud):
+  fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+  if os.isatty(fd):
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                                  # iflag
+    attrs[1] = 0                                  # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                                  # lflag
+    attrs[4] = attrs[5] = BAUDS[baud]
+    attrs[6][termios.VMIN] = 1
+    attrs[6][termios.VTIME] = 0
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIFLUSH)
+  return fd
+
+
+def watch(units, args):
+  live = [u for u in units if not u.eof]
+  deadline = time.time() + args.timeout if args.timeout else None
+  next_status = time.time() + args.interval
+
+  while live:
+    if args.until_exit and all(u.exited for u in units):
+      break
+    now = time.time()
+    if deadline and now >= deadline:
+      break
+    ready, _, _ = select.select([u.fd for u in live], [], [],
+                                max(0.0, next_status - now))
+    for u in live:
+      if u.fd in ready:
+        data = os.read(u.fd, 4096)
+        if data:
+          u.feed(bytearray(data))
+        elif not os.isatty(u.fd):
+          u.eof = True
+    live = [u for u in live if not u.eof]
+    if time.time() >= next_status:
+      for u in units:
+        log(u.status())
+      next_status = time.time() + args.interval
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Follow the LIVE_TRACE stream of many units')
+  parser.add_argument('sources', nargs='+',
+                      help='serial ports or files of the stream')
+  parser.add_argument('-b', '--baud', type=int, default=115200)
+  parser.add_argument('--khz', type=int, default=16000,
+                      help='F_CPU of the units in kHz')
+  parser.add_argument('--page-size', type=int, default=128)
+  parser.add_argument('--interval', type=float, default=1.0,
+                      help='seconds between status lines')
+  parser.add_argument('--timeout', type=float, default=0,
+                      help='stop after this many seconds, 0 for never')
+  parser.add_argument('--until-exit', action='store_true',
+                      help='stop once every unit reset into its application')
+  parser.add_argument('-o', '--output', help='JSON summary file (stdout)')
+  args = parser.parse_args()
+
+  if args.baud not in BAUDS:
+    parser.error('unsupported baud rate %u' % args.baud)
+
+  units = [Unit(s, open_source(s, args.baud), args) for s in args.sources]
+  try:
+    watch(units, args)
+  except KeyboardInterrupt:
+    pass
+  for u in units:
+    os.close(u.fd)
+    log(u.status())
+
+  out = open(args.output, 'w') if args.output else sys.stdout
+  json.dump([u.summary() for u in units], out, indent=2)
+  out.write('\n')
+  if args.output:
+    out.close()
+
+  return 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,538 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the nRF8001 ACI model.
+ */
+
+#include <string.h>
+
+#include "../BLE/aci.h"
+#include "../BLE/aci_cmds.h"
+#include "../BLE/aci_evts.h"
+
+#include "nrf8001.h"
+
+#define NEVER               UINT64_MAX
+
+/* Status byte clocked out first in every SPI transaction */
+#define SPI_STATUS_BYTE     0x00
+
+/* Disconnect reason reported when the MCU closes the link */
+#define BTLE_LOCAL_HOST_TERMINATED  0x16
+
+/*****************************************************************************
+* Queues
+*****************************************************************************/
+
+static uint8_t *m_evt_alloc (nrf8001_t *emu)
+{
+  if ((uint8_t)(emu->evt_tail - emu->evt_head) == NRF8001_EVT_QUEUE_SIZE)
+  {
+    return NULL;
+  }
+
+  return emu->evt[emu->evt_tail++ % NRF8001_EVT_QUEUE_SIZE];
+}
+
+static bool m_evt_full (const nrf8001_t *emu)
+{
+  return (uint8_t)(emu->evt_tail - emu->evt_head) == NRF8001_EVT_QUEUE_SIZE;
+}
+
+/* Queue an event made of an opcode and len bytes of parameters */
+static bool m_evt_put (nrf8001_t *emu, uint8_t opcode,
+    const uint8_t *params, uint8_t len)
+{
+  uint8_t *evt = m_evt_alloc (emu);
+
+  if (evt == NULL)
+  {
+    return false;
+  }
+
+  evt[0] = len + 1;
+  evt[1] = opcode;
+  memcpy (&evt[2], params, len);
+
+  return true;
+}
+
+static void m_cmd_rsp (nrf8001_t *emu, uint8_t cmd, uint8_t status,
+    const uint8_t *params, uint8_t len)
+{
+  uint8_t rsp[NRF8001_MSG_MAX];
+
+  rsp[0] = cmd;
+  rsp[1] = status;
+  if (len)
+  {
+    memcpy (&rsp[2], params, len);
+  }
+
+  m_evt_put (emu, ACI_EVT_CMD_RSP, rsp, len + 2);
+}
+
+static void m_pipe_error (nrf8001_t *emu, uint8_t pipe, uint8_t error)
+{
+  const uint8_t params[] = {pipe, error};
+
+  m_evt_put (emu, ACI_EVT_PIPE_ERROR, params, sizeof(params));
+}
+
+/*****************************************************************************
+* Radio activity
+*****************************************************************************/
+
+static void m_link_drop (nrf8001_t *emu)
+{
+  emu->state = NRF8001_ST_STANDBY;
+  emu->connect_at_us = NEVER;
+  emu->next_event_us = NEVER;
+  emu->credits = emu->cfg.credits;
+  emu->credits_used = 0;
+  emu->ntf_head = emu->ntf_tail = 0;
+}
+
+static void m_device_started (nrf8001_t *emu)
+{
+  const uint8_t params[] = {ACI_DEVICE_STANDBY, 0, emu->cfg.credits};
+
+  emu->started_at_us = NEVER;
+  emu->state = NRF8001_ST_STANDBY;
+  emu->credits = emu->cfg.credits;
+
+  m_evt_put (emu, ACI_EVT_DEVICE_STARTED, params, sizeof(params));
+}
+
+static void m_connected (nrf8001_t *emu)
+{
+  const uint16_t interval = emu->cfg.conn_interval;
+  uint8_t params[16];
+
+  emu->connect_at_us = NEVER;
+  emu->state = NRF8001_ST_CONNECTED;
+  emu->credits = emu->cfg.credits;
+  emu->next_event_us = emu->now_us +
+    (uint64_t)interval * NRF8001_INTERVAL_UNIT_US;
+
+  /* Public address, 500 ppm master clock */
+  memset (params, 0, sizeof(params));
+  params[0] = 0x01;
+  params[1] = 0xC0;
+  params[7] = (uint8_t)(interval);
+  params[8] = (uint8_t)(interval >> 8);
+  params[11] = 0x90;
+  params[12] = 0x01;
+  m_evt_put (emu, ACI_EVT_CONNECTED, params, 14);
+
+  memset (params, 0, sizeof(params));
+  memcpy (params, emu->cfg.pipes_open, 8);
+  m_evt_put (emu, ACI_EVT_PIPE_STATUS, params, 16);
+}
+
+/* One connection event: deliver notifications to the central, return the
+ * credits they used, then deliver the writes the central has queued.
+ */
+static void m_conn_event (nrf8001_t *emu)
+{
+  uint8_t i;
+
+  emu->stats.conn_events++;
+
+  while (emu->ntf_head != emu->ntf_tail)
+  {
+    const uint8_t *ntf = emu->ntf[emu->ntf_head++ % NRF8001_EVT_QUEUE_SIZE];
+
+    if (emu->notify_cb)
+    {
+      emu->notify_cb (emu->notify_ctx, ntf[1], &ntf[2], ntf[0] - 1);
+    }
+  }
+
+  if (emu->credits_used && !m_evt_full (emu))
+  {
+    const uint8_t credit = emu->credits_used;
+
+    m_evt_put (emu, ACI_EVT_DATA_CREDIT, &credit, 1);
+    emu->credits += emu->credits_used;
+    emu->credits_used = 0;
+  }
+
+  for (i = 0; i < emu->cfg.pkts_per_event; i++)
+  {
+    const uint8_t *wr;
+
+    if (emu->wr_head == emu->wr_tail)
+    {
+      break;
+    }
+
+    if (m_evt_full (emu))
+    {
+      emu->stats.write_stalls++;
+      break;
+    }
+
+    wr = emu->wr[emu->wr_head++ % NRF8001_WRITE_QUEUE_SIZE];
+    m_evt_put (emu, ACI_EVT_DATA_RECEIVED, &wr[1], wr[0]);
+    emu->stats.data_received++;
+  }
+
+  emu->next_event_us +=
+    (uint64_t)emu->cfg.conn_interval * NRF8001_INTERVAL_UNIT_US;
+}
+
+/*****************************************************************************
+* Commands
+*****************************************************************************/
+
+static void m_send_data (nrf8001_t *emu, const uint8_t *cmd)
+{
+  const uint8_t pipe = cmd[2];
+  uint8_t *ntf;
+
+  if (emu->state != NRF8001_ST_CONNECTED)
+  {
+    m_pipe_error (emu, pipe, ACI_STATUS_ERROR_PIPE_STATE_INVALID);
+    return;
+  }
+
+  if (emu->credits == 0 ||
+      (uint8_t)(emu->ntf_tail - emu->ntf_head) == NRF8001_EVT_QUEUE_SIZE)
+  {
+    emu->stats.credit_errors++;
+    m_pipe_error (emu, pipe, ACI_STATUS_ERROR_CREDIT_NOT_AVAILABLE);
+    return;
+  }
+
+  emu->credits--;
+  emu->credits_used++;
+  emu->stats.notifications++;
+
+  /* Keep pipe and payload, with the length of both first */
+  ntf = emu->ntf[emu->ntf_tail++ % NRF8001_EVT_QUEUE_SIZE];
+  ntf[0] = cmd[0] - 1;
+  memcpy (&ntf[1], &cmd[2], cmd[0] - 1);
+}
+
+void nrf8001_cmd_put (nrf8001_t *emu, const uint8_t *cmd)
+{
+  const uint8_t opcode = cmd[1];
+
+  emu->stats.commands++;
+
+  switch (opcode)
+  {
+    case ACI_CMD_RADIO_RESET:
+      m_link_drop (emu);
+      m_cmd_rsp (emu, opcode, ACI_STATUS_SUCCESS, NULL, 0);
+      break;
+
+    case ACI_CMD_CONNECT:
+      if (emu->state != NRF8001_ST_STANDBY)
+      {
+        m_cmd_rsp (emu, opcode, ACI_STATUS_ERROR_DEVICE_STATE_INVALID, NULL, 0);
+        break;
+      }
+      emu->state = NRF8001_ST_ADVERTISING;
+      emu->connect_at_us = emu->now_us + emu->cfg.adv_delay_us;
+      m_cmd_rsp (emu, opcode, ACI_STATUS_SUCCESS, NULL, 0);
+      break;
+
+    case ACI_CMD_DISCONNECT:
+      if (emu->state != NRF8001_ST_CONNECTED)
+      {
+        m_cmd_rsp (emu, opcode, ACI_STATUS_ERROR_DEVICE_STATE_INVALID, NULL, 0);
+        break;
+      }
+      m_cmd_rsp (emu, opcode, ACI_STATUS_SUCCESS, NULL, 0);
+      {
+        const uint8_t params[] = {ACI_STATUS_SUCCESS,
+          BTLE_LOCAL_HOST_TERMINATED};
+
+        m_link_drop (emu);
+        m_evt_put (emu, ACI_EVT_DISCONNECTED, params, sizeof(params));
+      }
+      break;
+
+    case ACI_CMD_SEND_DATA:
+      m_send_data (emu, cmd);
+      break;
+
+    case ACI_CMD_ECHO:
+      m_evt_put (emu, ACI_EVT_ECHO, &cmd[2], cmd[0] - 1);
+      break;
+
+    case ACI_CMD_GET_DEVICE_VERSION:
+      {
+        /* Configuration ID, ACI version, setup format, setup ID, status */
+        const uint8_t params[] = {0x02, 0x00, ACI_VERSION, 0x03,
+          0x00, 0x00, 0x00, 0x00, 0x01};
+
+        m_cmd_rsp (emu, opcode, ACI_STATUS_SUCCESS, params, sizeof(params));
+      }
+      break;
+
+    case ACI_CMD_WRITE_DYNAMIC_DATA:
+      m_cmd_rsp (emu, opcode, ACI_STATUS_TRANSACTION_COMPLETE, NULL, 0);
+      break;
+
+    default:
+      m_cmd_rsp (emu, opcode, ACI_STATUS_ERROR_CMD_UNKNOWN, NULL, 0);
+      break;
+  }
+}
+
+/*****************************************************************************
+* Public API
+*****************************************************************************/
+
+void nrf8001_config_default (nrf8001_config_t *cfg)
+{
+  memset (cfg, 0, sizeof(*cfg));
+
+  cfg->boot_state = NRF8001_BOOT_COLD;
+  cfg->credits = 2;
+  cfg->conn_interval = 6;
+  cfg->pkts_per_event = 4;
+  cfg->startup_us = 62000;
+  cfg->adv_delay_us = 100000;
+
+  /* Pipes 8, 9 and 10, as in the EEPROM image used by the system tests */
+  cfg->pipes_open[1] = 0x07;
+}
+
+void nrf8001_init (nrf8001_t *emu, const nrf8001_config_t *cfg)
+{
+  memset (emu, 0, sizeof(*emu));
+
+  emu->cfg = *cfg;
+  emu->reqn = 1;
+  emu->started_at_us = NEVER;
+  emu->connect_at_us = NEVER;
+  emu->next_event_us = NEVER;
+
+  if (cfg->boot_state == NRF8001_BOOT_COLD)
+  {
+    emu->state = NRF8001_ST_RESET;
+    emu->started_at_us = cfg->startup_us;
+  }
+  else
+  {
+    emu->state = NRF8001_ST_STANDBY;
+    emu->credits = cfg->credits;
+  }
+}
+
+void nrf8001_notify_set (nrf8001_t *emu, nrf8001_notify_cb_t cb, void *ctx)
+{
+  emu->notify_cb = cb;
+  emu->notify_ctx = ctx;
+}
+
+uint64_t nrf8001_next_deadline (const nrf8001_t *emu)
+{
+  uint64_t next = emu->started_at_us;
+
+  if (emu->connect_at_us < next)
+  {
+    next = emu->connect_at_us;
+  }
+
+  if (emu->next_event_us < next)
+  {
+    next = emu->next_event_us;
+  }
+
+  return next;
+}
+
+void nrf8001_run (nrf8001_t *emu, uint64_t now_us)
+{
+  for (;;)
+  {
+    const uint64_t next = nrf8001_next_deadline (emu);
+
+    if (next > now_us)
+    {
+      break;
+    }
+
+    emu->now_us = next;
+
+    if (next == emu->started_at_us)
+    {
+      m_device_started (emu);
+    }
+    else if (next == emu->connect_at_us)
+    {
+      m_connected (emu);
+    }
+    else
+    {
+      m_conn_event (emu);
+    }
+  }
+
+  emu->now_us = now_us;
+}
+
+bool nrf8001_evt_pending (const nrf8001_t *emu)
+{
+  return emu->evt_head != emu->evt_tail;
+}
+
+bool nrf8001_evt_get (nrf8001_t *emu, uint8_t *evt)
+{
+  if (!nrf8001_evt_pending (emu))
+  {
+    return false;
+  }
+
+  const uint8_t *head = emu->evt[emu->evt_head++ % NRF8001_EVT_QUEUE_SIZE];
+
+  memcpy (evt, head, head[0] + 1);
+  emu->stats.events++;
+
+  return true;
+}
+
+void nrf8001_spi_reqn (nrf8001_t *emu, uint8_t level)
+{
+  level = level ? 1 : 0;
+
+  if (level == emu->reqn)
+  {
+    return;
+  }
+
+  emu->reqn = level;
+
+  if (level == 0)
+  {
+    /* Start of a transaction. Latch the event we are going to send */
+    emu->spi_active = 1;
+    emu->spi_idx = 0;
+    emu->spi_cmd[0] = 0;
+    emu->spi_evt[0] = 0;
+    emu->spi_evt_valid = 0;
+
+    if (emu->state != NRF8001_ST_RESET && nrf8001_evt_pending (emu))
+    {
+      const uint8_t *head = emu->evt[emu->evt_head % NRF8001_EVT_QUEUE_SIZE];
+
+      memcpy (emu->spi_evt, head, head[0] + 1);
+      emu->spi_evt_valid = 1;
+    }
+    return;
+  }
+
+  if (!emu->spi_active)
+  {
+    return;
+  }
+
+  /* End of a transaction. Consume what was fully clocked through */
+  emu->spi_active = 0;
+  emu->stats.spi_transfers++;
+
+  if (emu->spi_evt_valid && emu->spi_idx >= emu->spi_evt[0] + 2)
+  {
+    emu->evt_head++;
+    emu->stats.events++;
+  }
+
+  if (emu->spi_cmd[0] > 0 && emu->spi_idx >= emu->spi_cmd[0] + 1)
+  {
+    nrf8001_cmd_put (emu, emu->spi_cmd);
+  }
+}
+
+uint8_t nrf8001_spi_xfer (nrf8001_t *emu, uint8_t mosi)
+{
+  const uint8_t idx = emu->spi_idx;
+  uint8_t miso = 0;
+
+  if (!emu->spi_active)
+  {
+    return 0;
+  }
+
+  if (idx < sizeof(emu->spi_cmd))
+  {
+    emu->spi_cmd[idx] = mosi;
+  }
+
+  if (idx == 0)
+  {
+    miso = SPI_STATUS_BYTE;
+  }
+  else if (idx - 1 <= emu->spi_evt[0] && idx - 1 < sizeof(emu->spi_evt))
+  {
+    miso = emu->spi_evt[idx - 1];
+  }
+
+  if (emu->spi_idx < 0xFF)
+  {
+    emu->spi_idx++;
+  }
+
+  return miso;
+}
+
+uint8_t nrf8001_rdyn (const nrf8001_t *emu)
+{
+  if (emu->state == NRF8001_ST_RESET)
+  {
+    return 1;
+  }
+
+  return (emu->spi_active || nrf8001_evt_pending (emu)) ? 0 : 1;
+}
+
+bool nrf8001_central_write (nrf8001_t *emu, uint8_t pipe,
+    const uint8_t *data, uint8_t len)
+{
+  uint8_t *wr;
+
+  if (len > ACI_PIPE_RX_DATA_MAX_LEN || nrf8001_central_room (emu) == 0)
+  {
+    return false;
+  }
+
+  wr = emu->wr[emu->wr_tail++ % NRF8001_WRITE_QUEUE_SIZE];
+  wr[0] = len + 1;
+  wr[1] = pipe;
+  memcpy (&wr[2], data, len);
+
+  return true;
+}
+
+uint8_t nrf8001_central_room (const nrf8001_t *emu)
+{
+  return NRF8001_WRITE_QUEUE_SIZE - (uint8_t)(emu->wr_tail - emu->wr_head);
+}
+
+bool nrf8001_connected (const nrf8001_t *emu)
+{
+  return emu->state == NRF8001_ST_CONNECTED;
+}
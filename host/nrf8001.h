@@ -0,0 +1,195 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Software model of the nRF8001 Application Controller Interface.
+ */
+
+/** @defgroup nrf8001 nrf8001
+@{
+@ingroup host
+
+@brief Host-side emulation of an nRF8001 for simulator based testing
+@details The model keeps the radio state (standby, advertising, connected),
+a queue of pending ACI events and a queue of writes issued by the emulated
+central. Time is supplied by the caller through nrf8001_run(), so the same
+model can be clocked from a cycle accurate AVR simulator or from a virtual
+clock in a native build.
+
+Two interfaces are offered towards the MCU. The packet interface exchanges
+whole ACI messages, with the length byte first, and is used by builds that
+replace hal_aci_tl.c. The SPI interface models the REQN/RDYN handshake and the
+full-duplex byte transfer, and is used when the real bootloader image drives
+the SPI peripheral of a simulated ATmega.
+*/
+
+#ifndef NRF8001_H__
+#define NRF8001_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Largest ACI message, including the length byte */
+#define NRF8001_MSG_MAX            32
+
+#define NRF8001_EVT_QUEUE_SIZE     8
+#define NRF8001_WRITE_QUEUE_SIZE   32
+
+/* Connection interval unit, in microseconds */
+#define NRF8001_INTERVAL_UNIT_US   1250
+
+/* State of the radio when the MCU starts talking to it */
+#define NRF8001_BOOT_COLD          0   /* Power-on, DeviceStarted follows */
+#define NRF8001_BOOT_STANDBY       1   /* Already started, nothing pending */
+
+/* Radio operating state */
+#define NRF8001_ST_RESET           0
+#define NRF8001_ST_STANDBY         1
+#define NRF8001_ST_ADVERTISING     2
+#define NRF8001_ST_CONNECTED       3
+
+typedef struct
+{
+  uint8_t  boot_state;       /* NRF8001_BOOT_* */
+  uint8_t  credits;          /* Data credits reported in DeviceStarted */
+  uint16_t conn_interval;    /* Connection interval, 1.25 ms units */
+  uint8_t  pkts_per_event;   /* Central writes delivered per connection event */
+  uint32_t startup_us;       /* Reset to DeviceStarted */
+  uint32_t adv_delay_us;     /* Advertising time before the central connects */
+  uint8_t  pipes_open[8];    /* Pipe bitmap reported in PipeStatus */
+} nrf8001_config_t;
+
+/* Called for every notification the MCU sends while connected */
+typedef void (*nrf8001_notify_cb_t)(void *ctx, uint8_t pipe,
+    const uint8_t *data, uint8_t len);
+
+typedef struct
+{
+  uint32_t events;           /* ACI events handed to the MCU */
+  uint32_t commands;         /* ACI commands received from the MCU */
+  uint32_t spi_transfers;    /* Completed SPI transactions */
+  uint32_t data_received;    /* DataReceived events generated */
+  uint32_t notifications;    /* SendData commands accepted */
+  uint32_t credit_errors;    /* SendData commands rejected for lack of credit */
+  uint32_t conn_events;      /* Connection events while connected */
+  uint32_t write_stalls;     /* Connection events where the event queue was full */
+} nrf8001_stats_t;
+
+typedef struct
+{
+  nrf8001_config_t cfg;
+  nrf8001_stats_t  stats;
+
+  uint8_t  state;
+  uint64_t now_us;
+  uint64_t started_at_us;    /* Pending DeviceStarted, UINT64_MAX if none */
+  uint64_t connect_at_us;    /* Pending connection, UINT64_MAX if none */
+  uint64_t next_event_us;    /* Next connection event */
+  uint8_t  credits;          /* Credits currently held by the MCU */
+  uint8_t  credits_used;     /* Credits to return on next connection event */
+
+  /* Events waiting to be read by the MCU */
+  uint8_t  evt[NRF8001_EVT_QUEUE_SIZE][NRF8001_MSG_MAX];
+  uint8_t  evt_head;
+  uint8_t  evt_tail;
+
+  /* Writes from the central, [0] is the length of pipe + data */
+  uint8_t  wr[NRF8001_WRITE_QUEUE_SIZE][NRF8001_MSG_MAX];
+  uint8_t  wr_head;
+  uint8_t  wr_tail;
+
+  /* Notifications waiting for the next connection event */
+  uint8_t  ntf[NRF8001_EVT_QUEUE_SIZE][NRF8001_MSG_MAX];
+  uint8_t  ntf_head;
+  uint8_t  ntf_tail;
+
+  nrf8001_notify_cb_t notify_cb;
+  void               *notify_ctx;
+
+  /* SPI transaction state */
+  uint8_t  reqn;             /* Level of the REQN line */
+  uint8_t  spi_active;
+  uint8_t  spi_idx;
+  uint8_t  spi_cmd[NRF8001_MSG_MAX + 1];
+  uint8_t  spi_evt[NRF8001_MSG_MAX];
+  uint8_t  spi_evt_valid;
+} nrf8001_t;
+
+/** @brief Fill in a configuration matching the bootloader defaults. */
+void nrf8001_config_default(nrf8001_config_t *cfg);
+
+/** @brief Reset the model, as if the nRF8001 RESET pin was toggled. */
+void nrf8001_init(nrf8001_t *emu, const nrf8001_config_t *cfg);
+
+/** @brief Register the receiver of notifications sent by the MCU. */
+void nrf8001_notify_set(nrf8001_t *emu, nrf8001_notify_cb_t cb, void *ctx);
+
+/** @brief Advance model time to now_us, running due radio activity. */
+void nrf8001_run(nrf8001_t *emu, uint64_t now_us);
+
+/** @brief Time of the next scheduled radio activity, UINT64_MAX if none. */
+uint64_t nrf8001_next_deadline(const nrf8001_t *emu);
+
+/** @name Packet interface */
+/* @{ */
+
+/** @brief Hand an ACI command to the radio. cmd[0] is the length. */
+void nrf8001_cmd_put(nrf8001_t *emu, const uint8_t *cmd);
+
+/** @brief Take the oldest pending ACI event. evt[0] is the length. */
+bool nrf8001_evt_get(nrf8001_t *emu, uint8_t *evt);
+
+/** @brief True if the radio has an event for the MCU. */
+bool nrf8001_evt_pending(const nrf8001_t *emu);
+
+/* @} */
+
+/** @name SPI interface */
+/* @{ */
+
+/** @brief Report a change of the REQN line. */
+void nrf8001_spi_reqn(nrf8001_t *emu, uint8_t level);
+
+/** @brief Exchange one byte. MOSI in, MISO returned. */
+uint8_t nrf8001_spi_xfer(nrf8001_t *emu, uint8_t mosi);
+
+/** @brief Level of the RDYN line. */
+uint8_t nrf8001_rdyn(const nrf8001_t *emu);
+
+/* @} */
+
+/** @name Central side */
+/* @{ */
+
+/** @brief Queue a write from the central to the given pipe. */
+bool nrf8001_central_write(nrf8001_t *emu, uint8_t pipe,
+    const uint8_t *data, uint8_t len);
+
+/** @brief Number of writes the central can still queue. */
+uint8_t nrf8001_central_room(const nrf8001_t *emu);
+
+/** @brief True once a link to the central is up. */
+bool nrf8001_connected(const nrf8001_t *emu);
+
+/* @} */
+
+#endif /* NRF8001_H__ */
+/** @} */
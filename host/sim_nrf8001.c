@@ -0,0 +1,126 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief simavr glue for the nRF8001 model.
+ */
+
+#include "sim_avr.h"
+#include "sim_time.h"
+#include "avr_ioport.h"
+#include "avr_spi.h"
+
+#include "sim_nrf8001.h"
+
+/* Arduino pin numbering, as implemented by BLE/pins_arduino.c */
+static char m_pin_port (uint8_t n)
+{
+  if (n < 8)
+  {
+    return 'D';
+  }
+  else if (n < 14)
+  {
+    return 'B';
+  }
+  return 'C';
+}
+
+static uint8_t m_pin_bit (uint8_t n)
+{
+  if (n < 8)
+  {
+    return n;
+  }
+  else if (n < 14)
+  {
+    return n - 8;
+  }
+  return n - 14;
+}
+
+static void m_rdyn_update (sim_nrf8001_t *p)
+{
+  const uint8_t level = nrf8001_rdyn (&p->emu);
+
+  if (level != p->rdyn)
+  {
+    p->rdyn = level;
+    avr_raise_irq (p->rdyn_pin, level);
+  }
+}
+
+uint64_t sim_nrf8001_now (const sim_nrf8001_t *p)
+{
+  return avr_cycles_to_usec (p->avr, p->avr->cycle);
+}
+
+static void m_reqn_changed (struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  sim_nrf8001_t *p = (sim_nrf8001_t *) param;
+
+  nrf8001_run (&p->emu, sim_nrf8001_now (p));
+  nrf8001_spi_reqn (&p->emu, value ? 1 : 0);
+  m_rdyn_update (p);
+}
+
+/* The SPI master has shifted out a byte, answer with ours */
+static void m_spi_out (struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  sim_nrf8001_t *p = (sim_nrf8001_t *) param;
+
+  avr_raise_irq (p->spi_in, nrf8001_spi_xfer (&p->emu, (uint8_t) value));
+}
+
+static avr_cycle_count_t m_tick (struct avr_t *avr, avr_cycle_count_t when,
+    void *param)
+{
+  sim_nrf8001_t *p = (sim_nrf8001_t *) param;
+
+  nrf8001_run (&p->emu, sim_nrf8001_now (p));
+  m_rdyn_update (p);
+
+  return when + avr_usec_to_cycles (avr, SIM_NRF8001_TICK_US);
+}
+
+void sim_nrf8001_attach (sim_nrf8001_t *p, avr_t *avr,
+    const nrf8001_config_t *cfg, uint8_t reqn_pin, uint8_t rdyn_pin)
+{
+  p->avr = avr;
+  nrf8001_init (&p->emu, cfg);
+
+  p->spi_in = avr_io_getirq (avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_INPUT);
+  avr_irq_register_notify (
+      avr_io_getirq (avr, AVR_IOCTL_SPI_GETIRQ(0), SPI_IRQ_OUTPUT),
+      m_spi_out, p);
+
+  avr_irq_register_notify (
+      avr_io_getirq (avr, AVR_IOCTL_IOPORT_GETIRQ(m_pin_port (reqn_pin)),
+        m_pin_bit (reqn_pin)),
+      m_reqn_changed, p);
+
+  p->rdyn_pin = avr_io_getirq (avr,
+      AVR_IOCTL_IOPORT_GETIRQ(m_pin_port (rdyn_pin)), m_pin_bit (rdyn_pin));
+  p->rdyn = 1;
+  avr_raise_irq (p->rdyn_pin, 1);
+
+  avr_cycle_timer_register_usec (avr, SIM_NRF8001_TICK_US, m_tick, p);
+}
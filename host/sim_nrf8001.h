@@ -0,0 +1,56 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief simavr peripheral wiring the nRF8001 model to a simulated ATmega.
+ */
+
+#ifndef SIM_NRF8001_H__
+#define SIM_NRF8001_H__
+
+#include "sim_avr.h"
+
+#include "nrf8001.h"
+
+/* Period of the model clock, in microseconds */
+#define SIM_NRF8001_TICK_US   50
+
+typedef struct
+{
+  avr_t     *avr;
+  nrf8001_t  emu;
+
+  avr_irq_t *spi_in;      /* MISO towards the SPI peripheral */
+  avr_irq_t *rdyn_pin;    /* RDYN port pin */
+  uint8_t    rdyn;        /* Last level driven on RDYN */
+} sim_nrf8001_t;
+
+/** @brief Create the model and connect it to the AVR.
+ *  @param reqn_pin Arduino pin number of REQN, as in aci_pins_t.
+ *  @param rdyn_pin Arduino pin number of RDYN, as in aci_pins_t.
+ */
+void sim_nrf8001_attach(sim_nrf8001_t *p, avr_t *avr,
+    const nrf8001_config_t *cfg, uint8_t reqn_pin, uint8_t rdyn_pin);
+
+/** @brief Current simulation time in microseconds. */
+uint64_t sim_nrf8001_now(const sim_nrf8001_t *p);
+
+#endif /* SIM_NRF8001_H__ */
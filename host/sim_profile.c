@@ -0,0 +1,269 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the simulation profiler.
+ */
+
+#include <elf.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_profile.h"
+
+static int m_addr_cmp (const void *a, const void *b)
+{
+  const sim_profile_func_t *fa = (const sim_profile_func_t *) a;
+  const sim_profile_func_t *fb = (const sim_profile_func_t *) b;
+
+  return (fa->addr > fb->addr) - (fa->addr < fb->addr);
+}
+
+static int m_name_cmp (const void *a, const void *b)
+{
+  const sim_profile_func_t *fa = *(const sim_profile_func_t * const *) a;
+  const sim_profile_func_t *fb = *(const sim_profile_func_t * const *) b;
+
+  return strcmp (fa->name, fb->name);
+}
+
+static uint8_t *m_file_read (const char *path, size_t *size)
+{
+  uint8_t *buf = NULL;
+  FILE *f;
+  long n;
+
+  f = fopen (path, "rb");
+  if (f == NULL)
+  {
+    return NULL;
+  }
+
+  if (fseek (f, 0, SEEK_END) == 0 && (n = ftell (f)) > 0 &&
+      fseek (f, 0, SEEK_SET) == 0)
+  {
+    buf = malloc (n);
+    if (buf && fread (buf, 1, n, f) != (size_t) n)
+    {
+      free (buf);
+      buf = NULL;
+    }
+    *size = n;
+  }
+
+  fclose (f);
+
+  return buf;
+}
+
+int sim_profile_load (sim_profile_t *p, const char *elf_path)
+{
+  const Elf32_Ehdr *eh;
+  const Elf32_Shdr *sh;
+  size_t size = 0;
+  uint8_t *elf;
+  uint16_t i;
+
+  memset (p, 0, sizeof(*p));
+
+  elf = m_file_read (elf_path, &size);
+  if (elf == NULL)
+  {
+    return -1;
+  }
+
+  eh = (const Elf32_Ehdr *) elf;
+  if (size < sizeof(*eh) || memcmp (eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+      eh->e_ident[EI_CLASS] != ELFCLASS32 ||
+      eh->e_shoff + (size_t) eh->e_shnum * sizeof(*sh) > size)
+  {
+    free (elf);
+    return -1;
+  }
+
+  sh = (const Elf32_Shdr *) (elf + eh->e_shoff);
+
+  for (i = 0; i < eh->e_shnum; i++)
+  {
+    const Elf32_Shdr *strtab;
+    const Elf32_Sym *sym;
+    uint32_t n;
+    uint32_t j;
+
+    if (sh[i].sh_type != SHT_SYMTAB || sh[i].sh_link >= eh->e_shnum)
+    {
+      continue;
+    }
+
+    strtab = &sh[sh[i].sh_link];
+    if (sh[i].sh_offset + sh[i].sh_size > size ||
+        strtab->sh_offset + strtab->sh_size > size)
+    {
+      break;
+    }
+
+    sym = (const Elf32_Sym *) (elf + sh[i].sh_offset);
+    n = sh[i].sh_size / sizeof(*sym);
+
+    p->funcs = calloc (n, sizeof(*p->funcs));
+    if (p->funcs == NULL)
+    {
+      break;
+    }
+
+    for (j = 0; j < n; j++)
+    {
+      sim_profile_func_t *fn = &p->funcs[p->count];
+
+      if (ELF32_ST_TYPE (sym[j].st_info) != STT_FUNC || sym[j].st_size == 0 ||
+          sym[j].st_name >= strtab->sh_size)
+      {
+        continue;
+      }
+
+      strncpy (fn->name, (const char *) elf + strtab->sh_offset +
+          sym[j].st_name, sizeof(fn->name) - 1);
+      fn->addr = sym[j].st_value;
+      fn->size = sym[j].st_size;
+      p->count++;
+    }
+
+    break;
+  }
+
+  free (elf);
+
+  if (p->count == 0)
+  {
+    sim_profile_free (p);
+    return -1;
+  }
+
+  qsort (p->funcs, p->count, sizeof(*p->funcs), m_addr_cmp);
+
+  return 0;
+}
+
+/* Index of the function containing pc, p->count if there is none */
+static uint32_t m_lookup (const sim_profile_t *p, uint32_t pc)
+{
+  uint32_t lo = 0;
+  uint32_t hi = p->count;
+
+  while (lo < hi)
+  {
+    const uint32_t mid = (lo + hi) / 2;
+
+    if (pc < p->funcs[mid].addr)
+    {
+      hi = mid;
+    }
+    else if (pc >= p->funcs[mid].addr + p->funcs[mid].size)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      return mid;
+    }
+  }
+
+  return p->count;
+}
+
+void sim_profile_step (sim_profile_t *p, uint32_t pc, uint32_t cycles,
+    bool spm_wait)
+{
+  sim_profile_func_t *fn;
+
+  p->total_cycles += cycles;
+
+  if (spm_wait)
+  {
+    p->spm_wait_cycles += cycles;
+    return;
+  }
+
+  /* Most instructions are in the same function as the previous one */
+  fn = (p->last < p->count) ? &p->funcs[p->last] : NULL;
+  if (fn == NULL || pc < fn->addr || pc >= fn->addr + fn->size)
+  {
+    p->last = m_lookup (p, pc);
+    if (p->last == p->count)
+    {
+      p->unknown_cycles += cycles;
+      return;
+    }
+    fn = &p->funcs[p->last];
+  }
+
+  if (pc == fn->addr)
+  {
+    fn->calls++;
+  }
+  fn->cycles += cycles;
+}
+
+void sim_profile_write_json (const sim_profile_t *p, FILE *f,
+    const char *indent)
+{
+  const sim_profile_func_t **sorted;
+  uint32_t n = 0;
+  uint32_t i;
+
+  sorted = calloc (p->count ? p->count : 1, sizeof(*sorted));
+  if (sorted == NULL)
+  {
+    return;
+  }
+
+  for (i = 0; i < p->count; i++)
+  {
+    if (p->funcs[i].cycles)
+    {
+      sorted[n++] = &p->funcs[i];
+    }
+  }
+  qsort (sorted, n, sizeof(*sorted), m_name_cmp);
+
+  fprintf (f, "{\n");
+  fprintf (f, "%s  \"total_cycles\": %llu,\n", indent,
+      (unsigned long long) p->total_cycles);
+  fprintf (f, "%s  \"boot_spm_busy_wait\": {\"cycles\": %llu},\n", indent,
+      (unsigned long long) p->spm_wait_cycles);
+  fprintf (f, "%s  \"unknown\": {\"cycles\": %llu}%s\n", indent,
+      (unsigned long long) p->unknown_cycles, n ? "," : "");
+  for (i = 0; i < n; i++)
+  {
+    fprintf (f, "%s  \"%s\": {\"cycles\": %llu, \"calls\": %u}%s\n", indent,
+        sorted[i]->name, (unsigned long long) sorted[i]->cycles,
+        sorted[i]->calls, i + 1 < n ? "," : "");
+  }
+  fprintf (f, "%s}", indent);
+
+  free (sorted);
+}
+
+void sim_profile_free (sim_profile_t *p)
+{
+  free (p->funcs);
+  memset (p, 0, sizeof(*p));
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Per-function cycle accounting for simulated bootloader runs.
+ */
+
+/** @defgroup sim_profile sim_profile
+@{
+@ingroup host
+
+@brief Attributes simulated cycles to the functions of an AVR ELF image
+@details Function symbols are read from the .symtab of the bootloader ELF.
+The simulator reports every executed instruction with its address and cycle
+cost; the cost is charged to the function containing the address. Cycles
+spent polling SPMCSR while a flash operation is in progress are charged to
+a separate boot_spm_busy_wait bucket, as that loop is a macro inlined into
+its callers. Build the bootloader with PROFILE=1 to keep static helpers out
+of line so they show up on their own.
+*/
+
+#ifndef SIM_PROFILE_H__
+#define SIM_PROFILE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SIM_PROFILE_NAME_MAX  48
+
+typedef struct
+{
+  char     name[SIM_PROFILE_NAME_MAX];
+  uint32_t addr;             /* Byte address */
+  uint32_t size;             /* Bytes */
+  uint64_t cycles;
+  uint32_t calls;            /* Entries at the first instruction */
+} sim_profile_func_t;
+
+typedef struct
+{
+  sim_profile_func_t *funcs;  /* Sorted by address */
+  uint32_t            count;
+  uint32_t            last;   /* Index of the last function hit */
+
+  uint64_t            total_cycles;
+  uint64_t            unknown_cycles;
+  uint64_t            spm_wait_cycles;
+} sim_profile_t;
+
+/** @brief Read the function symbols of an AVR ELF file.
+ *  @return 0 on success, -1 if the file is not a 32-bit ELF with a symtab.
+ */
+int sim_profile_load(sim_profile_t *p, const char *elf_path);
+
+/** @brief Charge one executed instruction.
+ *  @param pc Byte address of the instruction.
+ *  @param spm_wait True if it belongs to a busy wait on SPMCSR.
+ */
+void sim_profile_step(sim_profile_t *p, uint32_t pc, uint32_t cycles,
+    bool spm_wait);
+
+/** @brief Write the functions that ran, by name, as a JSON object. */
+void sim_profile_write_json(const sim_profile_t *p, FILE *f,
+    const char *indent);
+
+void sim_profile_free(sim_profile_t *p);
+
+#endif /* SIM_PROFILE_H__ */
+/** @} */
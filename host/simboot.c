@@ -0,0 +1,617 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Run a BLE DFU of an application image against the real bootloader
+  image on a simulated ATmega, with the nRF8001 model on its SPI pins, or an
+  STK500 upload over its UART.
+
+  When the bootloader is given as an ELF file the simulated cycles are also
+  attributed to its functions, see sim_profile.h.
+
+  Usage: simboot [options] <bootloader.hex|.elf> <application.hex>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_time.h"
+#include "avr_eeprom.h"
+#include "avr_uart.h"
+#include "avr_ioport.h"
+#include "sim_vcd_file.h"
+
+#include "ihex.h"
+#include "dfu_central.h"
+#include "dfu_link_model.h"
+#include "sim_nrf8001.h"
+#include "sim_profile.h"
+#include "stk500_client.h"
+
+/* Layout of the bootloader configuration block, see main() in optiboot.c */
+#define BOOTLOADER_EEPROM_SIZE  32
+#define EE_VALID_APP            0
+#define EE_VALID_BLE            1
+#define EE_PINS                 2
+#define EE_CREDITS              14
+#define EE_PIPES                15
+#define EE_CONN_TIMEOUT         18
+#define EE_CONN_INTERVAL        20
+
+/* Arduino pins of the nRF8001 shield, as in tests/eeprom.hex */
+#define PIN_REQN                9
+#define PIN_RDYN                8
+
+/* The same pins as ports and bits, for the VCD trace */
+#define PORT_REQN               'B'
+#define BIT_REQN                1
+#define PORT_RDYN               'B'
+#define BIT_RDYN                0
+
+/* Timing probes of a PROBE=1 build, see probe.h */
+#define PORT_PROBE              'C'
+
+/* SPMCSR, in data space and I/O space, and the SPM instruction */
+#define SPMCSR_DATA             0x57
+#define SPMCSR_IO               0x37
+#define SPMCSR_SPMEN            0x01
+#define SPMCSR_PGERS            0x02
+#define SPMCSR_PGWRT            0x04
+#define OPCODE_SPM              0x95E8
+
+/* Page erase and page write time, 3.7 - 4.5 ms in the datasheet */
+#define FLASH_OP_US             4000
+
+typedef struct
+{
+  avr_t          *avr;
+  stk500_client_t client;
+  uint32_t        baud;
+  uint64_t        next_tx;     /* Earliest time for the next byte */
+  bool            xoff;        /* Receive FIFO of the AVR is full */
+} uart_host_t;
+
+/* simavr completes SPM at once, hold SPMEN for as long as the part would */
+typedef struct
+{
+  uint32_t        op_us;
+  uint64_t        busy_until;
+  bool            busy;
+  avr_flashaddr_t poll_pc;     /* SPMCSR read of the busy wait loop */
+  uint32_t        ops;
+} flash_timing_t;
+
+static const char *m_usage =
+  "Usage: simboot [options] <bootloader.hex|.elf> <application.hex>\n"
+  "  -m <mcu>       simulated part (atmega328p)\n"
+  "  -f <hz>        clock frequency (16000000)\n"
+  "  -c <interval>  connection interval, 1.25 ms units (6)\n"
+  "  -n <prn>       packets per receipt notification, 0 for none (0)\n"
+  "  -k <credits>   nRF8001 data credits (2)\n"
+  "  -p <pkts>      central writes per connection event (4)\n"
+  "  -t <seconds>   simulated time limit (120)\n"
+  "  -u             upload over the UART with STK500 instead of BLE\n"
+  "  -b <baud>      UART baud rate of the uploader (115200)\n"
+  "  -w <us>        flash page erase/write time, 0 for instant (4000)\n"
+  "  -V <file>      write REQN, RDYN and the PROBE=1 pins to a VCD file\n";
+
+/* Bootloader configuration block with the shield defaults */
+static void m_eeprom_config (avr_t *avr, uint8_t credits, bool ble)
+{
+  const uint8_t pins[12] = {0, PIN_REQN, PIN_RDYN, 11, 12, 13, 5, 4,
+                            0xFF, 0xFF, 0, 1};
+  const uint8_t pipes[3] = {8, 9, 10};
+  uint8_t block[BOOTLOADER_EEPROM_SIZE];
+  avr_eeprom_desc_t ee;
+
+  memset (block, 0xFF, sizeof(block));
+  block[EE_VALID_APP] = 0;
+  block[EE_VALID_BLE] = ble ? 1 : 0;
+  memcpy (&block[EE_PINS], pins, sizeof(pins));
+  block[EE_CREDITS] = credits;
+  memcpy (&block[EE_PIPES], pipes, sizeof(pipes));
+  block[EE_CONN_TIMEOUT] = 180;
+  block[EE_CONN_TIMEOUT + 1] = 0;
+  block[EE_CONN_INTERVAL] = 0x50;
+  block[EE_CONN_INTERVAL + 1] = 0;
+
+  ee.ee = block;
+  ee.offset = avr->e2end - BOOTLOADER_EEPROM_SIZE;
+  ee.size = sizeof(block);
+  avr_ioctl (avr, AVR_IOCTL_EEPROM_SET, &ee);
+}
+
+static uint8_t m_eeprom_byte (avr_t *avr, uint16_t addr)
+{
+  avr_eeprom_desc_t ee;
+
+  ee.ee = NULL;
+  ee.offset = addr;
+  ee.size = 1;
+  avr_ioctl (avr, AVR_IOCTL_EEPROM_GET, &ee);
+
+  return ee.ee ? ee.ee[0] : 0xFF;
+}
+
+/* SPM_PAGESIZE of the parts optiboot supports */
+static uint16_t m_page_size (const avr_t *avr)
+{
+  if (avr->flashend < 0x2000)
+  {
+    return 64;
+  }
+  else if (avr->flashend < 0x8000)
+  {
+    return 128;
+  }
+  return 256;
+}
+
+static void m_uart_out (struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  uart_host_t *u = (uart_host_t *) param;
+
+  stk500_client_rx (&u->client, (uint8_t) value,
+      avr_cycles_to_usec (u->avr, u->avr->cycle));
+}
+
+static void m_uart_xon (struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  ((uart_host_t *) param)->xoff = false;
+}
+
+static void m_uart_xoff (struct avr_irq_t *irq, uint32_t value, void *param)
+{
+  ((uart_host_t *) param)->xoff = true;
+}
+
+static void m_uart_attach (uart_host_t *u, avr_t *avr, const ihex_image_t *app,
+    uint32_t baud)
+{
+  uint32_t flags = 0;
+
+  memset (u, 0, sizeof(*u));
+  u->avr = avr;
+  u->baud = baud;
+  stk500_client_init (&u->client, app->data, app->size, m_page_size (avr));
+
+  /* Keep the bootloader output off our stdout */
+  avr_ioctl (avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl (avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+
+  avr_irq_register_notify (
+      avr_io_getirq (avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+      m_uart_out, u);
+  avr_irq_register_notify (
+      avr_io_getirq (avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XON),
+      m_uart_xon, u);
+  avr_irq_register_notify (
+      avr_io_getirq (avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUT_XOFF),
+      m_uart_xoff, u);
+}
+
+/* Send the next byte once the previous one has been shifted out */
+static void m_uart_run (uart_host_t *u, uint64_t now)
+{
+  uint8_t byte;
+
+  if (u->xoff || now < u->next_tx || !stk500_client_tx (&u->client, &byte, now))
+  {
+    return;
+  }
+
+  avr_raise_irq (avr_io_getirq (u->avr, AVR_IOCTL_UART_GETIRQ('0'),
+        UART_IRQ_INPUT), byte);
+  u->next_tx = now + 10000000ULL / u->baud;
+}
+
+static uint16_t m_opcode (const avr_t *avr, avr_flashaddr_t pc)
+{
+  return avr->flash[pc] | (avr->flash[pc + 1] << 8);
+}
+
+/* True for IN Rd,SPMCSR and LDS Rd,SPMCSR */
+static bool m_reads_spmcsr (const avr_t *avr, avr_flashaddr_t pc)
+{
+  const uint16_t op = m_opcode (avr, pc);
+
+  if ((op & 0xF800) == 0xB000)
+  {
+    return (((op >> 5) & 0x30) | (op & 0x0F)) == SPMCSR_IO;
+  }
+
+  return (op & 0xFE0F) == 0x9000 && m_opcode (avr, pc + 2) == SPMCSR_DATA;
+}
+
+/* Called before each instruction, returns true if it is part of a busy wait
+ * on a page erase or write */
+static bool m_flash_timing (flash_timing_t *t, avr_t *avr, uint64_t now)
+{
+  if (!t->busy)
+  {
+    return false;
+  }
+
+  if (now >= t->busy_until)
+  {
+    avr->data[SPMCSR_DATA] &= ~SPMCSR_SPMEN;
+    t->busy = false;
+    return false;
+  }
+
+  avr->data[SPMCSR_DATA] |= SPMCSR_SPMEN;
+
+  if (m_reads_spmcsr (avr, avr->pc))
+  {
+    t->poll_pc = avr->pc;
+  }
+
+  /* IN, SBRC, RJMP */
+  return t->poll_pc && avr->pc >= t->poll_pc && avr->pc < t->poll_pc + 8;
+}
+
+static void m_flash_spm (flash_timing_t *t, avr_t *avr, uint8_t spmcsr,
+    uint64_t now)
+{
+  if (t->op_us == 0 || !(spmcsr & SPMCSR_SPMEN) ||
+      !(spmcsr & (SPMCSR_PGERS | SPMCSR_PGWRT)))
+  {
+    return;
+  }
+
+  t->busy = true;
+  t->busy_until = now + t->op_us;
+  t->poll_pc = 0;
+  t->ops++;
+  avr->data[SPMCSR_DATA] |= SPMCSR_SPMEN;
+}
+
+/* Load the bootloader, returning its start address */
+/* Trace the ACI handshake lines and the probe pins, names as in probe.h */
+static void m_vcd_start (avr_vcd_t *vcd, avr_t *avr, const char *path)
+{
+  static const char *probes[] = {"probe_spi", "probe_erase", "probe_write",
+    "probe_wait", "probe_dfu", "probe_uart"};
+  int i;
+
+  avr_vcd_init (avr, path, vcd, 100000);
+  avr_vcd_add_signal (vcd, avr_io_getirq (avr,
+      AVR_IOCTL_IOPORT_GETIRQ(PORT_REQN), BIT_REQN), 1, "reqn");
+  avr_vcd_add_signal (vcd, avr_io_getirq (avr,
+      AVR_IOCTL_IOPORT_GETIRQ(PORT_RDYN), BIT_RDYN), 1, "rdyn");
+  for (i = 0; i < (int) (sizeof(probes) / sizeof(probes[0])); i++)
+  {
+    avr_vcd_add_signal (vcd, avr_io_getirq (avr,
+        AVR_IOCTL_IOPORT_GETIRQ(PORT_PROBE), i), 1, probes[i]);
+  }
+  avr_vcd_start (vcd);
+}
+
+static int m_load_boot (avr_t **avr, const char *path, const char *mcu,
+    uint32_t freq)
+{
+  const size_t n = strlen (path);
+
+  if (n > 4 && strcmp (&path[n - 4], ".elf") == 0)
+  {
+    elf_firmware_t fw;
+
+    memset (&fw, 0, sizeof(fw));
+    if (elf_read_firmware (path, &fw) != 0)
+    {
+      return -1;
+    }
+    strcpy (fw.mmcu, mcu);
+    fw.frequency = freq;
+
+    *avr = avr_make_mcu_by_name (mcu);
+    if (*avr == NULL || avr_init (*avr) != 0)
+    {
+      return -1;
+    }
+    avr_load_firmware (*avr, &fw);
+    (*avr)->frequency = freq;
+
+    return (int) fw.flashbase;
+  }
+  else
+  {
+    ihex_image_t img;
+    int base;
+
+    if (ihex_load (path, &img) != 0)
+    {
+      return -1;
+    }
+
+    *avr = avr_make_mcu_by_name (mcu);
+    if (*avr == NULL || avr_init (*avr) != 0 ||
+        img.base + img.size > (*avr)->flashend + 1)
+    {
+      ihex_free (&img);
+      return -1;
+    }
+    memcpy (&(*avr)->flash[img.base], img.data, img.size);
+    (*avr)->frequency = freq;
+
+    base = (int) img.base;
+    ihex_free (&img);
+
+    return base;
+  }
+}
+
+int main (int argc, char **argv)
+{
+  const uint8_t pipes[3] = {8, 9, 10};
+  const char *mcu = "atmega328p";
+  uint32_t freq = 16000000;
+  uint32_t limit_s = 120;
+  uint32_t baud = 115200;
+  uint16_t prn = 0;
+  uint8_t credits = 2;
+  bool uart = false;
+  bool profiling;
+  nrf8001_config_t cfg;
+  sim_nrf8001_t ble;
+  dfu_central_t central;
+  uart_host_t host;
+  flash_timing_t flash;
+  sim_profile_t profile;
+  avr_vcd_t vcd;
+  const char *vcd_path = NULL;
+  ihex_image_t app;
+  avr_t *avr = NULL;
+  int boot_base;
+  int state = cpu_Running;
+  bool app_started = false;
+  bool finished;
+  bool verified;
+  uint64_t now = 0;
+  uint64_t next_run = 0;
+  uint64_t t_start;
+  uint64_t t_end;
+  double fw_s;
+  int opt;
+
+  nrf8001_config_default (&cfg);
+  memset (&flash, 0, sizeof(flash));
+  flash.op_us = FLASH_OP_US;
+
+  while ((opt = getopt (argc, argv, "m:f:c:n:k:p:t:ub:w:V:h")) != -1)
+  {
+    switch (opt)
+    {
+      case 'm': mcu = optarg; break;
+      case 'f': freq = strtoul (optarg, NULL, 0); break;
+      case 'c': cfg.conn_interval = strtoul (optarg, NULL, 0); break;
+      case 'n': prn = strtoul (optarg, NULL, 0); break;
+      case 'k': credits = strtoul (optarg, NULL, 0); break;
+      case 'p': cfg.pkts_per_event = strtoul (optarg, NULL, 0); break;
+      case 't': limit_s = strtoul (optarg, NULL, 0); break;
+      case 'u': uart = true; break;
+      case 'b': baud = strtoul (optarg, NULL, 0); break;
+      case 'w': flash.op_us = strtoul (optarg, NULL, 0); break;
+      case 'V': vcd_path = optarg; break;
+      default:
+        fputs (m_usage, stderr);
+        return opt == 'h' ? 0 : 2;
+    }
+  }
+
+  if (argc - optind != 2 || baud == 0)
+  {
+    fputs (m_usage, stderr);
+    return 2;
+  }
+
+  boot_base = m_load_boot (&avr, argv[optind], mcu, freq);
+  if (boot_base <= 0)
+  {
+    fprintf (stderr, "simboot: cannot load bootloader %s\n", argv[optind]);
+    return 1;
+  }
+
+  if (ihex_load (argv[optind + 1], &app) != 0 || app.base != 0)
+  {
+    fprintf (stderr, "simboot: cannot load application %s\n",
+        argv[optind + 1]);
+    return 1;
+  }
+
+  /* Symbols are only available from an ELF file */
+  profiling = sim_profile_load (&profile, argv[optind]) == 0;
+
+  /* Start as the bootloader fuse setting would */
+  avr->reset_pc = avr->pc = boot_base;
+
+  cfg.credits = credits;
+  m_eeprom_config (avr, credits, !uart);
+  if (uart)
+  {
+    m_uart_attach (&host, avr, &app, baud);
+  }
+  else
+  {
+    sim_nrf8001_attach (&ble, avr, &cfg, PIN_REQN, PIN_RDYN);
+    dfu_central_init (&central, app.data, app.size, pipes, prn);
+    dfu_link_model (&central, &ble.emu);
+  }
+
+  if (vcd_path)
+  {
+    m_vcd_start (&vcd, avr, vcd_path);
+  }
+
+  while (state != cpu_Done && state != cpu_Crashed)
+  {
+    const avr_flashaddr_t pc = avr->pc;
+    const avr_cycle_count_t cycle = avr->cycle;
+    const uint8_t spmcsr = avr->data[SPMCSR_DATA];
+    const bool spm = m_opcode (avr, pc) == OPCODE_SPM;
+    const bool spm_wait = m_flash_timing (&flash, avr, now);
+
+    state = avr_run (avr);
+    now = avr_cycles_to_usec (avr, avr->cycle);
+
+    if (spm)
+    {
+      m_flash_spm (&flash, avr, spmcsr, now);
+    }
+
+    if (profiling)
+    {
+      sim_profile_step (&profile, pc, (uint32_t) (avr->cycle - cycle),
+          spm_wait);
+    }
+
+    if (now >= next_run)
+    {
+      if (uart)
+      {
+        m_uart_run (&host, now);
+      }
+      else
+      {
+        dfu_central_run (&central, now);
+      }
+      next_run = now + (uart ? 1 : SIM_NRF8001_TICK_US);
+    }
+
+    finished = uart ? host.client.state == STK500_CLIENT_DONE :
+                      central.state == DFU_CENTRAL_DONE;
+
+    /* The bootloader has handed over to the new application */
+    if (finished && avr->pc < (avr_flashaddr_t) boot_base)
+    {
+      app_started = true;
+      break;
+    }
+
+    if ((uart ? host.client.state == STK500_CLIENT_FAILED :
+                central.state == DFU_CENTRAL_FAILED) ||
+        now >= limit_s * 1000000ULL)
+    {
+      break;
+    }
+  }
+
+  if (vcd_path)
+  {
+    avr_vcd_stop (&vcd);
+    avr_vcd_close (&vcd);
+  }
+
+  verified = memcmp (avr->flash, app.data, app.size) == 0;
+
+  if (uart)
+  {
+    finished = host.client.state == STK500_CLIENT_DONE;
+    t_start = host.client.t_first_page;
+    t_end = host.client.t_last_page;
+  }
+  else
+  {
+    finished = central.state == DFU_CENTRAL_DONE;
+    t_start = central.t_fw_start;
+    t_end = central.t_fw_done;
+  }
+  fw_s = (t_end - t_start) / 1e6;
+
+  printf ("{\n");
+  printf ("  \"transport\": \"%s\",\n", uart ? "uart" : "ble");
+  printf ("  \"mcu\": \"%s\",\n", mcu);
+  printf ("  \"frequency\": %u,\n", freq);
+  printf ("  \"image_size\": %u,\n", app.size);
+  printf ("  \"flash_op_us\": %u,\n", flash.op_us);
+  if (uart)
+  {
+    printf ("  \"baud\": %u,\n", baud);
+  }
+  else
+  {
+    printf ("  \"conn_interval\": %u,\n", cfg.conn_interval);
+    printf ("  \"pkts_per_event\": %u,\n", cfg.pkts_per_event);
+    printf ("  \"prn\": %u,\n", prn);
+    printf ("  \"credits\": %u,\n", credits);
+  }
+  printf ("  \"cycles\": %llu,\n", (unsigned long long) avr->cycle);
+  printf ("  \"sim_time_us\": %llu,\n", (unsigned long long) now);
+  if (uart)
+  {
+    printf ("  \"t_sync_us\": %llu,\n",
+        (unsigned long long) host.client.t_start);
+    printf ("  \"t_fw_start_us\": %llu,\n", (unsigned long long) t_start);
+    printf ("  \"t_fw_done_us\": %llu,\n", (unsigned long long) t_end);
+    printf ("  \"t_done_us\": %llu,\n",
+        (unsigned long long) host.client.t_done);
+  }
+  else
+  {
+    printf ("  \"t_connected_us\": %llu,\n",
+        (unsigned long long) central.t_connected);
+    printf ("  \"t_fw_start_us\": %llu,\n", (unsigned long long) t_start);
+    printf ("  \"t_fw_done_us\": %llu,\n", (unsigned long long) t_end);
+    printf ("  \"t_done_us\": %llu,\n", (unsigned long long) central.t_done);
+  }
+  printf ("  \"throughput_bps\": %.1f,\n", fw_s > 0 ? app.size / fw_s : 0.0);
+  printf ("  \"flash_ops\": %u,\n", flash.ops);
+  if (uart)
+  {
+    printf ("  \"pages\": %u,\n", host.client.pages);
+    printf ("  \"uart_bytes\": %u,\n", host.client.bytes_sent);
+  }
+  else
+  {
+    printf ("  \"packets\": %u,\n", central.packets);
+    printf ("  \"prn_received\": %u,\n", central.prn_received);
+    printf ("  \"stall_us\": %llu,\n", (unsigned long long) central.stall_us);
+    printf ("  \"aci_events\": %u,\n", ble.emu.stats.events);
+    printf ("  \"aci_commands\": %u,\n", ble.emu.stats.commands);
+    printf ("  \"conn_events\": %u,\n", ble.emu.stats.conn_events);
+    printf ("  \"write_stalls\": %u,\n", ble.emu.stats.write_stalls);
+    printf ("  \"credit_errors\": %u,\n", ble.emu.stats.credit_errors);
+  }
+  if (profiling)
+  {
+    printf ("  \"profile\": ");
+    sim_profile_write_json (&profile, stdout, "  ");
+    printf (",\n");
+  }
+  printf ("  \"valid_app\": %u,\n",
+      m_eeprom_byte (avr, avr->e2end - BOOTLOADER_EEPROM_SIZE + EE_VALID_APP));
+  printf ("  \"app_started\": %s,\n", app_started ? "true" : "false");
+  printf ("  \"verified\": %s\n", verified ? "true" : "false");
+  printf ("}\n");
+
+  if (profiling)
+  {
+    sim_profile_free (&profile);
+  }
+  ihex_free (&app);
+
+  return (finished && verified) ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+  @brief Implementation of the scripted STK500 uploader.
+ */
+
+#include <string.h>
+
+#include "../stk500.h"
+
+#include "stk500_client.h"
+
+static void m_cmd (stk500_client_t *c, const uint8_t *cmd, uint16_t len,
+    uint8_t state)
+{
+  memcpy (c->tx, cmd, len);
+  c->tx_len = len;
+  c->tx_pos = 0;
+
+  c->rsp[0] = STK_INSYNC;
+  c->rsp[1] = STK_OK;
+  c->rsp_len = 2;
+  c->rsp_pos = 0;
+
+  c->state = state;
+}
+
+static void m_load_address (stk500_client_t *c)
+{
+  const uint16_t word = c->offset / 2;
+  const uint8_t cmd[] = {STK_LOAD_ADDRESS, (uint8_t) word,
+    (uint8_t) (word >> 8), CRC_EOP};
+
+  m_cmd (c, cmd, sizeof(cmd), STK500_CLIENT_ADDRESS);
+}
+
+static void m_prog_page (stk500_client_t *c)
+{
+  uint8_t cmd[sizeof(c->tx)];
+  uint32_t n = c->image_size - c->offset;
+
+  if (n > c->page_size)
+  {
+    n = c->page_size;
+  }
+
+  cmd[0] = STK_PROG_PAGE;
+  cmd[1] = (uint8_t) (c->page_size >> 8);
+  cmd[2] = (uint8_t) c->page_size;
+  cmd[3] = 'F';
+  memset (&cmd[4], 0xFF, c->page_size);
+  memcpy (&cmd[4], &c->image[c->offset], n);
+  cmd[4 + c->page_size] = CRC_EOP;
+
+  m_cmd (c, cmd, c->page_size + 5, STK500_CLIENT_PAGE);
+}
+
+void stk500_client_init (stk500_client_t *c, const uint8_t *image,
+    uint32_t image_size, uint16_t page_size)
+{
+  /* main() answers the first sync with STK_INSYNC alone */
+  const uint8_t sync[] = {STK_GET_SYNC, CRC_EOP};
+
+  memset (c, 0, sizeof(*c));
+  c->image = image;
+  c->image_size = image_size;
+  c->page_size = page_size;
+
+  m_cmd (c, sync, sizeof(sync), STK500_CLIENT_SYNC);
+  c->rsp_len = 1;
+}
+
+bool stk500_client_tx (stk500_client_t *c, uint8_t *byte, uint64_t now_us)
+{
+  if (c->tx_pos >= c->tx_len)
+  {
+    return false;
+  }
+
+  if (c->bytes_sent == 0)
+  {
+    c->t_start = now_us;
+  }
+
+  *byte = c->tx[c->tx_pos++];
+  c->bytes_sent++;
+
+  return true;
+}
+
+void stk500_client_rx (stk500_client_t *c, uint8_t byte, uint64_t now_us)
+{
+  if (c->state >= STK500_CLIENT_DONE)
+  {
+    return;
+  }
+
+  if (c->rsp_pos >= c->rsp_len || byte != c->rsp[c->rsp_pos])
+  {
+    c->state = STK500_CLIENT_FAILED;
+    return;
+  }
+
+  if (++c->rsp_pos < c->rsp_len)
+  {
+    return;
+  }
+
+  switch (c->state)
+  {
+    case STK500_CLIENT_SYNC:
+      {
+        const uint8_t cmd[] = {STK_ENTER_PROGMODE, CRC_EOP};
+
+        m_cmd (c, cmd, sizeof(cmd), STK500_CLIENT_PROGMODE);
+      }
+      break;
+
+    case STK500_CLIENT_PROGMODE:
+      c->t_first_page = now_us;
+      m_load_address (c);
+      break;
+
+    case STK500_CLIENT_ADDRESS:
+      m_prog_page (c);
+      break;
+
+    case STK500_CLIENT_PAGE:
+      c->pages++;
+      c->offset += c->page_size;
+      if (c->offset < c->image_size)
+      {
+        m_load_address (c);
+      }
+      else
+      {
+        const uint8_t cmd[] = {STK_LEAVE_PROGMODE, CRC_EOP};
+
+        c->t_last_page = now_us;
+        m_cmd (c, cmd, sizeof(cmd), STK500_CLIENT_LEAVE);
+      }
+      break;
+
+    case STK500_CLIENT_LEAVE:
+      c->t_done = now_us;
+      c->state = STK500_CLIENT_DONE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+bool stk500_client_finished (const stk500_client_t *c)
+{
+  return c->state >= STK500_CLIENT_DONE;
+}
@@ -0,0 +1,90 @@
+/* Copyright (c) 2014, Nordic Semiconductor ASA
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/** @file
+ * @brief Scripted STK500 uploader, as avrdude -c arduino drives optiboot.
+ */
+
+/** @defgroup stk500_client stk500_client
+@{
+@ingroup host
+
+@brief Host side of a UART upload
+@details Transport independent: the caller moves bytes between the client
+and the UART of the target, and supplies the time. The client syncs, enters
+programming mode, loads an address and programs one full page at a time
+(padding the last page with 0xFF) and finally leaves programming mode,
+which makes optiboot reset into the application.
+*/
+
+#ifndef STK500_CLIENT_H__
+#define STK500_CLIENT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STK500_CLIENT_SYNC       0
+#define STK500_CLIENT_PROGMODE   1
+#define STK500_CLIENT_ADDRESS    2
+#define STK500_CLIENT_PAGE       3
+#define STK500_CLIENT_LEAVE      4
+#define STK500_CLIENT_DONE       5
+#define STK500_CLIENT_FAILED     6
+
+typedef struct
+{
+  const uint8_t *image;
+  uint32_t       image_size;
+  uint16_t       page_size;
+
+  uint8_t        state;
+  uint32_t       offset;       /* Start of the page being programmed */
+
+  uint8_t        tx[512 + 5];  /* Command being sent */
+  uint16_t       tx_len;
+  uint16_t       tx_pos;
+  uint8_t        rsp[2];       /* Expected reply */
+  uint8_t        rsp_len;
+  uint8_t        rsp_pos;
+
+  /* Timestamps, in microseconds */
+  uint64_t       t_start;
+  uint64_t       t_first_page;
+  uint64_t       t_last_page;
+  uint64_t       t_done;
+
+  uint32_t       pages;
+  uint32_t       bytes_sent;
+} stk500_client_t;
+
+void stk500_client_init(stk500_client_t *c, const uint8_t *image,
+    uint32_t image_size, uint16_t page_size);
+
+/** @brief Next byte for the target, false if waiting for a reply. */
+bool stk500_client_tx(stk500_client_t *c, uint8_t *byte, uint64_t now_us);
+
+/** @brief A byte sent by the target. */
+void stk500_client_rx(stk500_client_t *c, uint8_t byte, uint64_t now_us);
+
+bool stk500_client_finished(const stk500_client_t *c);
+
+#endif /* STK500_CLIENT_H__ */
+/** @} */
@@ -0,0 +1,208 @@
+## @description
+## Sweep the BLE DFU parameters against the simulated device and collect the
+## throughput of every combination.
+##
+## Each run is one hostboot (native build of the BLE modules) or simboot
+## (bootloader image under simavr) session with the scripted DFU central,
+## which does what memu_OTA_DFU_base.py does with the Master Emulator.
+
+## @setup
+## make -C host hostboot, or make -C host simboot and a bootloader .hex/.elf.
+## ACI_QUEUE_SIZE is a build option: hostboot is rebuilt for every value in
+## --queue-sizes, for simboot pass one bootloader image built with it.
+
+## @expected_output
+## One row per combination, as JSON (default) or CSV.
+
+#########################################
+from __future__ import print_function
+
+import argparse
+import csv
+import glob
+import itertools
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_APP = os.path.join(HOST_DIR, '..', 'tests', 'test_application.hex')
+
+FIELDS = ['tool', 'aci_queue_size', 'conn_interval', 'prn', 'credits',
+          'image_size', 'ok', 'throughput_bps', 'fw_time_us', 'stall_us',
+          'packets', 'prn_expected', 'prn_received', 'prn_dropped',
+          'write_stalls', 'credit_errors']
+
+
+def int_list(text):
+  return [int(v, 0) for v in text.split(',') if v]
+
+
+def read_hex(path):
+  """Contents of an Intel hex file, from address 0"""
+  data = bytearray()
+  with open(path) as f:
+    for line in f:
+      line = line.strip()
+      if not line.startswith(':'):
+        continue
+      rec = bytearray.fromhex(line[1:])
+      count, addr, rtype = rec[0], (rec[1] << 8) | rec[2], rec[3]
+      if rtype == 0:
+        if len(data) < addr + count:
+          data.extend(b'\xff' * (addr + count - len(data)))
+        data[addr:addr + count] = rec[4:4 + count]
+      elif rtype == 1:
+        break
+  return data
+
+
+def write_hex(path, data):
+  with open(path, 'w') as f:
+    for addr in range(0, len(data), 16):
+      chunk = data[addr:addr + 16]
+      rec = bytearray([len(chunk), addr >> 8, addr & 0xFF, 0]) + chunk
+      rec.append((-sum(rec)) & 0xFF)
+      f.write(':' + ''.join('%02X' % b for b in rec) + '\n')
+    f.write(':00000001FF\n')
+
+
+def sized_image(app, size, workdir):
+  """Image of size bytes, the application repeated or cut short"""
+  if size == len(app):
+    return None
+  data = (app * (size // len(app) + 1))[:size]
+  path = os.path.join(workdir, 'app_%u.hex' % size)
+  write_hex(path, data)
+  return path
+
+
+def remove_objects():
+  """Objects do not record the options they were built with. Only these go:
+  make clean would also take the containers, captures and results of the
+  other tools in host/"""
+  for path in glob.glob(os.path.join(HOST_DIR, '*.o')) + \
+      [os.path.join(HOST_DIR, 'hostboot')]:
+    if os.path.exists(path):
+      os.remove(path)
+
+
+def build_hostboot(queue_size, workdir):
+  """hostboot built with ACI_QUEUE_SIZE=queue_size, copied out of host/"""
+  remove_objects()
+  subprocess.check_call(['make', '-s', '-C', HOST_DIR, 'hostboot',
+                         'ACI_QUEUE_SIZE=%u' % queue_size])
+  path = os.path.join(workdir, 'hostboot_q%u' % queue_size)
+  shutil.copy(os.path.join(HOST_DIR, 'hostboot'), path)
+  return path
+
+
+def run(cmd):
+  """JSON report of one session, None if the tool did not produce one"""
+  proc = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+  out, _ = proc.communicate()
+  try:
+    return proc.returncode, json.loads(out.decode('ascii'))
+  except ValueError:
+    return proc.returncode, None
+
+
+def row(args, queue_size, interval, prn, credits, size, status, report):
+  r = dict.fromkeys(FIELDS, '')
+  r.update(tool=args.tool, aci_queue_size=queue_size, conn_interval=interval,
+           prn=prn, credits=credits, image_size=size, ok=(status == 0))
+  if report is None:
+    return r
+
+  packets = report['packets']
+  expected = packets // prn if prn else 0
+  if report['t_fw_done_us']:
+    r['fw_time_us'] = report['t_fw_done_us'] - report['t_fw_start_us']
+  r.update(throughput_bps=report['throughput_bps'],
+           stall_us=report['stall_us'],
+           packets=packets,
+           prn_expected=expected,
+           prn_received=report['prn_received'],
+           prn_dropped=max(expected - report['prn_received'], 0),
+           write_stalls=report['write_stalls'],
+           credit_errors=report['credit_errors'])
+  return r
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Sweep BLE DFU parameters against the simulated device')
+  parser.add_argument('--tool', choices=['hostboot', 'simboot'],
+                      default='hostboot')
+  parser.add_argument('--boot', help='bootloader .hex/.elf for simboot')
+  parser.add_argument('--app', default=DEFAULT_APP)
+  parser.add_argument('--intervals', type=int_list, default=[6, 12, 24],
+                      help='connection intervals, 1.25 ms units')
+  parser.add_argument('--prn', type=int_list, default=[0, 5, 10])
+  parser.add_argument('--credits', type=int_list, default=[1, 2])
+  parser.add_argument('--sizes', type=int_list, default=[],
+                      help='image sizes in bytes (size of --app)')
+  parser.add_argument('--queue-sizes', type=int_list, default=[2],
+                      help='ACI_QUEUE_SIZE values, powers of two (hostboot)')
+  parser.add_argument('--format', choices=['json', 'csv'], default='json')
+  parser.add_argument('-o', '--output', help='output file (stdout)')
+  args = parser.parse_args()
+
+  if args.tool == 'simboot' and args.boot is None:
+    parser.error('simboot needs --boot')
+  for q in args.queue_sizes:
+    if q < 1 or q & (q - 1):
+      parser.error('ACI_QUEUE_SIZE must be a power of two')
+
+  app = read_hex(args.app)
+  sizes = args.sizes or [len(app)]
+  workdir = tempfile.mkdtemp(prefix='sweep')
+  rows = []
+
+  try:
+    images = dict((s, sized_image(app, s, workdir) or args.app) for s in sizes)
+
+    for q in (args.queue_sizes if args.tool == 'hostboot' else [None]):
+      if args.tool == 'hostboot':
+        tool = [build_hostboot(q, workdir)]
+      else:
+        tool = [os.path.join(HOST_DIR, 'simboot')]
+
+      for interval, prn, credits, size in itertools.product(
+          args.intervals, args.prn, args.credits, sizes):
+        cmd = tool + ['-c', str(interval), '-n', str(prn), '-k', str(credits)]
+        if args.tool == 'simboot':
+          cmd.append(args.boot)
+        cmd.append(images[size])
+
+        status, report = run(cmd)
+        rows.append(row(args, q if q is not None else '', interval, prn,
+                        credits, size, status, report))
+        print('%s' % ' '.join('%s=%s' % (k, rows[-1][k]) for k in
+              ('aci_queue_size', 'conn_interval', 'prn', 'credits',
+               'image_size', 'throughput_bps')), file=sys.stderr)
+  finally:
+    shutil.rmtree(workdir)
+    # Leave no objects built with a non-default queue size behind
+    if args.tool == 'hostboot':
+      remove_objects()
+
+  out = open(args.output, 'w') if args.output else sys.stdout
+  if args.format == 'csv':
+    writer = csv.DictWriter(out, FIELDS)
+    writer.writeheader()
+    writer.writerows(rows)
+  else:
+    json.dump(rows, out, indent=2)
+    out.write('\n')
+  if args.output:
+    out.close()
+
+  return 0 if all(r['ok'] for r in rows) else 1
+
+
+if __name__ == '__main__':
+  sys.exit(main())
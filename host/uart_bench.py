@@ -0,0 +1,185 @@
+## @description
+## Time STK500 uploads over the UART for the board targets of makeall, at a
+## range of baud rates.
+##
+## Every target is built with BAUD_RATE=<baud> and run under simboot -u, which
+## plays avrdude -c arduino against uart_update() on a simulated USART. The
+## divisor error is worked out the way baudcheck.c does it; simavr passes
+## whole bytes, so a bad divisor shows up in the error column and not as
+## failed uploads.
+
+## @setup
+## avr-gcc for the bootloader builds, make -C host simboot.
+## --check-only needs neither and prints the divisor errors alone.
+
+## @expected_output
+## One row per target, baud rate and image, as CSV (default) or JSON.
+
+#########################################
+from __future__ import print_function
+
+import argparse
+import csv
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+HOST_DIR = os.path.dirname(os.path.abspath(__file__))
+TOP_DIR = os.path.join(HOST_DIR, '..')
+
+IMAGES = [os.path.join(TOP_DIR, 'tests', 'test_application.hex'),
+          os.path.join(TOP_DIR, 'tests', 'dfu_application.hex')]
+
+# make target: (output name, simulated part, F_CPU), as in the Makefile
+TARGETS = {
+  'atmega328':      ('atmega328',          'atmega328p', 16000000),
+  'atmega328_pro8': ('atmega328_pro_8MHz', 'atmega328p', 8000000),
+  'atmega168':      ('atmega168',          'atmega168',  16000000),
+  'diecimila':      ('diecimila',          'atmega168',  16000000),
+  'pro8':           ('pro_8MHz',           'atmega168',  8000000),
+  'pro16':          ('pro_16MHz',          'atmega168',  16000000),
+  'pro20':          ('pro_20mhz',          'atmega168',  20000000),
+  'lilypad':        ('lilypad',            'atmega168',  8000000),
+  'atmega88':       ('atmega88',           'atmega88',   16000000),
+  'atmega8':        ('atmega8',            'atmega8',    16000000),
+}
+
+# Beyond this the receiver samples too far from the middle of the last bit
+MARGINAL_ERROR = 2.0
+
+FIELDS = ['target', 'mcu', 'f_cpu', 'baud', 'ubrr', 'baud_actual',
+          'baud_error', 'marginal', 'image', 'image_size', 'status',
+          'upload_us', 'sec_per_kb', 'pages']
+
+
+def int_list(text):
+  return [int(v, 0) for v in text.split(',') if v]
+
+
+def baud_check(fcpu, bps):
+  """Divisor, real rate and error in percent, as printed by baudcheck.c"""
+  ubrr = (fcpu + bps * 4) // (bps * 8) - 1
+  if ubrr < 0 or ubrr > 255:
+    return ubrr, None, None
+  actual = fcpu // (8 * (ubrr + 1))
+  # Truncated to tenths of a percent, like the shell arithmetic
+  tenths = abs(1000 * (bps - actual)) // bps
+  return ubrr, actual, (tenths if bps >= actual else -tenths) / 10.0
+
+
+def build(target, baud, workdir):
+  """Bootloader hex of target at baud, None if it does not build"""
+  output = TARGETS[target][0]
+  log = open(os.path.join(workdir, 'build.log'), 'a')
+  status = subprocess.call(['make', '-C', TOP_DIR, target,
+                            'BAUD_RATE=%u' % baud], stdout=log, stderr=log)
+  log.close()
+  hexfile = os.path.join(TOP_DIR, 'optiboot_%s.hex' % output)
+  if status != 0 or not os.path.exists(hexfile):
+    return None
+  path = os.path.join(workdir, '%s_%u.hex' % (target, baud))
+  shutil.copy(hexfile, path)
+  return path
+
+
+def upload(boot, mcu, fcpu, baud, image):
+  cmd = [os.path.join(HOST_DIR, 'simboot'), '-u', '-m', mcu,
+         '-f', str(fcpu), '-b', str(baud), boot, image]
+  proc = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+  out, _ = proc.communicate()
+  try:
+    return proc.returncode, json.loads(out.decode('ascii'))
+  except ValueError:
+    return proc.returncode, None
+
+
+def main():
+  parser = argparse.ArgumentParser(
+      description='Time UART uploads per target and baud rate')
+  parser.add_argument('--targets', default=','.join(sorted(TARGETS)),
+                      help='make targets (%(default)s)')
+  parser.add_argument('--bauds', type=int_list,
+                      default=[19200, 38400, 57600, 115200, 230400])
+  parser.add_argument('--images', default=','.join(IMAGES))
+  parser.add_argument('--check-only', action='store_true',
+                      help='only compute the divisor errors')
+  parser.add_argument('--format', choices=['json', 'csv'], default='csv')
+  parser.add_argument('-o', '--output', help='output file (stdout)')
+  args = parser.parse_args()
+
+  targets = [t for t in args.targets.split(',') if t]
+  for t in targets:
+    if t not in TARGETS:
+      parser.error('unknown target %s' % t)
+  images = [i for i in args.images.split(',') if i]
+
+  workdir = tempfile.mkdtemp(prefix='uart_bench')
+  rows = []
+  failed = False
+
+  try:
+    for target in targets:
+      _, mcu, fcpu = TARGETS[target]
+
+      for baud in args.bauds:
+        ubrr, actual, error = baud_check(fcpu, baud)
+        base = dict.fromkeys(FIELDS, '')
+        base.update(target=target, mcu=mcu, f_cpu=fcpu, baud=baud, ubrr=ubrr)
+        if error is None:
+          base.update(marginal=True, status='no_divisor')
+          rows.append(base)
+          continue
+        base.update(baud_actual=actual, baud_error=error,
+                    marginal=abs(error) > MARGINAL_ERROR)
+
+        if args.check_only:
+          rows.append(base)
+          continue
+
+        boot = build(target, baud, workdir)
+
+        for image in images:
+          r = dict(base, image=os.path.basename(image))
+          if boot is None:
+            r['status'] = 'build_failed'
+            rows.append(r)
+            failed = True
+            continue
+
+          status, report = upload(boot, mcu, fcpu, baud, image)
+          if report is None:
+            r['status'] = 'no_report'
+          else:
+            us = report['t_done_us'] - report['t_sync_us']
+            r.update(image_size=report['image_size'],
+                     status='ok' if status == 0 else 'failed',
+                     upload_us=us,
+                     sec_per_kb=round(us / 1e6 / (report['image_size'] / 1024.0),
+                                      3),
+                     pages=report['pages'])
+          failed = failed or status != 0
+          rows.append(r)
+          print('%s %u %s %s' % (target, baud, r['image'], r['sec_per_kb']),
+                file=sys.stderr)
+  finally:
+    shutil.rmtree(workdir)
+
+  out = open(args.output, 'w') if args.output else sys.stdout
+  if args.format == 'csv':
+    writer = csv.DictWriter(out, FIELDS)
+    writer.writeheader()
+    writer.writerows(rows)
+  else:
+    json.dump(rows, out, indent=2)
+    out.write('\n')
+  if args.output:
+    out.close()
+
+  return 1 if failed else 0
+
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,75 @@
+#include "idle.h"
+
+#ifdef IDLE
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+#include "BLE/hal_aci_tl.h"
+#include "BLE/pins_arduino.h"
+
+#if !defined(__AVR_ATmega88__) && !defined(__AVR_ATmega168__) && \
+    !defined(__AVR_ATmega328P__)
+#error IDLE is only supported on the ATmega88/168/328P
+#endif
+
+#ifdef SOFT_UART
+#error IDLE needs the hardware UART
+#endif
+
+#define IDLE_STR(x)   #x
+#define IDLE_XSTR(x)  IDLE_STR(x)
+
+/* Vectors are two words when the part has jmp */
+#ifdef __AVR_HAVE_JMP_CALL__
+#define IDLE_VECTOR_PAD "  nop\n"
+#else
+#define IDLE_VECTOR_PAD ""
+#endif
+
+/* The vector table, up to the USART receive vector, in front of the
+ * bootloader code. The reset vector runs the .init sections as before, the
+ * others only wake the CPU.
+ */
+asm("  .section .vectors,\"ax\",@progbits\n"
+    "  rjmp idle_reset\n"
+    IDLE_VECTOR_PAD
+    "  .rept " IDLE_XSTR(USART_RX_vect_num) "\n"
+    "  reti\n"
+    IDLE_VECTOR_PAD
+    "  .endr\n"
+    "  .section .init0,\"ax\",@progbits\n"
+    "idle_reset:\n"
+    "  .section .text\n");
+
+void idle_init (uint8_t rdyn_pin)
+{
+  uint8_t group;
+
+  MCUCR = _BV(IVCE);
+  MCUCR = _BV(IVSEL);
+
+  /* Ports B, C and D are pin change groups 0, 1 and 2 */
+  if (rdyn_pin != UNUSED)
+  {
+    group = (uint8_t) (pin_to_input (rdyn_pin) - &PINB) / (&PINC - &PINB);
+    (&PCMSK0)[group] |= pin_to_bit_mask (rdyn_pin);
+    PCICR |= _BV(group);
+  }
+
+  UCSR0B |= _BV(RXCIE0);
+  set_sleep_mode (SLEEP_MODE_IDLE);
+}
+
+void idle_sleep (void)
+{
+  sleep_enable ();
+  /* sei takes effect after sleep, so a pending wake-up is not lost */
+  sei ();
+  sleep_cpu ();
+  cli ();
+  sleep_disable ();
+}
+
+#endif /* IDLE */
@@ -0,0 +1,42 @@
+/* Idle sleep while waiting for a host, built in with IDLE=1.
+ *
+ * Instead of busy-polling the UART and the nRF8001 at full load for the
+ * whole listening window, main() puts the CPU in idle sleep whenever
+ * neither link has anything for it. A pin change on RDYN or a byte
+ * received by the USART wakes it at once. Idle sleep leaves the watchdog,
+ * Timer1, the USART and SPI running, so the bootloader timeout and the
+ * trace and boot log timestamps carry on as before.
+ *
+ * Waking the CPU needs interrupt vectors, so idle_init() moves them to the
+ * start of the bootloader, where idle.c places a small table of vectors
+ * that only return. Interrupts are only enabled for the sleep itself. The
+ * watchdog reset that starts the application moves the vectors back.
+ *
+ * Supported on the ATmega88/168/328P with the hardware UART.
+ */
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include <stdint.h>
+
+#ifdef IDLE
+
+/* Move the vectors and enable the wake-up sources; rdyn_pin is the
+ * Arduino pin number of RDYN, or UNUSED to wake on the UART only
+ */
+void idle_init (uint8_t rdyn_pin);
+
+/* Sleep until a wake-up source fires. Call with interrupts disabled, after
+ * checking that there is nothing to do; an event in between still wakes
+ * the CPU straight away.
+ */
+void idle_sleep (void);
+
+#else
+
+#define idle_init(rdyn_pin)   do {} while (0)
+#define idle_sleep()          do {} while (0)
+
+#endif /* IDLE */
+
+#endif /* IDLE_H_ */
@@ -1,4 +1,5 @@
 #include "jump.h"
+#include "bootlog.h"
 
 #include <avr/wdt.h>
 #include <avr/eeprom.h>
@@ -25,9 +26,13 @@ void jump_check (void)
     WDTCSR = _BV(WDCE) | _BV(WDE);
     WDTCSR = 0;
 
+    bootlog_app ();
+
     /* Jump to application */
     ((void (*)(void)) 0x0000)();
   }
+
+  bootlog_init ();
 }
 
 void jump_boot_key_clear (void)
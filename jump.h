@@ -1,6 +1,8 @@
 /* This way of jumping to the bootloader is inspired by bootloaders
  * written by Dean Camera.
  * */
+#include <stdint.h>
+
 #define BOOTLOADER_KEY 0xDC42
 #define BOOTLOADER_EEPROM_SIZE 32
 
@@ -11,6 +13,14 @@
  */
 void jump_check (void) __attribute__ ((used, naked, section (".init3")));
 
+/* Survives the watchdog reset, in .noinit. BOOTLOADER_KEY starts the
+ * application, SELFBENCH_KEY a self benchmark (see selfbench.h).
+ */
+extern uint16_t boot_key;
+
+/* EEPROM byte of the application valid flag, 1 when it is set */
+extern const uint8_t *valid_app_addr;
+
 /* Clear the boot_key variable */
 void jump_boot_key_clear (void);
 
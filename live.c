@@ -0,0 +1,91 @@
+#include "live.h"
+
+#ifdef LIVE_TRACE
+
+#include <avr/io.h>
+
+#define LIVE_RECORD_SIZE  5
+
+static uint8_t m_buf[LIVE_SIZE];
+static uint8_t m_head;            /* Next byte to write */
+static uint8_t m_tail;            /* Next byte to send */
+static uint8_t m_stalls;
+static uint8_t m_dropped;
+
+static inline void m_byte (uint8_t *head, uint8_t byte)
+{
+  m_buf[*head] = byte;
+  *head = (*head + 1) & (LIVE_SIZE - 1);
+}
+
+/* False if the ring has no room for the record */
+static uint8_t m_put (uint8_t type, uint8_t data)
+{
+  const uint16_t time = TCNT1;
+  uint8_t head = m_head;
+
+  if (((m_tail - head - 1) & (LIVE_SIZE - 1)) < LIVE_RECORD_SIZE)
+  {
+    return 0;
+  }
+
+  m_byte (&head, LIVE_SYNC);
+  m_byte (&head, (uint8_t) time);
+  m_byte (&head, (uint8_t) (time >> 8));
+  m_byte (&head, type);
+  m_byte (&head, data);
+  m_head = head;
+
+  return 1;
+}
+
+void live_init (void)
+{
+  m_head = 0;
+  m_tail = 0;
+  m_stalls = 0;
+  m_dropped = 0;
+  live_record (TRACE_BOOT, MCUSR);
+}
+
+void live_record (uint8_t type, uint8_t data)
+{
+  /* Counts held back by a full ring go first */
+  if (m_dropped && m_put (LIVE_DROPPED, m_dropped))
+  {
+    m_dropped = 0;
+  }
+  if (m_stalls && m_put (LIVE_STALLS, m_stalls))
+  {
+    m_stalls = 0;
+  }
+
+  if (!m_put (type, data) && m_dropped < 0xFF)
+  {
+    m_dropped++;
+  }
+}
+
+void live_stall (void)
+{
+  if (m_stalls < 0xFF)
+  {
+    m_stalls++;
+  }
+}
+
+void live_poll (void)
+{
+  while (m_tail != m_head && live_uart_ready ())
+  {
+    live_uart_put (m_buf[m_tail]);
+    m_tail = (m_tail + 1) & (LIVE_SIZE - 1);
+  }
+}
+
+uint8_t live_pending (void)
+{
+  return m_tail != m_head;
+}
+
+#endif /* LIVE_TRACE */
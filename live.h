@@ -0,0 +1,75 @@
+/* Live progress stream on the UART, built in with LIVE_TRACE=1.
+ *
+ * During a BLE DFU the UART is idle. With LIVE_TRACE the bootloader sends
+ * compact records on it as the session runs, so that a bench or a
+ * production line station can follow many units at once:
+ *
+ *   LIVE_SYNC, time (2 bytes, little-endian), type, data
+ *
+ * Time is Timer1 at F_CPU/1024 as in trace.h. The types are those of
+ * trace.h (DFU state changes, pages committed, the watchdog exit) and the
+ * LIVE_* ones below: the data credits left after each change, the receive
+ * polls skipped because the event queue was full since the last record,
+ * and records lost to a full ring.
+ *
+ * Records go into a RAM ring of LIVE_SIZE bytes and never wait for the
+ * UART: when the ring is full a record is dropped and counted. live_poll()
+ * moves bytes from the ring to the USART while its data register is empty,
+ * and returns as soon as it is not. ble_update() calls it on every pass.
+ * The bootloader runs with interrupts disabled (see idle.h), so the
+ * register empty flag is polled rather than taken as an interrupt.
+ *
+ * Not for boards that are also programmed over the UART: records would
+ * precede avrdude's sync. Cannot be combined with ACI_CAPTURE, which uses
+ * the UART too. host/livewatch.py decodes the stream.
+ */
+#ifndef LIVE_H_
+#define LIVE_H_
+
+#include <stdint.h>
+
+#include "trace.h"
+
+#define LIVE_SYNC         0x5A
+
+/* Record types beyond those of trace.h, and what goes in data */
+#define LIVE_CREDITS      6   /* Data credits available */
+#define LIVE_STALLS       7   /* Polls skipped on a full queue, saturating */
+#define LIVE_DROPPED      8   /* Records lost before this one, saturating */
+
+/* Bytes in the ring, a power of two */
+#ifndef LIVE_SIZE
+#define LIVE_SIZE         64
+#endif
+
+#ifdef LIVE_TRACE
+
+/* Send a TRACE_BOOT record */
+void live_init (void);
+
+void live_record (uint8_t type, uint8_t data);
+
+/* A receive poll skipped, reported with the next record */
+void live_stall (void);
+
+/* Send what the USART can take right now */
+void live_poll (void);
+
+/* True while the ring holds bytes not sent yet */
+uint8_t live_pending (void);
+
+/* The USART, provided by the caller: optiboot.c */
+uint8_t live_uart_ready (void);
+void live_uart_put (uint8_t byte);
+
+#else
+
+#define live_init()               do {} while (0)
+#define live_record(type, data)   do {} while (0)
+#define live_stall()              do {} while (0)
+#define live_poll()               do {} while (0)
+#define live_pending()            0
+
+#endif /* LIVE_TRACE */
+
+#endif /* LIVE_H_ */
@@ -215,14 +215,22 @@ asm("  .section .version\n"
 /* <avr/boot.h> uses sts instructions, but this version uses out instructions
  * This saves cycles and program memory.
  */
+#include "arena.h"
+#include "ble.h"
 #include "boot.h"
+#include "bootlog.h"
+#include "capture.h"
 #include "jump.h"
+#include "history.h"
+#include "idle.h"
+#include "live.h"
+#include "perf.h"
+#include "probe.h"
+#include "selfbench.h"
+#include "trace.h"
 
 /* Bluetooth files */
-#include "BLE/bonding.h"
 #include "BLE/lib_aci.h"
-#include "BLE/aci_evts.h"
-#include "BLE/dfu.h"
 
 /* We don't use <avr/wdt.h> as those routines have interrupt overhead we don't
  * need.
@@ -316,7 +324,6 @@ asm("  .section .version\n"
  */
 int main(void) __attribute__ ((OS_main)) __attribute__ ((section (".init9")));
 static void uart_update (void);
-static void ble_update (uint8_t *pipes);
 static void putch(uint8_t ch);
 static uint8_t getch(void);
 static void getNch(uint8_t count);
@@ -328,12 +335,6 @@ static void watchdogConfig(uint8_t x);
 static void uartDelay() __attribute__ ((naked));
 #endif
 
-/* BLE stuff */
-static struct aci_state_t aci_state;
-static uint8_t dfu_mode;
-uint16_t conn_timeout;
-uint16_t conn_interval;
-
 /*
  * NRWW memory
  * Addresses below NRWW (Non-Read-While-Write) can be programmed while
@@ -375,13 +376,12 @@ uint16_t conn_interval;
 #define NRWWSTART (0x1800)
 #endif
 
-/* C zero initialises all global variables. However, that requires */
+/* The UART buffers share the RAM arena with the BLE ones, see arena.h */
 /* These definitions are NOT zero initialised, but that doesn't matter */
-/* This allows us to drop the zero init code, saving us memory */
-#define buff    ((uint8_t*)(RAMSTART))
+#define buff    (arena.uart.buff)
 #ifdef VIRTUAL_BOOT_PARTITION
-#define rstVect (*(uint16_t*)(RAMSTART+SPM_PAGESIZE*2+4))
-#define wdtVect (*(uint16_t*)(RAMSTART+SPM_PAGESIZE*2+6))
+#define rstVect (arena.uart.rst_vect)
+#define wdtVect (arena.uart.wdt_vect)
 #endif
 
 /*
@@ -433,16 +433,6 @@ int main (void)
 {
   uint8_t valid_ble;
   uint8_t ch;
-  uint8_t pipes[3];
-
-  const uint16_t eeprom_base_addr   = E2END - BOOTLOADER_EEPROM_SIZE;
-
-  const uint8_t *valid_ble_addr     = (uint8_t *) (eeprom_base_addr + 1);
-  const uint8_t *pins_addr          = (uint8_t *) (eeprom_base_addr + 2);
-  const uint8_t *credit_addr        = (uint8_t *) (eeprom_base_addr + 14);
-  const uint8_t *pipes_addr         = (uint8_t *) (eeprom_base_addr + 15);
-  const uint8_t *conn_timeout_addr  = (uint8_t *) (eeprom_base_addr + 18);
-  const uint8_t *conn_interval_addr = (uint8_t *) (eeprom_base_addr + 20);
 
   /* After the zero init loop, this is the first code to run.
    *
@@ -459,8 +449,9 @@ int main (void)
   SP=RAMEND;  /* This is done by hardware reset */
 #endif
 
-#if LED_START_FLASHES > 0
-  /* Set up Timer 1 for timeout counter */
+#if (LED_START_FLASHES > 0) || defined(TRACE) || defined(HISTORY) || \
+    defined(BOOTLOG) || defined(ACI_CAPTURE) || defined(LIVE_TRACE)
+  /* Set up Timer 1 for timeout counter and the trace timestamps */
   TCCR1B = _BV(CS12) | _BV(CS10); /* div 1024 */
 #endif
 #ifndef SOFT_UART
@@ -483,6 +474,7 @@ int main (void)
 #else
   watchdogConfig(WATCHDOG_2S);
 #endif
+  bootlog_stamp (BOOT_UART_INIT);
 
 #if (LED_START_FLASHES > 0) || defined(LED_DATA_FLASH)
   /* Set LED pin as output */
@@ -497,38 +489,38 @@ int main (void)
 #if LED_START_FLASHES > 0
   /* Flash onboard LED to signal entering of bootloader */
   flash_led(LED_START_FLASHES * 2);
+  bootlog_led (LED_START_FLASHES * 2);
 #endif
 
-  /* Check to see if we should read BLE data from EEPROM */
-  valid_ble = eeprom_read_byte (valid_ble_addr);
-
-  if (valid_ble == 1)
-  {
-    /* Read pin data */
-    eeprom_read_block ((void *) &aci_state.aci_pins, pins_addr,
-        sizeof(aci_pins_t));
-
-    /* Read credit data */
-    aci_state.data_credit_total = eeprom_read_byte (credit_addr);
-    aci_state.data_credit_available = aci_state.data_credit_total;
-
-    /* Read pipe data */
-    eeprom_read_block ((void *) &pipes, pipes_addr, 3);
-
-    /* Read connection timeout */
-    eeprom_read_block ((void *) &conn_timeout, conn_timeout_addr, 2);
+  probe_init ();
+  perf_init ();
+  trace_init ();
+  history_init ();
+  capture_init ();
+  live_init ();
 
-    /* Read connection advertise interval */
-    eeprom_read_block ((void *) &conn_interval, conn_interval_addr, 2);
+  /* Check to see if we should read BLE data from EEPROM, see ble.c */
+  valid_ble = ble_init ();
 
-    lib_aci_init (&aci_state);
-
-    dfu_init (pipes);
+  /* A self-benchmark run ends in a reset back into the bootloader */
+  if (selfbench_requested ()) {
+    selfbench_run (valid_ble == 1, NRWWSTART - SPM_PAGESIZE);
   }
 
+  idle_init (valid_ble == 1 ? aci_state.aci_pins.rdyn_pin : UNUSED);
   jump_boot_key_set ();
 
   for (;;) {
+#ifdef IDLE
+    /* Nothing from either link yet: sleep until RDYN or the UART wakes us.
+     * The live stream is sent by polling, so stay awake until it is out.
+     */
+    if (!(UART_SRA & _BV(RXC0)) && !(valid_ble == 1 && hal_aci_tl_rdyn ()) &&
+        !live_pending ()) {
+      idle_sleep ();
+    }
+#endif
+
     /* We grab the value in the UDR register without looping, as we need to do
      * a non-blocking read in the event that UART is disabled. This is okay
      * since we validate the data we pull before acting on it. */
@@ -542,7 +534,7 @@ int main (void)
     */
     if (valid_ble == 1) {
       do {
-        ble_update (pipes);
+        ble_update ();
       } while (dfu_mode);
     }
 
@@ -553,110 +545,6 @@ int main (void)
   }
 }
 
-/* Get and process events from the BLE link. If we detect an event indicating
- * that we are about to receive a new firmware image on BLE we set "ble_mode"
- * to a true value.
- */
-static void ble_update (uint8_t *pipes)
-{
-  hal_aci_evt_t aci_data;
-  aci_evt_t *aci_evt;
-  uint8_t pipe;
-  uint8_t eeprom_status = 0xFF;
-
-  const uint8_t *bond_status_addr     = (uint8_t *) (0);
-
-  /* Attempt to grab an event from the BLE message queue */
-  if (!lib_aci_event_get(&aci_state, &aci_data)) {
-    return;
-  }
-
-  aci_evt = &(aci_data.evt);
-
-  switch(aci_evt->evt_opcode) {
-    case ACI_EVT_DEVICE_STARTED:
-      aci_state.data_credit_total =
-        aci_evt->params.device_started.credit_available;
-      if (aci_evt->params.device_started.device_mode == ACI_DEVICE_STANDBY) {
-        if (aci_evt->params.device_started.hw_error) {
-            /* Magic number used to make sure the HW error event
-             * is handled correctly. */
-            _delay_ms (20);
-        }
-        else
-        {
-          /* Check to see if we should read bond data from EEPROM */
-          eeprom_read_block ((void *) &eeprom_status, bond_status_addr, 1);
-
-          if (eeprom_status != 0xFF)
-          {
-            bond_data_restore (&aci_state, eeprom_status);
-          }
-
-          lib_aci_connect (conn_timeout, conn_interval);
-        }
-      }
-      break; /* ACI_EVT_DEVICE_STARTED */
-
-    case ACI_EVT_CMD_RSP:
-      if ((aci_evt->params.cmd_rsp.cmd_opcode == ACI_CMD_RADIO_RESET) &&
-          (aci_evt->params.cmd_rsp.cmd_status == ACI_STATUS_SUCCESS))
-      {
-        lib_aci_connect (conn_timeout, conn_interval);
-      }
-      break; /* ACI_EVT_CMD_RSP */
-
-    case ACI_EVT_CONNECTED:
-      watchdogReset();
-      /* We should have checked that this is true before we jumped into
-       * the bootloader. Hopefully we did.
-       */
-      aci_state.data_credit_available = aci_state.data_credit_total;
-      break; /* ACI_EVT_CONNECTED */
-
-    case ACI_EVT_DISCONNECTED:
-      lib_aci_connect (conn_timeout, conn_interval);
-      break; /* ACI_EVT_DISCONNECTED */
-
-    case ACI_EVT_DATA_CREDIT:
-      watchdogReset();
-      aci_state.data_credit_available = aci_state.data_credit_available +
-                                        aci_evt->params.data_credit.credit;
-      break; /* ACI_EVT_DATA_CREDIT */
-
-    case ACI_EVT_PIPE_ERROR:
-      watchdogReset();
-      /* If we received a pipe error, some message got borked.
-       * All we can do is update our credit to reflect it
-       */
-      if (aci_evt->params.pipe_error.error_code !=
-          ACI_STATUS_ERROR_PEER_ATT_ERROR) {
-        aci_state.data_credit_available++;
-      }
-      break; /* ACI_EVT_PIPE_ERROR */
-
-    case ACI_EVT_DATA_RECEIVED:
-      watchdogReset();
-      /* If data received is on either of the DFU pipes, we enter DFU mode.
-       * We then update the DFU state machine to run the transfer.
-       */
-      pipe = aci_evt->params.data_received.rx_data.pipe_number;
-      if (pipe == pipes[0] || pipe == pipes[2]) {
-        if (!dfu_mode) {
-          dfu_mode = 1;
-        }
-
-        dfu_update(&aci_state, aci_evt);
-      }
-      break; /* ACI_EVT_DATA_RECEIVED */
-
-    default:
-      break;
-  }
-
-  return;
-}
-
 /* If main() detects a firmware transfer on UART, this function is run in a
  * loop to process the incoming data and write the firmware to flash
  */
@@ -667,9 +555,12 @@ static void uart_update (void)
   uint8_t length;
 
   jump_app_key_clear();
+  history_start (HISTORY_UART, 0);
 
   /* Forever loop */
   for (;;) {
+    history_tick ();
+
     /* get character from UART */
     ch = getch();
 
@@ -683,6 +574,20 @@ static void uart_update (void)
 	putch(OPTIBOOT_MINVER);
       } else if (which == 0x81) {
 	  putch(OPTIBOOT_MAJVER);
+#ifdef PERF_COUNTERS
+      } else if ((uint8_t)(which - PERF_PARAM_BASE) < sizeof(perf_counters)) {
+	/*
+	 * Bytes of the performance counters block, see perf.h
+	 */
+	putch(((uint8_t *) &perf_counters)[which - PERF_PARAM_BASE]);
+#endif
+#ifdef SELFBENCH
+      } else if ((uint8_t)(which - SELFBENCH_PARAM_BASE) < sizeof(selfbench)) {
+	/*
+	 * Bytes of the self-benchmark results, see selfbench.h
+	 */
+	putch(((uint8_t *) &selfbench)[which - SELFBENCH_PARAM_BASE]);
+#endif
       } else {
 	/*
 	 * GET PARAMETER returns a generic 0x03 reply for
@@ -728,7 +633,11 @@ static void uart_update (void)
       getch();
 
       // If we are in RWW section, immediately start page erase
-      if (address < NRWWSTART) __boot_page_erase_short((uint16_t)(void*)address);
+      if (address < NRWWSTART) {
+        __boot_page_erase_short((uint16_t)(void*)address);
+        probe_on (PROBE_ERASE);
+      }
+      perf_count (pages_erased);
 
       // While that is going on, read in page contents
       bufPtr = buff;
@@ -739,14 +648,19 @@ static void uart_update (void)
       // Todo: Take RAMPZ into account (not doing so just means that we will
       //  treat the top of both "pages" of flash as NRWW, for a slight speed
       //  decrease, so fixing this is not urgent.)
-      if (address >= NRWWSTART) __boot_page_erase_short((uint16_t)(void*)address);
+      if (address >= NRWWSTART) {
+        __boot_page_erase_short((uint16_t)(void*)address);
+        probe_on (PROBE_ERASE);
+      }
 
       // Read command terminator, start reply
       verifySpace();
 
       // If only a partial page is to be programmed, the erase might not be complete.
       // So check that here
-      boot_spm_busy_wait();
+      probe_on (PROBE_WAIT);
+      perf_spm_busy_wait();
+      probe_flash_idle ();
 
 #ifdef VIRTUAL_BOOT_PARTITION
       if ((uint16_t)(void*)address == 0) {
@@ -781,7 +695,13 @@ static void uart_update (void)
 
       // Write from programming buffer
       __boot_page_write_short((uint16_t)(void*)address);
-      boot_spm_busy_wait();
+      probe_on (PROBE_WRITE);
+      perf_count (pages_written);
+      trace_record (TRACE_PAGE, address / SPM_PAGESIZE);
+      history_page ();
+      probe_on (PROBE_WAIT);
+      perf_spm_busy_wait();
+      probe_flash_idle ();
 
 #if defined(RWWSRE)
       // Reenable read access to flash
@@ -831,6 +751,8 @@ static void uart_update (void)
     }
     else if (ch == STK_LEAVE_PROGMODE) { /* 'Q' */
       // Adaboot no-wait mod
+      trace_record (TRACE_WDT_EXIT, TRACE_EXIT_UART);
+      history_end (HISTORY_OK);
       watchdogConfig(WATCHDOG_16MS);
       verifySpace();
     }
@@ -843,8 +765,37 @@ static void uart_update (void)
   }
 }
 
+#ifdef ACI_CAPTURE
+/* ACI transfers go out on the UART, see capture.h */
+void capture_out (uint8_t byte)
+{
+  putch (byte);
+}
+#endif
+
+#ifdef LIVE_TRACE
+#ifdef ACI_CAPTURE
+#error LIVE_TRACE and ACI_CAPTURE both need the UART
+#endif
+#ifdef SOFT_UART
+#error LIVE_TRACE needs the hardware UART
+#endif
+
+/* The live stream only writes when the USART has room, see live.h */
+uint8_t live_uart_ready (void)
+{
+  return UART_SRA & _BV(UDRE0);
+}
+
+void live_uart_put (uint8_t byte)
+{
+  UART_UDR = byte;
+}
+#endif
+
 static void putch(uint8_t ch)
 {
+  probe_on (PROBE_UART);
 #ifndef SOFT_UART
   while (!(UART_SRA & _BV(UDRE0)));
   UART_UDR = ch;
@@ -872,12 +823,15 @@ static void putch(uint8_t ch)
       "r25"
   );
 #endif
+  probe_off (PROBE_UART);
 }
 
 static uint8_t getch(void)
 {
   uint8_t ch;
 
+  probe_on (PROBE_UART);
+
 #ifdef LED_DATA_FLASH
 #if defined(__AVR_ATmega8__) || defined (__AVR_ATmega32__)
   LED_PORT ^= _BV(LED);
@@ -936,6 +890,7 @@ static uint8_t getch(void)
 #endif
 #endif
 
+  probe_off (PROBE_UART);
   return ch;
 }
 
@@ -999,10 +954,12 @@ static void watchdogReset()
   __asm__ __volatile__ (
     "wdr\n"
   );
+  bootlog_wdr();
 }
 
 static void watchdogConfig(uint8_t x)
 {
   WDTCSR = _BV(WDCE) | _BV(WDE);
   WDTCSR = x;
+  bootlog_wdt(x);
 }
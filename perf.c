@@ -0,0 +1,5 @@
+#include "perf.h"
+
+#ifdef PERF_COUNTERS
+perf_counters_t perf_counters __attribute__((section (".noinit")));
+#endif
@@ -0,0 +1,55 @@
+/* Performance counters, built in with PERF_COUNTERS=1.
+ *
+ * The counters live in RAM for as long as the bootloader runs. They can be
+ * read over BLE with the OP_CODE_PERF_COUNTERS_REQ control point request,
+ * and over UART with STK_GET_PARAMETER, one byte per parameter starting at
+ * PERF_PARAM_BASE. The block is little-endian with no padding.
+ *
+ * The block is kept in .noinit and cleared by perf_init() when main()
+ * starts.
+ */
+#ifndef PERF_H_
+#define PERF_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/* STK_GET_PARAMETER number of the first byte of the counters block */
+#define PERF_PARAM_BASE   0xC0
+
+#ifdef PERF_COUNTERS
+
+typedef struct
+{
+  uint16_t aci_events;      /* Events handed up by hal_aci_tl_event_get() */
+  uint16_t spi_transfers;   /* ACI transfers on the SPI bus */
+  uint16_t rx_full;         /* Event polls skipped with the RX queue full */
+  uint16_t tx_full;         /* Commands dropped, TX queue full */
+  uint16_t zero_credit;     /* Notifications sent at zero data credits */
+  uint16_t pages_erased;
+  uint16_t pages_written;
+  uint16_t pipe_errors;     /* ACI_EVT_PIPE_ERROR events */
+  uint32_t spm_wait;        /* Polls of SPMCSR in boot_spm_busy_wait() */
+  uint16_t aci_folded;      /* Events folded into aci_state_t on receipt */
+} perf_counters_t;
+
+extern perf_counters_t perf_counters;
+
+#define perf_init()           memset (&perf_counters, 0, sizeof(perf_counters))
+#define perf_count(counter)   (perf_counters.counter++)
+
+/* boot_spm_busy_wait() counting its polls. The host build provides its own */
+#ifndef perf_spm_busy_wait
+#define perf_spm_busy_wait() \
+  do { while (boot_spm_busy ()) perf_counters.spm_wait++; } while (0)
+#endif
+
+#else
+
+#define perf_init()           do {} while (0)
+#define perf_count(counter)   do {} while (0)
+#define perf_spm_busy_wait()  boot_spm_busy_wait ()
+
+#endif /* PERF_COUNTERS */
+
+#endif /* PERF_H_ */
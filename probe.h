@@ -0,0 +1,53 @@
+/* Timing probes, built in with PROBE=1.
+ *
+ * Each phase drives one pin of PROBE_PORT high while it runs, for a logic
+ * analyzer or the VCD output of host/simboot -V. The default is PORTC,
+ * A0 to A5 on an Arduino, which the nRF8001 shield leaves free.
+ *
+ * Page erase and page write go high when the operation is issued and low
+ * when a busy wait sees the flash finish, so they show how long the flash
+ * was busy in the background. PROBE_WAIT is the time spent waiting for it.
+ *
+ * With PROBE unset every macro compiles to nothing.
+ */
+#ifndef PROBE_H_
+#define PROBE_H_
+
+#include <avr/io.h>
+
+#ifndef PROBE_PORT
+#define PROBE_PORT    PORTC
+#define PROBE_DDR     DDRC
+#endif
+
+/* Bits of PROBE_PORT */
+#define PROBE_SPI     0   /* ACI SPI transaction */
+#define PROBE_ERASE   1   /* Page erase in progress */
+#define PROBE_WRITE   2   /* Page write in progress */
+#define PROBE_WAIT    3   /* In a boot_spm_busy_wait() */
+#define PROBE_DFU     4   /* Handling a DFU packet */
+#define PROBE_UART    5   /* In getch() or putch() */
+
+#define PROBE_MASK    (_BV(PROBE_SPI) | _BV(PROBE_ERASE) | _BV(PROBE_WRITE) | \
+                       _BV(PROBE_WAIT) | _BV(PROBE_DFU) | _BV(PROBE_UART))
+
+#ifdef PROBE
+
+#define probe_init()    (PROBE_DDR |= PROBE_MASK)
+#define probe_on(bit)   (PROBE_PORT |= _BV(bit))
+#define probe_off(bit)  (PROBE_PORT &= ~_BV(bit))
+
+/* The flash is idle again: no erase or write is in progress */
+#define probe_flash_idle() \
+  (PROBE_PORT &= ~(_BV(PROBE_ERASE) | _BV(PROBE_WRITE) | _BV(PROBE_WAIT)))
+
+#else
+
+#define probe_init()        do {} while (0)
+#define probe_on(bit)       do {} while (0)
+#define probe_off(bit)      do {} while (0)
+#define probe_flash_idle()  do {} while (0)
+
+#endif /* PROBE */
+
+#endif /* PROBE_H_ */
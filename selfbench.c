@@ -0,0 +1,191 @@
+#include "selfbench.h"
+
+#ifdef SELFBENCH
+
+#include <string.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+
+#include "boot.h"
+#include "BLE/lib_aci.h"
+
+/* RDYN high this long and the nRF8001 has nothing more to say, 10 ms */
+#define SELFBENCH_QUIET_TICKS (F_CPU / 800)
+
+selfbench_t selfbench __attribute__((section (".noinit")));
+
+static uint16_t m_spi_start;
+
+uint8_t selfbench_requested (void)
+{
+  return ((MCUSR & _BV(WDRF)) && boot_key == SELFBENCH_KEY) ||
+         eeprom_read_byte (SELFBENCH_EEPROM_ADDR) == 1;
+}
+
+void selfbench_spi_start (void)
+{
+  m_spi_start = TCNT1;
+}
+
+void selfbench_spi_end (uint8_t bytes)
+{
+  /* Only while a run is in progress; valid results are left alone */
+  if (selfbench.magic != SELFBENCH_MAGIC)
+  {
+    selfbench.spi_ticks += TCNT1 - m_spi_start;
+    selfbench.spi_bytes += bytes;
+  }
+}
+
+/* Drop every event until the nRF8001 has been quiet for a while */
+static void m_aci_settle (void)
+{
+  uint16_t start = TCNT1;
+
+  while ((uint16_t) (TCNT1 - start) < SELFBENCH_QUIET_TICKS)
+  {
+    if (lib_aci_event_drain () > 0)
+    {
+      do
+      {
+        lib_aci_event_release ();
+      } while (lib_aci_event_peek () != NULL);
+      start = TCNT1;
+    }
+  }
+}
+
+/* Time one GetDeviceVersion, dropping any other event on the way */
+static uint16_t m_aci_rtt (void)
+{
+  const uint16_t start = TCNT1;
+  hal_aci_evt_t *aci_data;
+  uint16_t ticks;
+
+  if (!lib_aci_device_version ())
+  {
+    return SELFBENCH_NONE;
+  }
+
+  for (;;)
+  {
+    lib_aci_event_drain ();
+
+    while ((aci_data = lib_aci_event_peek ()) != NULL)
+    {
+      ticks = TCNT1 - start;
+      if (aci_data->evt.evt_opcode == ACI_EVT_CMD_RSP &&
+          aci_data->evt.params.cmd_rsp.cmd_opcode == ACI_CMD_GET_DEVICE_VERSION)
+      {
+        lib_aci_event_release ();
+        return ticks;
+      }
+      lib_aci_event_release ();
+    }
+  }
+}
+
+static void m_aci (void)
+{
+  uint16_t ticks;
+  uint8_t i;
+
+  /* The first response may answer the probe from lib_aci_init(), so take
+   * one round trip and wait for the link to go quiet before timing
+   */
+  m_aci_rtt ();
+  m_aci_settle ();
+
+  selfbench.aci_rtt_min = SELFBENCH_NONE;
+  selfbench.aci_rtt_max = 0;
+  selfbench.spi_bytes = 0;
+  selfbench.spi_ticks = 0;
+
+  for (i = 0; i < SELFBENCH_RUNS; i++)
+  {
+    ticks = m_aci_rtt ();
+    if (ticks < selfbench.aci_rtt_min)
+    {
+      selfbench.aci_rtt_min = ticks;
+    }
+    if (ticks > selfbench.aci_rtt_max)
+    {
+      selfbench.aci_rtt_max = ticks;
+    }
+  }
+}
+
+/* Erase the page and write its own contents back to it. The page is part
+ * of the application, so the application valid flag is cleared for as long
+ * as it is erased: a reset in between leaves the bootloader in charge
+ * rather than starting a broken application.
+ */
+static void m_flash (uint16_t page)
+{
+  const uint8_t valid_app = eeprom_read_byte (valid_app_addr);
+  uint16_t start;
+  uint16_t i;
+
+  if (valid_app == 1)
+  {
+    jump_app_key_clear ();
+    eeprom_busy_wait ();
+  }
+
+  /* The temporary buffer may be filled before the erase */
+  for (i = 0; i < SPM_PAGESIZE; i += 2)
+  {
+    __boot_page_fill_short (page + i, pgm_read_word_near (page + i));
+  }
+
+  start = TCNT1;
+  __boot_page_erase_short (page);
+  selfbench.erase_cpu = TCNT1 - start;
+  boot_spm_busy_wait ();
+  selfbench.erase_busy = TCNT1 - start;
+
+  start = TCNT1;
+  __boot_page_write_short (page);
+  selfbench.write_cpu = TCNT1 - start;
+  boot_spm_busy_wait ();
+  selfbench.write_busy = TCNT1 - start;
+
+  boot_rww_enable ();
+
+  if (valid_app == 1)
+  {
+    jump_app_key_set ();
+  }
+}
+
+void selfbench_run (uint8_t ble, uint16_t page)
+{
+  uint16_t start;
+
+  memset (&selfbench, 0xFF, sizeof(selfbench));
+  TCCR1B = _BV(CS11);
+
+  /* Clear the request first, so that a run cut short is not repeated */
+  boot_key = 0;
+  start = TCNT1;
+  eeprom_write_byte (SELFBENCH_EEPROM_ADDR, 0);
+  eeprom_busy_wait ();
+  selfbench.eeprom_write = TCNT1 - start;
+
+  m_flash (page);
+
+  if (ble)
+  {
+    m_aci ();
+  }
+
+  selfbench.magic = SELFBENCH_MAGIC;
+
+  /* Start the bootloader again, with the nRF8001 left as it is */
+  wdt_enable (WDTO_15MS);
+  for (;;)
+    ;
+}
+
+#endif /* SELFBENCH */
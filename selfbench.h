@@ -0,0 +1,87 @@
+/* On-device self-benchmark, built in with SELFBENCH=1.
+ *
+ * The application asks for a run by setting boot_key to SELFBENCH_KEY
+ * before its watchdog reset into the bootloader, or by writing 1 to the
+ * EEPROM byte at SELFBENCH_EEPROM_ADDR. Either request is cleared as the
+ * run starts. The run times, with Timer1 at F_CPU/8:
+ *
+ *  - the round trip of GetDeviceVersion to its CommandResponse, and the SPI
+ *    transfers those runs make, when a BLE configuration is in EEPROM,
+ *  - an erase and a write of the last application page below NRWWSTART,
+ *    rewritten with its own contents, both until the CPU runs on and until
+ *    the flash is ready again. An NRWW page holds the CPU for the whole of
+ *    the busy time. The application valid flag is cleared until the page
+ *    is back,
+ *  - one EEPROM byte write, erase included.
+ *
+ * It then resets into the bootloader again, which carries on as usual. The
+ * results stay in .noinit, valid while magic is SELFBENCH_MAGIC, and can be
+ * read over BLE with the OP_CODE_SELFBENCH_REQ control point request and
+ * over UART with STK_GET_PARAMETER from SELFBENCH_PARAM_BASE, like the
+ * performance counters in perf.h.
+ */
+#ifndef SELFBENCH_H_
+#define SELFBENCH_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#include "jump.h"
+
+#define SELFBENCH_KEY         0xDC5B
+#define SELFBENCH_MAGIC       0x5E1F
+#define SELFBENCH_NONE        0xFFFF
+
+/* After the bootloader configuration, see README.TXT */
+#define SELFBENCH_EEPROM_ADDR ((uint8_t *) (E2END - BOOTLOADER_EEPROM_SIZE + 24))
+
+/* STK_GET_PARAMETER number of the first byte of the results block */
+#define SELFBENCH_PARAM_BASE  0xE0
+
+/* Round trips timed */
+#define SELFBENCH_RUNS        8
+
+/* Length of a Timer1 tick, F_CPU/8 */
+#define SELFBENCH_TICK_NS     (8000000000ULL / F_CPU)
+
+/* All times in SELFBENCH_TICK_NS units, SELFBENCH_NONE if not measured */
+typedef struct
+{
+  uint16_t magic;
+  uint16_t aci_rtt_min;     /* GetDeviceVersion to its CommandResponse */
+  uint16_t aci_rtt_max;
+  uint16_t spi_bytes;       /* Bytes clocked by the transfers of those runs */
+  uint16_t spi_ticks;       /* Time spent clocking them */
+  uint16_t erase_cpu;       /* Page erase, until the CPU runs on */
+  uint16_t erase_busy;      /* Page erase, until the flash is ready */
+  uint16_t write_cpu;       /* Page write, until the CPU runs on */
+  uint16_t write_busy;      /* Page write, until the flash is ready */
+  uint16_t eeprom_write;    /* One EEPROM byte */
+} selfbench_t;
+
+#ifdef SELFBENCH
+
+extern selfbench_t selfbench;
+
+/* Whether the application asked for a run */
+uint8_t selfbench_requested (void);
+
+/* Run after lib_aci_init(), if ble is set, and reset into the bootloader.
+ * page is the RWW page to erase and write back.
+ */
+void selfbench_run (uint8_t ble, uint16_t page) __attribute__ ((noreturn));
+
+/* Around each ACI SPI transfer of bytes bytes */
+void selfbench_spi_start (void);
+void selfbench_spi_end (uint8_t bytes);
+
+#else
+
+#define selfbench_requested()       0
+#define selfbench_run(ble, page)    do {} while (0)
+#define selfbench_spi_start()       do {} while (0)
+#define selfbench_spi_end(bytes)    do {} while (0)
+
+#endif /* SELFBENCH */
+
+#endif /* SELFBENCH_H_ */
@@ -0,0 +1,33 @@
+#include "trace.h"
+
+#ifdef TRACE
+
+#include <avr/io.h>
+#include <string.h>
+
+trace_t trace_ring __attribute__((section (".noinit")));
+
+void trace_init (void)
+{
+  if (trace_ring.magic != TRACE_MAGIC || trace_ring.head >= TRACE_SIZE)
+  {
+    memset (&trace_ring, 0, sizeof(trace_ring));
+    trace_ring.magic = TRACE_MAGIC;
+  }
+
+  trace_ring.sessions++;
+  trace_record (TRACE_BOOT, MCUSR);
+}
+
+void trace_record (uint8_t type, uint8_t data)
+{
+  trace_record_t *rec = &trace_ring.rec[trace_ring.head];
+
+  rec->time = TCNT1;
+  rec->type = type;
+  rec->data = data;
+
+  trace_ring.head = (trace_ring.head + 1) & (TRACE_SIZE - 1);
+}
+
+#endif /* TRACE */
@@ -0,0 +1,68 @@
+/* Post-mortem trace, built in with TRACE=1.
+ *
+ * A ring of TRACE_SIZE four byte records kept in .noinit, so that it
+ * survives the watchdog reset that ends every bootloader session. Each
+ * start of the bootloader appends a TRACE_BOOT record rather than clearing
+ * the ring, so the last sessions can be read back by the application or by
+ * a later bootloader session. Find trace_ring in the bootloader's .map
+ * file (or with avr-nm); magic is TRACE_MAGIC when the ring is valid.
+ *
+ * Timestamps are the low 16 bits of Timer1, which main() starts at
+ * F_CPU/1024 whenever a timestamping module is built: 64 us per tick at
+ * 16 MHz, wrapping every 4.2 s. The LED flashes at start-up reload Timer1,
+ * so times before the first ACI event are not meaningful.
+ */
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+#define TRACE_MAGIC       0x7AC3
+
+/* Records in the ring, a power of two */
+#ifndef TRACE_SIZE
+#define TRACE_SIZE        32
+#endif
+
+/* Record types, and what goes in data */
+#define TRACE_BOOT        1   /* Bootloader started: MCUSR */
+#define TRACE_ACI_EVT     2   /* ACI event handled: event opcode */
+#define TRACE_DFU_STATE   3   /* DFU state change: new ST_* state */
+#define TRACE_PAGE        4   /* Page committed to flash: page number */
+#define TRACE_WDT_EXIT    5   /* Watchdog armed to leave: TRACE_EXIT_* */
+
+#define TRACE_EXIT_BLE    0   /* Activate & Reset over BLE */
+#define TRACE_EXIT_UART   1   /* STK_LEAVE_PROGMODE over UART */
+
+typedef struct
+{
+  uint16_t time;
+  uint8_t  type;
+  uint8_t  data;
+} trace_record_t;
+
+typedef struct
+{
+  uint16_t       magic;
+  uint8_t        head;        /* Next record to write */
+  uint8_t        sessions;    /* TRACE_BOOT records written, wrapping */
+  trace_record_t rec[TRACE_SIZE];
+} trace_t;
+
+#ifdef TRACE
+
+extern trace_t trace_ring;
+
+/* Validate the ring and log the reset cause */
+void trace_init (void);
+
+void trace_record (uint8_t type, uint8_t data);
+
+#else
+
+#define trace_init()              do {} while (0)
+#define trace_record(type, data)  do {} while (0)
+
+#endif /* TRACE */
+
+#endif /* TRACE_H_ */